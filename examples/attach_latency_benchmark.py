@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""
+Attach Latency Benchmark: how long it takes to open an existing SharedDict
+
+Worker pools often start many short-lived processes that each attach to the
+same segment, do a little work and exit. This benchmark measures:
+1. Attach + close latency inside one process (the raw cost of SharedDict(create=False))
+2. End-to-end latency of short-lived processes that attach, read one key and exit
+
+Run with: python examples/attach_latency_benchmark.py
+"""
+
+import multiprocessing as mp
+import statistics
+import time
+
+from sharedbox import SharedDict
+
+SEGMENT_NAME = "attach_latency_benchmark"
+
+
+def attach_once(segment_name: str) -> float:
+    """Attach to the segment, read one key and return the attach time in seconds"""
+    start = time.perf_counter()
+    d = SharedDict(segment_name, create=False)
+    elapsed = time.perf_counter() - start
+
+    assert d["config"]["ready"]
+    d.close()
+    return elapsed
+
+
+def percentile(samples: list[float], fraction: float) -> float:
+    """Nearest-rank percentile of a list of samples"""
+    ordered = sorted(samples)
+    index = min(len(ordered) - 1, int(round(fraction * (len(ordered) - 1))))
+    return ordered[index]
+
+
+def report(label: str, samples: list[float]) -> None:
+    """Print latency statistics in microseconds"""
+    us = [s * 1e6 for s in samples]
+    print(f"  {label}")
+    print(f"    mean: {statistics.mean(us):9.1f} us")
+    print(f"    p50:  {percentile(us, 0.50):9.1f} us")
+    print(f"    p99:  {percentile(us, 0.99):9.1f} us")
+
+
+def benchmark_attach_latency(in_process: int = 5000, processes: int = 200) -> None:
+    """Measure attach latency in-process and from short-lived worker processes"""
+    print("=" * 80)
+    print("ATTACH LATENCY BENCHMARK")
+    print("=" * 80)
+
+    d = SharedDict(SEGMENT_NAME, size=64 * 1024 * 1024, create=True, max_keys=1024)
+    try:
+        d["config"] = {"ready": True}
+        for i in range(10_000):
+            d[f"item_{i}"] = i
+
+        # Warm up imports and the page cache
+        attach_once(SEGMENT_NAME)
+
+        print(f"\nIn-process attach + close ({in_process} iterations):")
+        report("SharedDict(create=False)", [attach_once(SEGMENT_NAME) for _ in range(in_process)])
+
+        print(f"\nShort-lived processes ({processes} processes, one attach each):")
+        ctx = mp.get_context("spawn")
+        with ctx.Pool(4, maxtasksperchild=1) as pool:
+            samples = pool.map(attach_once, [SEGMENT_NAME] * processes)
+        report("attach inside a fresh process", samples)
+    finally:
+        d.close()
+        d.unlink()
+
+    print("=" * 80)
+
+
+if __name__ == "__main__":
+    try:
+        benchmark_attach_latency()
+    except KeyboardInterrupt:
+        print("\n\nBenchmark interrupted by user.")
@@ -0,0 +1,54 @@
+/*
+ * C client: writes values that a Python SharedDict reads natively
+ *
+ * Build against an installed sharedbox_core (see CMakeLists.txt here), then:
+ *
+ *   ./c_client c_client_demo
+ *
+ *   >>> from sharedbox import SharedDict
+ *   >>> d = SharedDict("c_client_demo", create=False)
+ *   >>> d["greeting"], d["answer"], d["ratio"], d["payload"]
+ *   ('hello from C', 42, 0.25, b'\x00\x01\x02\x03')
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "sharedbox.h"
+
+static int check(sharedbox_status status, const char *what)
+{
+    if (status != SHAREDBOX_OK)
+    {
+        fprintf(stderr, "%s failed (%d): %s\n", what, (int)status, sharedbox_last_error());
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *name = argc > 1 ? argv[1] : "c_client_demo";
+    const char greeting[] = "hello from C";
+    const unsigned char payload[] = {0, 1, 2, 3};
+    sharedbox_dict *dict = NULL;
+    int64_t answer = 0;
+
+    if (!check(sharedbox_open(name, 10 * 1024 * 1024, 1, 128, &dict), "open"))
+        return 1;
+
+    /* Keys are the UTF-8 bytes of the Python str keys */
+    if (!check(sharedbox_set_str(dict, "greeting", 8, greeting, strlen(greeting), SHAREDBOX_WAIT_FOREVER), "set") ||
+        !check(sharedbox_set_int64(dict, "answer", 6, 42, SHAREDBOX_WAIT_FOREVER), "set") ||
+        !check(sharedbox_set_double(dict, "ratio", 5, 0.25, SHAREDBOX_WAIT_FOREVER), "set") ||
+        !check(sharedbox_set_bytes(dict, "payload", 7, payload, sizeof(payload), 1000), "set"))
+    {
+        sharedbox_close(dict);
+        return 1;
+    }
+
+    if (check(sharedbox_get_int64(dict, "answer", 6, &answer, SHAREDBOX_WAIT_FOREVER), "get"))
+        printf("answer = %lld, %zu entries in '%s'\n", (long long)answer, sharedbox_size(dict), name);
+
+    sharedbox_close(dict); /* the segment stays until sharedbox_unlink() or SharedDict.unlink() */
+    return 0;
+}
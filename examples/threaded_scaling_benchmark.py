@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""
+Threaded Scaling Benchmark: SharedDict throughput versus thread count
+
+With the GIL, threads of one process take turns running Python code, so
+only the time spent waiting for stripe locks overlaps. On free-threaded
+CPython (python3.13t) the threads run in parallel and, as long as they hit
+different lock stripes, throughput should grow with the thread count. This
+benchmark measures:
+1. Read throughput (get) of an increasing number of threads
+2. Mixed throughput with 10% writes
+3. Reads through the local cache
+
+Run with: python examples/threaded_scaling_benchmark.py
+"""
+
+import os
+import sys
+import sysconfig
+import threading
+import time
+
+from sharedbox import SharedDict
+
+SEGMENT_NAME = "threaded_scaling_benchmark"
+KEYS = 100_000
+OPS_PER_THREAD = 200_000
+
+
+def gil_enabled() -> bool:
+    """Whether this interpreter runs with the GIL"""
+    check = getattr(sys, "_is_gil_enabled", None)
+    return True if check is None else check()
+
+
+def worker(d: SharedDict, thread_id: int, write_every: int, barrier: threading.Barrier) -> None:
+    """Run OPS_PER_THREAD operations on keys spread over every stripe"""
+    key = thread_id * 7919
+    barrier.wait()
+    for i in range(OPS_PER_THREAD):
+        key = (key + 104_729) % KEYS
+        if write_every and i % write_every == 0:
+            d[key] = i
+        else:
+            d.get(key)
+
+
+def run(d: SharedDict, threads: int, write_every: int) -> float:
+    """Return operations per second for the given thread count"""
+    barrier = threading.Barrier(threads + 1)
+    pool = [threading.Thread(target=worker, args=(d, t, write_every, barrier)) for t in range(threads)]
+    for t in pool:
+        t.start()
+    barrier.wait()
+    start = time.perf_counter()
+    for t in pool:
+        t.join()
+    return threads * OPS_PER_THREAD / (time.perf_counter() - start)
+
+
+def benchmark(label: str, d: SharedDict, write_every: int = 0) -> None:
+    """Print throughput and speedup over one thread"""
+    print(f"\n{label}")
+    baseline = None
+    counts = sorted({1, 2, 4, 8, os.cpu_count() or 1})
+    for threads in counts:
+        rate = run(d, threads, write_every)
+        baseline = baseline or rate
+        print(f"  {threads:3d} threads: {rate / 1e6:6.2f} M ops/s  ({rate / baseline:4.1f}x)")
+
+
+def main() -> None:
+    print("=" * 60)
+    print("SharedDict threaded scaling")
+    print(f"Python {sys.version.split()[0]}, GIL {'enabled' if gil_enabled() else 'disabled'}, "
+          f"free-threaded build: {bool(sysconfig.get_config_var('Py_GIL_DISABLED'))}, "
+          f"{os.cpu_count()} CPUs")
+    print("=" * 60)
+
+    d = SharedDict(SEGMENT_NAME, {i: i for i in range(KEYS)}, size=256 * 1024 * 1024, max_keys=1024)
+    cached = SharedDict(SEGMENT_NAME, create=False, local_cache_size=KEYS)
+    try:
+        benchmark("Reads", d)
+        benchmark("Reads with 10% writes", d, write_every=10)
+        benchmark("Reads through the local cache", cached)
+    finally:
+        cached.close()
+        d.close()
+        d.unlink()
+
+
+if __name__ == "__main__":
+    main()
@@ -1,3 +1,3 @@
-from ._shareddict import SharedDict
+from ._shareddict import LockTimeout, MemoryPressure, SharedDict, SharedDictBatch, SharedDictWriter
 
-__all__ = ["SharedDict"]
+__all__ = ["LockTimeout", "MemoryPressure", "SharedDict", "SharedDictBatch", "SharedDictWriter"]
@@ -0,0 +1,468 @@
+#pragma once
+
+#include "sharedmemory.hpp"
+
+#include <boost/interprocess/offset_ptr.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <functional>
+#include <new>
+#include <type_traits>
+
+namespace shared_memory
+{
+
+    // Default SharedMap hash. Every process must agree on it, so it depends
+    // only on the key's bytes and never on std::hash
+    template <class K, class Enable = void>
+    struct SharedMapHash
+    {
+        static_assert(std::has_unique_object_representations_v<K>,
+                      "keys with padding or floating-point members need an explicit Hash and KeyEqual");
+
+        std::uint64_t operator()(const K &key) const noexcept
+        {
+            const auto *bytes = reinterpret_cast<const unsigned char *>(&key);
+            std::uint64_t h = 1469598103934665603ull; // FNV-1a
+            for (std::size_t i = 0; i < sizeof(K); ++i)
+            {
+                h ^= bytes[i];
+                h *= 1099511628211ull;
+            }
+            return mix64(h);
+        }
+    };
+
+    template <class K>
+    struct SharedMapHash<K, std::enable_if_t<std::is_integral_v<K> || std::is_enum_v<K>>>
+    {
+        std::uint64_t operator()(K key) const noexcept { return mix64(static_cast<std::uint64_t>(key)); }
+    };
+
+    // Hash map of fixed-size keys and values in a shared memory segment. It
+    // uses the same segment header, lock stripes and LockWait handling as
+    // SharedMemoryDict, but each stripe is an open-addressing table storing
+    // keys and values inline, so lookups never allocate, serialize or compare
+    // byte strings. Hash and KeyEqual must behave identically in every process
+    template <class K, class V, class Hash = SharedMapHash<K>, class KeyEqual = std::equal_to<K>>
+    class SharedMap
+    {
+        static_assert(std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<V>,
+                      "SharedMap keys and values are copied between processes as raw bytes");
+
+    public:
+        SharedMap(const std::string &name, std::size_t size, bool create, std::size_t stripe_count = 128)
+            : name_(name)
+        {
+            use_mapping(open_segment(name, size, create, stripe_count, kind(), &build_stripes));
+        }
+
+        // Reopens the segment identified by name and generation, see SharedMemoryDict
+        SharedMap(const std::string &name, std::uint64_t generation) : name_(name)
+        {
+            use_mapping(reopen_segment(name, generation, kind()));
+        }
+
+        // Inserts or overwrites. Throws LockTimeout if the stripe lock cannot be
+        // acquired within `wait`, and bipc::bad_alloc if the table cannot grow;
+        // nothing is modified in either case
+        void set(const K &key, const V &value, LockWait wait = LockWait::forever())
+        {
+            check_not_closed();
+            const std::uint64_t h = hash_(key);
+            Stripe &stripe = stripe_for(h);
+            lock_stripe(stripe.mutex, wait);
+            bipc::scoped_lock<Mutex> guard(stripe.mutex, bipc::accept_ownership);
+
+            std::size_t i = find_slot(stripe, key, h);
+            if (i == NPOS)
+            {
+                if ((stripe.used + 1) * 8 > stripe.capacity * 7)
+                    rehash(stripe);
+                i = free_slot(stripe.ctrl.get(), stripe.capacity, h);
+                if (stripe.ctrl[i] == EMPTY)
+                    ++stripe.used;
+                new (&stripe.slots[i]) Slot{key, value};
+                stripe.ctrl[i] = fingerprint(h);
+                ++stripe.size;
+                header_->entry_count.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                stripe.slots[i].value = value;
+            }
+            stripe.version.fetch_add(1, std::memory_order_release);
+        }
+
+        bool get(const K &key, V &out, LockWait wait = LockWait::forever()) const
+        {
+            check_not_closed();
+            const std::uint64_t h = hash_(key);
+            Stripe &stripe = stripe_for(h);
+            lock_stripe(stripe.mutex, wait);
+            bipc::scoped_lock<Mutex> guard(stripe.mutex, bipc::accept_ownership);
+
+            std::size_t i = find_slot(stripe, key, h);
+            if (i == NPOS)
+                return false;
+            out = stripe.slots[i].value;
+            return true;
+        }
+
+        // Looks up keys[0..count), setting found[i] and, for keys present,
+        // values[i]. Keys are grouped by stripe so each stripe lock is taken
+        // once, and within a stripe their first probe groups are prefetched a
+        // batch at a time before any is probed, so the cache misses of a group overlap
+        // instead of each probe waiting on the previous one. A timed wait
+        // bounds the whole batch. Returns the number of keys found
+        std::size_t get_many(const K *keys, std::size_t count, V *values, bool *found,
+                             LockWait wait = LockWait::forever()) const
+        {
+            check_not_closed();
+            std::vector<std::uint64_t> hashes(count);
+            std::vector<std::uint32_t> stripe_of(count);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                hashes[i] = hash_(keys[i]);
+                stripe_of[i] = static_cast<std::uint32_t>(stripe_index(hashes[i]));
+                found[i] = false;
+            }
+            std::vector<std::size_t> group_start, order;
+            group_by_stripe(stripe_of, stripe_count_, group_start, order);
+
+            std::size_t hits = 0;
+            for (std::size_t s = 0; s < stripe_count_; ++s)
+            {
+                const std::size_t begin = group_start[s];
+                const std::size_t end = group_start[s + 1];
+                if (begin == end)
+                    continue;
+
+                Stripe &stripe = stripes_[s];
+                lock_stripe(stripe.mutex, wait);
+                bipc::scoped_lock<Mutex> guard(stripe.mutex, bipc::accept_ownership);
+                if (stripe.capacity == 0)
+                    continue;
+
+                for (std::size_t base = begin; base < end; base += PREFETCH_BATCH)
+                {
+                    const std::size_t stop = base + PREFETCH_BATCH < end ? base + PREFETCH_BATCH : end;
+                    for (std::size_t j = base; j < stop; ++j)
+                    {
+                        const std::size_t first = home_group(stripe.capacity, hashes[order[j]]) * GROUP_SIZE;
+                        prefetch(&stripe.ctrl[first]);
+                        prefetch(&stripe.slots[first]);
+                    }
+                    for (std::size_t j = base; j < stop; ++j)
+                    {
+                        const std::size_t k = order[j];
+                        const std::size_t i = find_slot(stripe, keys[k], hashes[k]);
+                        if (i != NPOS)
+                        {
+                            values[k] = stripe.slots[i].value;
+                            found[k] = true;
+                            ++hits;
+                        }
+                    }
+                }
+            }
+            return hits;
+        }
+
+        bool erase(const K &key, LockWait wait = LockWait::forever())
+        {
+            check_not_closed();
+            const std::uint64_t h = hash_(key);
+            Stripe &stripe = stripe_for(h);
+            lock_stripe(stripe.mutex, wait);
+            bipc::scoped_lock<Mutex> guard(stripe.mutex, bipc::accept_ownership);
+
+            std::size_t i = find_slot(stripe, key, h);
+            if (i == NPOS)
+                return false;
+            // Probes stop at the first group with an empty slot, and a group only
+            // gains one while it already has one, so no probe has ever passed
+            // through such a group: its slots can be emptied outright instead of
+            // leaving a tombstone
+            if (match_empty(load_group(&stripe.ctrl[i / GROUP_SIZE * GROUP_SIZE])) != 0)
+            {
+                stripe.ctrl[i] = EMPTY;
+                --stripe.used;
+            }
+            else
+            {
+                stripe.ctrl[i] = DELETED;
+            }
+            --stripe.size;
+            header_->entry_count.fetch_sub(1, std::memory_order_relaxed);
+            stripe.version.fetch_add(1, std::memory_order_release);
+            return true;
+        }
+
+        bool contains(const K &key, LockWait wait = LockWait::forever()) const
+        {
+            check_not_closed();
+            const std::uint64_t h = hash_(key);
+            Stripe &stripe = stripe_for(h);
+            lock_stripe(stripe.mutex, wait);
+            bipc::scoped_lock<Mutex> guard(stripe.mutex, bipc::accept_ownership);
+            return find_slot(stripe, key, h) != NPOS;
+        }
+
+        std::size_t size() const
+        {
+            check_not_closed();
+            return static_cast<std::size_t>(header_->entry_count.load(std::memory_order_relaxed));
+        }
+
+        // Calls fn(key, value) for every entry, locking one stripe at a time; fn
+        // must not call back into this map. Entries written concurrently to a
+        // stripe that has already been visited are not seen
+        template <class Fn>
+        void for_each(Fn &&fn, LockWait wait = LockWait::forever()) const
+        {
+            check_not_closed();
+            for (std::size_t s = 0; s < stripe_count_; ++s)
+            {
+                Stripe &stripe = stripes_[s];
+                lock_stripe(stripe.mutex, wait);
+                bipc::scoped_lock<Mutex> guard(stripe.mutex, bipc::accept_ownership);
+                for (std::size_t i = 0; i < stripe.capacity; ++i)
+                {
+                    if (is_full(stripe.ctrl[i]))
+                        fn(static_cast<const K &>(stripe.slots[i].key), static_cast<const V &>(stripe.slots[i].value));
+                }
+            }
+        }
+
+        std::size_t stripe_count() const { return stripe_count_; }
+        std::uint64_t generation() const { return header_->generation; }
+        const std::string &name() const { return name_; }
+
+        void close() { is_closed_ = true; }
+        void unlink() { bipc::shared_memory_object::remove(name_.c_str()); }
+        bool is_closed() const { return is_closed_; }
+
+    private:
+        struct Slot
+        {
+            K key;
+            V value;
+        };
+
+        // Control bytes, one per slot as in SwissTable: a full slot holds the
+        // low 7 bits of its key's hash, so a probe compares whole keys only on
+        // fingerprint matches. The high bit marks empty and deleted slots
+        static constexpr std::uint8_t EMPTY = 0x80;
+        static constexpr std::uint8_t DELETED = 0xFE;
+
+        // Slots are probed a group at a time: GROUP_SIZE control bytes are
+        // loaded as one word and matched with SWAR bit tricks, which needs no
+        // SIMD instruction set
+        static constexpr std::size_t GROUP_SIZE = 8;
+        static constexpr std::uint64_t LSBS = 0x0101010101010101ull;
+        static constexpr std::uint64_t MSBS = 0x8080808080808080ull;
+
+        static constexpr std::size_t NPOS = ~std::size_t(0);
+        static constexpr std::size_t NEXT_GROUP = NPOS - 1; // returned by probe callbacks to continue
+        static constexpr std::size_t MIN_CAPACITY = 16;
+        // Keys whose first groups get_many() prefetches before probing them;
+        // enough misses in flight to cover DRAM latency without evicting each other
+        static constexpr std::size_t PREFETCH_BATCH = 16;
+
+        static_assert(alignof(Slot) <= segment_manager_t::memory_algorithm::Alignment,
+                      "SharedMap slots need stricter alignment than the segment allocator provides");
+
+        // One lock stripe: a table of groups probed quadratically that grows at
+        // 7/8 occupancy (tombstones included), so every probe reaches an empty
+        // slot. Tables live in the segment heap behind offset
+        // pointers, since every process maps the segment at its own address
+        struct Stripe
+        {
+            Mutex mutex;
+            Version version{0};
+            bipc::offset_ptr<std::uint8_t> ctrl;
+            bipc::offset_ptr<Slot> slots;
+            std::uint64_t capacity = 0; // a power of two, or 0 before the first insert
+            std::uint64_t size = 0;
+            std::uint64_t used = 0; // full and deleted slots
+        };
+
+        static SegmentKind kind()
+        {
+            return SegmentKind{SegmentKind::TYPED_MAP, static_cast<std::uint32_t>(sizeof(K)),
+                               static_cast<std::uint32_t>(sizeof(V))};
+        }
+
+        static void *build_stripes(segment_t &segment, std::size_t stripe_count)
+        {
+            return segment.construct<Stripe>(bipc::anonymous_instance)[stripe_count]();
+        }
+
+        void use_mapping(std::shared_ptr<SegmentMapping> mapping)
+        {
+            char *base = static_cast<char *>(mapping->region.get_address());
+            header_ = reinterpret_cast<SegmentHeader *>(base);
+            manager_ = mapping->segment.get_segment_manager();
+            stripes_ = reinterpret_cast<Stripe *>(base + header_->stripes_offset);
+            stripe_count_ = header_->stripe_count;
+            mapping_ = std::move(mapping);
+        }
+
+        void check_not_closed() const
+        {
+            if (is_closed_)
+            {
+                throw std::runtime_error("SharedMap has been closed and cannot be used");
+            }
+        }
+
+        // High bits pick the stripe and low bits the slot, so the two stay independent
+        std::size_t stripe_index(std::uint64_t h) const { return (h >> 32) % stripe_count_; }
+        Stripe &stripe_for(std::uint64_t h) const { return stripes_[stripe_index(h)]; }
+
+        static bool is_full(std::uint8_t c) { return c < 0x80; }
+        static std::uint8_t fingerprint(std::uint64_t h) { return static_cast<std::uint8_t>(h & 0x7F); }
+
+        // The control bytes of a group as a little-endian word, so byte k of
+        // the group is bits 8k..8k+7 on any host
+        static std::uint64_t load_group(const std::uint8_t *ctrl)
+        {
+            std::uint64_t word;
+            std::memcpy(&word, ctrl, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            word = __builtin_bswap64(word);
+#endif
+            return word;
+        }
+
+        // Masks with the high bit of each matching byte set. match_fingerprint
+        // may also flag a full byte just above a real match, which the key
+        // comparison then rejects; it never misses one
+        static std::uint64_t match_fingerprint(std::uint64_t group, std::uint8_t fp)
+        {
+            const std::uint64_t x = group ^ (LSBS * fp);
+            return (x - LSBS) & ~x & MSBS;
+        }
+        static std::uint64_t match_empty(std::uint64_t group) { return group & ~(group << 6) & MSBS; }
+        static std::uint64_t match_empty_or_deleted(std::uint64_t group) { return group & ~(group << 7) & MSBS; }
+
+        // Index within the group of the lowest byte flagged in a nonzero mask
+        static std::size_t lowest_byte(std::uint64_t mask)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return static_cast<std::size_t>(__builtin_ctzll(mask)) / 8;
+#else
+            std::size_t k = 0;
+            while ((mask & 0x80) == 0)
+            {
+                mask >>= 8;
+                ++k;
+            }
+            return k;
+#endif
+        }
+
+        // The stripe index takes the high hash bits and the fingerprint the low 7
+        static std::size_t home_group(std::size_t capacity, std::uint64_t h)
+        {
+            return static_cast<std::size_t>(h >> 7) & (capacity / GROUP_SIZE - 1);
+        }
+
+        // Visits the groups of h's probe sequence until fn returns a slot index;
+        // triangular steps visit every group of a power-of-two table
+        template <class Fn>
+        static std::size_t probe(const std::uint8_t *ctrl, std::size_t capacity, std::uint64_t h, Fn &&fn)
+        {
+            const std::size_t mask = capacity / GROUP_SIZE - 1;
+            std::size_t g = home_group(capacity, h);
+            for (std::size_t step = 1;; ++step)
+            {
+                const std::size_t i = fn(g * GROUP_SIZE, load_group(ctrl + g * GROUP_SIZE));
+                if (i != NEXT_GROUP)
+                    return i;
+                g = (g + step) & mask;
+            }
+        }
+
+        std::size_t find_slot(const Stripe &stripe, const K &key, std::uint64_t h) const
+        {
+            if (stripe.capacity == 0)
+                return NPOS;
+            const std::uint8_t fp = fingerprint(h);
+            return probe(stripe.ctrl.get(), stripe.capacity, h, [&](std::size_t first, std::uint64_t group) -> std::size_t
+                         {
+                             for (std::uint64_t m = match_fingerprint(group, fp); m != 0; m &= m - 1)
+                             {
+                                 const std::size_t i = first + lowest_byte(m);
+                                 if (equal_(stripe.slots[i].key, key))
+                                     return i;
+                             }
+                             return match_empty(group) != 0 ? NPOS : NEXT_GROUP; });
+        }
+
+        // First reusable slot on the probe sequence of a key known to be absent
+        static std::size_t free_slot(const std::uint8_t *ctrl, std::size_t capacity, std::uint64_t h)
+        {
+            return probe(ctrl, capacity, h, [](std::size_t first, std::uint64_t group) -> std::size_t
+                         {
+                             const std::uint64_t m = match_empty_or_deleted(group);
+                             return m != 0 ? first + lowest_byte(m) : NEXT_GROUP; });
+        }
+
+        // Rebuilds the stripe's table with room for at least one more entry at
+        // no more than half load, which also drops its tombstones. The new table
+        // is complete before the old one is freed, so a failed allocation
+        // leaves the stripe untouched
+        void rehash(Stripe &stripe)
+        {
+            std::size_t capacity = MIN_CAPACITY;
+            while ((stripe.size + 1) * 2 > capacity)
+                capacity *= 2;
+
+            auto *ctrl = static_cast<std::uint8_t *>(manager_->allocate(capacity));
+            Slot *slots;
+            try
+            {
+                slots = static_cast<Slot *>(manager_->allocate(capacity * sizeof(Slot)));
+            }
+            catch (...)
+            {
+                manager_->deallocate(ctrl);
+                throw;
+            }
+            std::memset(ctrl, EMPTY, capacity);
+
+            for (std::size_t i = 0; i < stripe.capacity; ++i)
+            {
+                if (!is_full(stripe.ctrl[i]))
+                    continue;
+                const std::uint64_t h = hash_(stripe.slots[i].key);
+                const std::size_t j = free_slot(ctrl, capacity, h);
+                new (&slots[j]) Slot(stripe.slots[i]);
+                ctrl[j] = fingerprint(h);
+            }
+
+            if (stripe.capacity != 0)
+            {
+                manager_->deallocate(stripe.ctrl.get());
+                manager_->deallocate(stripe.slots.get());
+            }
+            stripe.ctrl = ctrl;
+            stripe.slots = slots;
+            stripe.capacity = capacity;
+            stripe.used = stripe.size;
+        }
+
+        std::string name_;
+        bool is_closed_ = false;
+        std::size_t stripe_count_ = 0;
+        Hash hash_;
+        KeyEqual equal_;
+
+        std::shared_ptr<SegmentMapping> mapping_;
+        SegmentHeader *header_ = nullptr;
+        segment_manager_t *manager_ = nullptr;
+        Stripe *stripes_ = nullptr;
+    };
+
+} // namespace shared_memory
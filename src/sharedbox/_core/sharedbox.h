@@ -0,0 +1,131 @@
+/*
+ * C interface to sharedbox segments.
+ *
+ * Lets programs that cannot use the C++ API (C, Rust, Go, ...) share a
+ * segment with Python SharedDict instances. Keys are byte strings; Python
+ * str keys are their UTF-8 bytes, int keys come from sharedbox_int_key() and
+ * bytes keys are the byte 0xFE followed by their contents. The typed setters
+ * and getters use the value encodings described in docs/format.md, so what they write reads back
+ * as bytes, str, int and float in Python and vice versa.
+ *
+ * Every function returning sharedbox_status reports failures through it and
+ * never lets a C++ exception escape; sharedbox_last_error() describes the
+ * last failure on the calling thread.
+ */
+#ifndef SHAREDBOX_H
+#define SHAREDBOX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The shared library exports every symbol; only its users need a marker */
+#if defined(_WIN32) && defined(SHAREDBOX_SHARED) && !defined(SHAREDBOX_BUILDING)
+#define SHAREDBOX_API __declspec(dllimport)
+#else
+#define SHAREDBOX_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped on any incompatible change to the functions below */
+#define SHAREDBOX_C_API_VERSION 1
+
+/* Wait arguments: a positive value is a timeout in microseconds */
+#define SHAREDBOX_WAIT_FOREVER (-1)
+#define SHAREDBOX_NO_WAIT 0
+
+typedef enum sharedbox_status
+{
+    SHAREDBOX_OK = 0,
+    SHAREDBOX_NOT_FOUND = 1,  /* no such key */
+    SHAREDBOX_TIMEOUT = 2,    /* the stripe lock was not acquired in time; nothing changed */
+    SHAREDBOX_WRONG_TYPE = 3, /* the value exists but has another encoding */
+    SHAREDBOX_INVALID = 4,    /* bad argument, or the handle has been closed */
+    SHAREDBOX_NO_MEMORY = 5,  /* the segment (or the process heap) is full, or past its high-water mark */
+    SHAREDBOX_ERROR = 6       /* any other failure; see sharedbox_last_error() */
+} sharedbox_status;
+
+typedef struct sharedbox_dict sharedbox_dict;
+
+/* Layout and value-format versions this library reads and writes */
+SHAREDBOX_API uint32_t sharedbox_layout_version(void);
+SHAREDBOX_API uint32_t sharedbox_value_format_version(void);
+
+/* Message for the last failure on this thread; valid until the next call that fails */
+SHAREDBOX_API const char *sharedbox_last_error(void);
+
+/*
+ * Creates the segment (create != 0), or attaches to an existing one. With
+ * create set and a segment of that name already present, attaches to it.
+ * size and max_keys are only used when creating; max_keys is the number of
+ * lock stripes and must be at least 1.
+ */
+SHAREDBOX_API sharedbox_status sharedbox_open(const char *name, size_t size, int create, size_t max_keys,
+                                              sharedbox_dict **out);
+/* Unmaps the segment and frees the handle; NULL is ignored */
+SHAREDBOX_API void sharedbox_close(sharedbox_dict *dict);
+/* Removes the segment name from the system; mappings stay valid until closed */
+SHAREDBOX_API sharedbox_status sharedbox_unlink(const char *name);
+
+/*
+ * Segments created from Python with indexes= index the fields of dict values,
+ * which are always pickled. Every setter below stores a value without index
+ * terms, so the key leaves the indexes, just as when Python stores a value
+ * that is not a dict. Pickled values cannot be indexed from C, so on such a
+ * segment sharedbox_set_raw() refuses them with SHAREDBOX_INVALID instead of
+ * storing a dict that find_by() would not see.
+ */
+
+/* Stores value bytes as-is; the first byte must be a marker from docs/format.md */
+SHAREDBOX_API sharedbox_status sharedbox_set_raw(sharedbox_dict *dict, const void *key, size_t key_len,
+                                                 const void *value, size_t value_len, int64_t wait_us);
+/*
+ * Copies the stored bytes, marker included, into a buffer from malloc() that
+ * the caller releases with sharedbox_free()
+ */
+SHAREDBOX_API sharedbox_status sharedbox_get_raw(const sharedbox_dict *dict, const void *key, size_t key_len,
+                                                 void **value, size_t *value_len, int64_t wait_us);
+
+/* Typed values; strings are UTF-8 and are returned NUL-terminated */
+SHAREDBOX_API sharedbox_status sharedbox_set_bytes(sharedbox_dict *dict, const void *key, size_t key_len,
+                                                   const void *data, size_t data_len, int64_t wait_us);
+SHAREDBOX_API sharedbox_status sharedbox_get_bytes(const sharedbox_dict *dict, const void *key, size_t key_len,
+                                                   void **data, size_t *data_len, int64_t wait_us);
+SHAREDBOX_API sharedbox_status sharedbox_set_str(sharedbox_dict *dict, const void *key, size_t key_len,
+                                                 const char *utf8, size_t utf8_len, int64_t wait_us);
+SHAREDBOX_API sharedbox_status sharedbox_get_str(const sharedbox_dict *dict, const void *key, size_t key_len,
+                                                 char **utf8, size_t *utf8_len, int64_t wait_us);
+SHAREDBOX_API sharedbox_status sharedbox_set_int64(sharedbox_dict *dict, const void *key, size_t key_len,
+                                                   int64_t value, int64_t wait_us);
+SHAREDBOX_API sharedbox_status sharedbox_get_int64(const sharedbox_dict *dict, const void *key, size_t key_len,
+                                                   int64_t *value, int64_t wait_us);
+SHAREDBOX_API sharedbox_status sharedbox_set_double(sharedbox_dict *dict, const void *key, size_t key_len,
+                                                    double value, int64_t wait_us);
+SHAREDBOX_API sharedbox_status sharedbox_get_double(const sharedbox_dict *dict, const void *key, size_t key_len,
+                                                    double *value, int64_t wait_us);
+
+SHAREDBOX_API sharedbox_status sharedbox_erase(sharedbox_dict *dict, const void *key, size_t key_len,
+                                               int64_t wait_us);
+/* SHAREDBOX_OK if present, SHAREDBOX_NOT_FOUND if not */
+SHAREDBOX_API sharedbox_status sharedbox_contains(const sharedbox_dict *dict, const void *key, size_t key_len,
+                                                  int64_t wait_us);
+/* Number of entries; 0 for a closed or NULL handle */
+SHAREDBOX_API size_t sharedbox_size(const sharedbox_dict *dict);
+
+/*
+ * Writes the stored form of the Python int key `value` (SHAREDBOX_INT_KEY_SIZE
+ * bytes) to `out` and returns its length, for use as key/key_len
+ */
+#define SHAREDBOX_INT_KEY_SIZE 9
+SHAREDBOX_API size_t sharedbox_int_key(int64_t value, void *out);
+
+/* Releases buffers returned by the getters */
+SHAREDBOX_API void sharedbox_free(void *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHAREDBOX_H */
@@ -0,0 +1,363 @@
+#include "sharedbox.h"
+
+#include "sharedmemory.hpp"
+#include "value_format.hpp"
+
+#include <boost/interprocess/exceptions.hpp>
+#include <cstdlib>
+#include <new>
+
+using namespace shared_memory;
+
+struct sharedbox_dict
+{
+    sharedbox_dict(const char *name, size_t size, bool create, size_t max_keys)
+        : dict(name, size, create, max_keys)
+    {
+    }
+
+    SharedMemoryDict dict;
+};
+
+namespace
+{
+    thread_local std::string last_error;
+
+    sharedbox_status fail(sharedbox_status status, const char *message)
+    {
+        last_error = message;
+        return status;
+    }
+
+    // Runs fn, turning every exception into a status so none crosses the C boundary
+    template <class Fn>
+    sharedbox_status guarded(Fn &&fn) noexcept
+    {
+        try
+        {
+            return fn();
+        }
+        catch (const LockTimeout &e)
+        {
+            return fail(SHAREDBOX_TIMEOUT, e.what());
+        }
+        catch (const MemoryPressure &e)
+        {
+            return fail(SHAREDBOX_NO_MEMORY, e.what());
+        }
+        catch (const bipc::bad_alloc &e)
+        {
+            return fail(SHAREDBOX_NO_MEMORY, e.what());
+        }
+        catch (const std::bad_alloc &)
+        {
+            return fail(SHAREDBOX_NO_MEMORY, "out of memory");
+        }
+        catch (const std::invalid_argument &e)
+        {
+            return fail(SHAREDBOX_INVALID, e.what());
+        }
+        catch (const std::exception &e)
+        {
+            return fail(SHAREDBOX_ERROR, e.what());
+        }
+        catch (...)
+        {
+            return fail(SHAREDBOX_ERROR, "unknown error");
+        }
+    }
+
+    LockWait to_wait(int64_t wait_us)
+    {
+        if (wait_us < 0)
+            return LockWait::forever();
+        return LockWait::for_duration(std::chrono::microseconds(wait_us));
+    }
+
+    std::string_view as_view(const void *data, size_t size)
+    {
+        return std::string_view(static_cast<const char *>(data), size);
+    }
+
+    bool bad_key(const sharedbox_dict *dict, const void *key, size_t key_len)
+    {
+        return dict == nullptr || (key == nullptr && key_len != 0) || dict->dict.is_closed();
+    }
+
+    void write_le64(char *out, uint64_t value)
+    {
+        for (size_t i = 0; i < sizeof(value); ++i)
+            out[i] = static_cast<char>((value >> (i * 8)) & 0xFF);
+    }
+
+    // Pickles may hold dicts, which Python indexes by field; the other
+    // encodings are never indexed
+    bool is_pickled(uint8_t marker)
+    {
+        return marker == PICKLE_MARKER || marker == PICKLE5_MARKER || marker > STR_MARKER;
+    }
+
+    uint64_t read_le64(const char *in)
+    {
+        uint64_t value = 0;
+        for (size_t i = 0; i < sizeof(value); ++i)
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(in[i])) << (i * 8);
+        return value;
+    }
+
+    sharedbox_status set_marked(sharedbox_dict *dict, const void *key, size_t key_len, uint8_t marker,
+                                std::string_view payload, int64_t wait_us)
+    {
+        if (bad_key(dict, key, key_len) || (payload.data() == nullptr && !payload.empty()))
+            return fail(SHAREDBOX_INVALID, "invalid handle or argument");
+        const char marker_byte = static_cast<char>(marker);
+        return guarded([&] {
+            dict->dict.set_parts(as_view(key, key_len), {std::string_view(&marker_byte, 1), payload},
+                                 to_wait(wait_us));
+            return SHAREDBOX_OK;
+        });
+    }
+
+    // Copies the payload after `marker` (the whole value when marker is
+    // negative) into a NUL-terminated buffer from malloc()
+    sharedbox_status get_copy(const sharedbox_dict *dict, const void *key, size_t key_len, int marker,
+                              void **out, size_t *out_len, int64_t wait_us)
+    {
+        if (bad_key(dict, key, key_len) || out == nullptr || out_len == nullptr)
+            return fail(SHAREDBOX_INVALID, "invalid handle or argument");
+        return guarded([&] {
+            sharedbox_status status = SHAREDBOX_OK;
+            bool found = dict->dict.get_with(
+                as_view(key, key_len),
+                [&](std::string_view value) {
+                    if (marker >= 0)
+                    {
+                        if (value.empty() || static_cast<uint8_t>(value[0]) != marker)
+                        {
+                            status = SHAREDBOX_WRONG_TYPE;
+                            return;
+                        }
+                        value.remove_prefix(1);
+                    }
+                    char *buffer = static_cast<char *>(std::malloc(value.size() + 1));
+                    if (buffer == nullptr)
+                        throw std::bad_alloc();
+                    std::memcpy(buffer, value.data(), value.size());
+                    buffer[value.size()] = '\0';
+                    *out = buffer;
+                    *out_len = value.size();
+                },
+                to_wait(wait_us));
+            if (!found)
+                return fail(SHAREDBOX_NOT_FOUND, "key not found");
+            if (status == SHAREDBOX_WRONG_TYPE)
+                return fail(status, "value has a different encoding");
+            return status;
+        });
+    }
+
+    sharedbox_status get_scalar(const sharedbox_dict *dict, const void *key, size_t key_len, uint8_t marker,
+                                uint64_t *bits, int64_t wait_us)
+    {
+        if (bad_key(dict, key, key_len) || bits == nullptr)
+            return fail(SHAREDBOX_INVALID, "invalid handle or argument");
+        return guarded([&] {
+            sharedbox_status status = SHAREDBOX_OK;
+            bool found = dict->dict.get_with(
+                as_view(key, key_len),
+                [&](std::string_view value) {
+                    if (value.size() != 1 + sizeof(uint64_t) || static_cast<uint8_t>(value[0]) != marker)
+                        status = SHAREDBOX_WRONG_TYPE;
+                    else
+                        *bits = read_le64(value.data() + 1);
+                },
+                to_wait(wait_us));
+            if (!found)
+                return fail(SHAREDBOX_NOT_FOUND, "key not found");
+            if (status == SHAREDBOX_WRONG_TYPE)
+                return fail(status, "value has a different encoding");
+            return status;
+        });
+    }
+} // namespace
+
+extern "C"
+{
+
+    uint32_t sharedbox_layout_version(void)
+    {
+        return SegmentHeader::LAYOUT_VERSION;
+    }
+
+    uint32_t sharedbox_value_format_version(void)
+    {
+        return VALUE_FORMAT_VERSION;
+    }
+
+    const char *sharedbox_last_error(void)
+    {
+        return last_error.c_str();
+    }
+
+    sharedbox_status sharedbox_open(const char *name, size_t size, int create, size_t max_keys,
+                                    sharedbox_dict **out)
+    {
+        if (name == nullptr || out == nullptr)
+            return fail(SHAREDBOX_INVALID, "invalid argument");
+        *out = nullptr;
+        return guarded([&] {
+            // Attaching adopts the creator's stripe count, so any value will do
+            *out = new sharedbox_dict(name, size, create != 0, create != 0 ? max_keys : 1);
+            return SHAREDBOX_OK;
+        });
+    }
+
+    void sharedbox_close(sharedbox_dict *dict)
+    {
+        delete dict;
+    }
+
+    sharedbox_status sharedbox_unlink(const char *name)
+    {
+        if (name == nullptr)
+            return fail(SHAREDBOX_INVALID, "invalid argument");
+        return guarded([&] {
+            if (!bipc::shared_memory_object::remove(name))
+                return fail(SHAREDBOX_NOT_FOUND, "no segment with that name");
+            return SHAREDBOX_OK;
+        });
+    }
+
+    sharedbox_status sharedbox_set_raw(sharedbox_dict *dict, const void *key, size_t key_len, const void *value,
+                                       size_t value_len, int64_t wait_us)
+    {
+        if (bad_key(dict, key, key_len) || value == nullptr || value_len == 0)
+            return fail(SHAREDBOX_INVALID, "invalid handle or argument");
+        if (!dict->dict.index_fields().empty() && is_pickled(*static_cast<const uint8_t *>(value)))
+            return fail(SHAREDBOX_INVALID, "pickled values of a segment with secondary indexes must be written "
+                                           "from Python, which computes their index terms");
+        return guarded([&] {
+            dict->dict.set(as_view(key, key_len), as_view(value, value_len), to_wait(wait_us));
+            return SHAREDBOX_OK;
+        });
+    }
+
+    sharedbox_status sharedbox_get_raw(const sharedbox_dict *dict, const void *key, size_t key_len, void **value,
+                                       size_t *value_len, int64_t wait_us)
+    {
+        return get_copy(dict, key, key_len, -1, value, value_len, wait_us);
+    }
+
+    sharedbox_status sharedbox_set_bytes(sharedbox_dict *dict, const void *key, size_t key_len, const void *data,
+                                         size_t data_len, int64_t wait_us)
+    {
+        return set_marked(dict, key, key_len, BYTES_MARKER, as_view(data, data_len), wait_us);
+    }
+
+    sharedbox_status sharedbox_get_bytes(const sharedbox_dict *dict, const void *key, size_t key_len, void **data,
+                                         size_t *data_len, int64_t wait_us)
+    {
+        return get_copy(dict, key, key_len, BYTES_MARKER, data, data_len, wait_us);
+    }
+
+    sharedbox_status sharedbox_set_str(sharedbox_dict *dict, const void *key, size_t key_len, const char *utf8,
+                                       size_t utf8_len, int64_t wait_us)
+    {
+        return set_marked(dict, key, key_len, STR_MARKER, std::string_view(utf8, utf8_len), wait_us);
+    }
+
+    sharedbox_status sharedbox_get_str(const sharedbox_dict *dict, const void *key, size_t key_len, char **utf8,
+                                       size_t *utf8_len, int64_t wait_us)
+    {
+        if (utf8 == nullptr)
+            return fail(SHAREDBOX_INVALID, "invalid handle or argument");
+        void *buffer = nullptr;
+        sharedbox_status status = get_copy(dict, key, key_len, STR_MARKER, &buffer, utf8_len, wait_us);
+        *utf8 = static_cast<char *>(buffer);
+        return status;
+    }
+
+    sharedbox_status sharedbox_set_int64(sharedbox_dict *dict, const void *key, size_t key_len, int64_t value,
+                                         int64_t wait_us)
+    {
+        char payload[sizeof(uint64_t)];
+        write_le64(payload, static_cast<uint64_t>(value));
+        return set_marked(dict, key, key_len, INT_MARKER, std::string_view(payload, sizeof(payload)), wait_us);
+    }
+
+    sharedbox_status sharedbox_get_int64(const sharedbox_dict *dict, const void *key, size_t key_len,
+                                         int64_t *value, int64_t wait_us)
+    {
+        uint64_t bits = 0;
+        sharedbox_status status = get_scalar(dict, key, key_len, INT_MARKER, value ? &bits : nullptr, wait_us);
+        if (status == SHAREDBOX_OK)
+            *value = static_cast<int64_t>(bits);
+        return status;
+    }
+
+    sharedbox_status sharedbox_set_double(sharedbox_dict *dict, const void *key, size_t key_len, double value,
+                                          int64_t wait_us)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        char payload[sizeof(uint64_t)];
+        write_le64(payload, bits);
+        return set_marked(dict, key, key_len, FLOAT_MARKER, std::string_view(payload, sizeof(payload)), wait_us);
+    }
+
+    sharedbox_status sharedbox_get_double(const sharedbox_dict *dict, const void *key, size_t key_len,
+                                          double *value, int64_t wait_us)
+    {
+        uint64_t bits = 0;
+        sharedbox_status status = get_scalar(dict, key, key_len, FLOAT_MARKER, value ? &bits : nullptr, wait_us);
+        if (status == SHAREDBOX_OK)
+            std::memcpy(value, &bits, sizeof(bits));
+        return status;
+    }
+
+    sharedbox_status sharedbox_erase(sharedbox_dict *dict, const void *key, size_t key_len, int64_t wait_us)
+    {
+        if (bad_key(dict, key, key_len))
+            return fail(SHAREDBOX_INVALID, "invalid handle or argument");
+        return guarded([&] {
+            if (!dict->dict.erase(as_view(key, key_len), to_wait(wait_us)))
+                return fail(SHAREDBOX_NOT_FOUND, "key not found");
+            return SHAREDBOX_OK;
+        });
+    }
+
+    sharedbox_status sharedbox_contains(const sharedbox_dict *dict, const void *key, size_t key_len,
+                                        int64_t wait_us)
+    {
+        if (bad_key(dict, key, key_len))
+            return fail(SHAREDBOX_INVALID, "invalid handle or argument");
+        return guarded([&] {
+            return dict->dict.contains(as_view(key, key_len), to_wait(wait_us)) ? SHAREDBOX_OK
+                                                                                 : SHAREDBOX_NOT_FOUND;
+        });
+    }
+
+    size_t sharedbox_size(const sharedbox_dict *dict)
+    {
+        if (dict == nullptr || dict->dict.is_closed())
+            return 0;
+        return dict->dict.size();
+    }
+
+    size_t sharedbox_int_key(int64_t value, void *out)
+    {
+        static_assert(SHAREDBOX_INT_KEY_SIZE == INT_KEY_SIZE, "C and C++ int key sizes differ");
+        char *bytes = static_cast<char *>(out);
+        const uint64_t bits = static_cast<uint64_t>(value) ^ (uint64_t(1) << 63);
+        bytes[0] = static_cast<char>(INT_KEY_TAG);
+        for (size_t i = 1; i < INT_KEY_SIZE; ++i)
+            bytes[i] = static_cast<char>((bits >> ((INT_KEY_SIZE - 1 - i) * 8)) & 0xFF);
+        return INT_KEY_SIZE;
+    }
+
+    void sharedbox_free(void *buffer)
+    {
+        std::free(buffer);
+    }
+
+} // extern "C"
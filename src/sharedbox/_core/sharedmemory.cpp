@@ -1,13 +1,216 @@
 #include "sharedmemory.hpp"
+#include "value_format.hpp"
 #include <boost/interprocess/shared_memory_object.hpp>
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
 #include <thread>
 #include <chrono>
+#include <map>
+#include <mutex>
+#include <random>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 
 namespace shared_memory
 {
 
-    ByteVec SharedMemoryDict::make_bytevec(const std::string &s, segment_manager_t *mgr)
+    namespace
+    {
+        // Every segment this process has mapped, so handles unpickled here (or
+        // inherited through fork()) reuse the mapping instead of opening it again
+        struct MappingRegistry
+        {
+            std::mutex mutex;
+            std::map<std::pair<std::string, std::uint64_t>, std::weak_ptr<SegmentMapping>> mappings;
+        };
+
+        MappingRegistry *registry_instance = nullptr;
+
+        // Never destroyed: handles may outlive static destruction
+        MappingRegistry &registry()
+        {
+            static MappingRegistry *instance = []
+            {
+                registry_instance = new MappingRegistry();
+#ifndef _WIN32
+                // A fork() while another thread holds the lock must not leave it held in the child
+                pthread_atfork([]
+                               { registry_instance->mutex.lock(); },
+                               []
+                               { registry_instance->mutex.unlock(); },
+                               []
+                               { registry_instance->mutex.unlock(); });
+#endif
+                return registry_instance;
+            }();
+            return *instance;
+        }
+
+        void register_mapping(const std::string &name, std::uint64_t generation,
+                              const std::shared_ptr<SegmentMapping> &mapping)
+        {
+            MappingRegistry &r = registry();
+            std::lock_guard<std::mutex> guard(r.mutex);
+            for (auto it = r.mappings.begin(); it != r.mappings.end();)
+            {
+                it = it->second.expired() ? r.mappings.erase(it) : std::next(it);
+            }
+            // Keep an existing live mapping, so every handle keeps sharing the first one
+            auto &entry = r.mappings[{name, generation}];
+            if (entry.expired())
+            {
+                entry = mapping;
+            }
+        }
+
+        std::shared_ptr<SegmentMapping> find_mapping(const std::string &name, std::uint64_t generation)
+        {
+            MappingRegistry &r = registry();
+            std::lock_guard<std::mutex> guard(r.mutex);
+            auto it = r.mappings.find({name, generation});
+            return it != r.mappings.end() ? it->second.lock() : nullptr;
+        }
+
+        std::uint64_t new_generation()
+        {
+            std::random_device rd;
+            std::uint64_t g = (static_cast<std::uint64_t>(rd()) << 32) ^ rd() ^
+                              static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+            return g != 0 ? g : 1;
+        }
+
+        void check_kind(const SegmentHeader &header, const std::string &name, SegmentKind kind)
+        {
+            if (header.container_kind != kind.container || header.key_size != kind.key_size ||
+                header.value_size != kind.value_size)
+            {
+                throw std::runtime_error("Shared memory segment '" + name + "' holds a different kind of container");
+            }
+        }
+
+        // The block of a key's stripe filter and the bits it sets there. The
+        // stripe comes from the key hash modulo the stripe count, so the filter
+        // position is drawn from a remix of the hash to stay independent of it
+        struct BloomProbe
+        {
+            std::size_t block;
+            std::uint64_t mask[BLOOM_BLOCK_WORDS] = {};
+        };
+
+        BloomProbe bloom_probe(std::size_t h, std::size_t blocks)
+        {
+            BloomProbe probe;
+            const std::uint64_t g = mix64(static_cast<std::uint64_t>(h) ^ 0x9e3779b97f4a7c15ull);
+            probe.block = static_cast<std::size_t>((g >> 32) % blocks);
+            const std::uint64_t bits = mix64(g);
+            for (std::size_t i = 0; i < BLOOM_PROBES; ++i)
+            {
+                const std::size_t bit = static_cast<std::size_t>(bits >> (9 * i)) & 511;
+                probe.mask[bit / 64] |= std::uint64_t(1) << (bit % 64);
+            }
+            return probe;
+        }
+
+        // Count-min sketch of the tinylfu policy: 4-bit counters, 16 to a word,
+        // 4 rows sharing the stripe's words. Counters saturate at 15 and are
+        // halved once the stripe has recorded SKETCH_RESET_FACTOR accesses per
+        // entry of capacity, so old popularity fades
+        constexpr std::size_t SKETCH_ROWS = 4;
+        constexpr std::uint64_t SKETCH_RESET_FACTOR = 10;
+
+        struct SketchSlot
+        {
+            std::size_t word;
+            unsigned shift;
+        };
+
+        SketchSlot sketch_slot(std::size_t h, std::size_t row, std::size_t words)
+        {
+            const std::uint64_t g = mix64(static_cast<std::uint64_t>(h) ^ 0xc2b2ae3d27d4eb4full);
+            return {static_cast<std::size_t>(mix64(g + row) & (words - 1)),
+                    static_cast<unsigned>(((g >> (4 * row)) & 15) * 4)};
+        }
+
+        void link_front(RecencyList &list, MapValueType &node, std::uint8_t segment)
+        {
+            node.second.segment = segment;
+            node.second.older = list.newest;
+            node.second.newer = nullptr;
+            if (list.newest)
+                list.newest->second.newer = &node;
+            else
+                list.oldest = &node;
+            list.newest = &node;
+            ++list.size;
+        }
+
+        void unlink_node(RecencyList &list, MapValueType &node)
+        {
+            Entry &e = node.second;
+            if (e.newer)
+                e.newer->second.older = e.older;
+            else
+                list.newest = e.older;
+            if (e.older)
+                e.older->second.newer = e.newer;
+            else
+                list.oldest = e.newer;
+            e.newer = e.older = nullptr;
+            --list.size;
+        }
+
+        RecencyList &list_of(CacheState &cache, const MapValueType &node)
+        {
+            return node.second.segment == CacheState::WINDOW ? cache.window : cache.main;
+        }
+
+        // Calls fn(term) for each index term in a buffer built by append_index_term
+        template <class Fn>
+        void for_each_index_term(std::string_view terms, Fn &&fn)
+        {
+            while (terms.size() > sizeof(std::uint32_t))
+            {
+                std::uint32_t size;
+                std::memcpy(&size, terms.data() + 1, sizeof(size));
+                const std::size_t length = std::min(terms.size(), 1 + sizeof(size) + size);
+                fn(terms.substr(0, length));
+                terms.remove_prefix(length);
+            }
+        }
+
+        // Bumps a stripe's version on every way out of a write, so a write that
+        // changed the map and then failed (say, allocating index postings)
+        // still invalidates local caches and restarts compact() copies
+        class VersionBump
+        {
+        public:
+            explicit VersionBump(Version &version) : version_(version) {}
+            ~VersionBump() { version_.fetch_add(1, std::memory_order_release); }
+            VersionBump(const VersionBump &) = delete;
+            VersionBump &operator=(const VersionBump &) = delete;
+
+        private:
+            Version &version_;
+        };
+
+        // compact() copies a stripe about this many bytes of keys and values
+        // per acquisition of its lock, and gives up on a stripe that was
+        // written during COMPACT_ATTEMPTS copies in a row
+        constexpr std::size_t COMPACT_CHUNK_BYTES = 256 * 1024;
+        constexpr int COMPACT_ATTEMPTS = 3;
+
+        // ValueWriter::commit() hands back unused capacity at least this large
+        constexpr std::size_t WRITER_SLACK_BYTES = 4096;
+    } // namespace
+
+    double BloomStats::false_positive_rate() const
+    {
+        return std::pow(fill_ratio(), static_cast<double>(BLOOM_PROBES));
+    }
+
+    ByteVec SharedMemoryDict::make_bytevec(std::string_view s, segment_manager_t *mgr)
     {
         ShmemAlloc<char> alloc(mgr);
         ByteVec v(alloc);
@@ -17,35 +220,324 @@ namespace shared_memory
         return v;
     }
 
-    SharedMemoryDict::SharedMemoryDict(const std::string &name, std::size_t size, bool create, std::size_t max_keys)
+    namespace
+    {
+        std::shared_ptr<SegmentMapping> create_segment(bipc::shared_memory_object &shm, const std::string &name,
+                                                       std::size_t size, std::size_t stripe_count, SegmentKind kind,
+                                                       StripeBuilder build_stripes, const SegmentExtras &extras)
+        {
+            if (size <= SegmentHeader::RESERVED_BYTES)
+            {
+                throw std::invalid_argument("Shared memory size is too small to hold the segment header");
+            }
+            shm.truncate(static_cast<bipc::offset_t>(size));
+            auto mapping = std::make_shared<SegmentMapping>();
+            mapping->region = bipc::mapped_region(shm, bipc::read_write);
+
+            char *base = static_cast<char *>(mapping->region.get_address());
+            SegmentHeader *header = new (base) SegmentHeader();
+            header->magic.store(0, std::memory_order_relaxed);
+            header->entry_count.store(0, std::memory_order_relaxed);
+
+            const std::size_t heap_size = mapping->region.get_size() - SegmentHeader::RESERVED_BYTES;
+            mapping->segment = segment_t(bipc::create_only, base + SegmentHeader::RESERVED_BYTES, heap_size);
+            void *stripes = build_stripes(mapping->segment, stripe_count);
+            // Cache-line aligned, so probing a Bloom block touches one line
+            auto allocate_words = [&](std::size_t words_per_stripe) -> char *
+            {
+                if (words_per_stripe == 0)
+                    return nullptr;
+                const std::size_t words = stripe_count * words_per_stripe;
+                char *p = static_cast<char *>(mapping->segment.get_segment_manager()->allocate_aligned(
+                    words * sizeof(BloomWord), BLOOM_BLOCK_WORDS * sizeof(BloomWord)));
+                for (std::size_t i = 0; i < words; ++i)
+                {
+                    new (p + i * sizeof(BloomWord)) BloomWord(0);
+                }
+                return p;
+            };
+            char *bloom = allocate_words(extras.bloom_words);
+            char *sketch = allocate_words(extras.sketch_words);
+            char *index_names = nullptr;
+            std::size_t index_names_size = 0;
+            StripeIndex *indexes = nullptr;
+            if (!extras.index_fields.empty())
+            {
+                for (const std::string &field : extras.index_fields)
+                    index_names_size += sizeof(std::uint32_t) + field.size();
+                index_names = static_cast<char *>(mapping->segment.allocate(index_names_size));
+                char *p = index_names;
+                for (const std::string &field : extras.index_fields)
+                {
+                    const auto size = static_cast<std::uint32_t>(field.size());
+                    std::memcpy(p, &size, sizeof(size));
+                    std::memcpy(p + sizeof(size), field.data(), field.size());
+                    p += sizeof(size) + field.size();
+                }
+                indexes = mapping->segment.construct<StripeIndex>(bipc::anonymous_instance)[stripe_count](
+                    mapping->segment.get_segment_manager());
+            }
+
+            header->layout_version = SegmentHeader::LAYOUT_VERSION;
+            header->stripe_count = static_cast<std::uint32_t>(stripe_count);
+            header->heap_offset = SegmentHeader::RESERVED_BYTES;
+            header->heap_size = heap_size;
+            header->stripes_offset = static_cast<std::uint64_t>(static_cast<char *>(stripes) - base);
+            header->generation = new_generation();
+            header->container_kind = kind.container;
+            header->key_size = kind.key_size;
+            header->value_size = kind.value_size;
+            header->bloom_words = static_cast<std::uint32_t>(extras.bloom_words);
+            header->bloom_offset = bloom != nullptr ? static_cast<std::uint64_t>(bloom - base) : 0;
+            header->cache_capacity = extras.cache_capacity;
+            header->eviction_policy = static_cast<std::uint32_t>(extras.eviction_policy);
+            header->sketch_words = static_cast<std::uint32_t>(extras.sketch_words);
+            header->sketch_offset = sketch != nullptr ? static_cast<std::uint64_t>(sketch - base) : 0;
+            header->high_water_bytes = static_cast<std::uint64_t>(static_cast<double>(heap_size) * extras.high_water_mark);
+            header->soft_limit_evictions.store(0, std::memory_order_relaxed);
+            header->soft_limit_rejections.store(0, std::memory_order_relaxed);
+            header->index_count = static_cast<std::uint32_t>(extras.index_fields.size());
+            header->index_names_size = static_cast<std::uint32_t>(index_names_size);
+            header->index_names_offset = index_names != nullptr ? static_cast<std::uint64_t>(index_names - base) : 0;
+            header->indexes_offset =
+                indexes != nullptr ? static_cast<std::uint64_t>(reinterpret_cast<char *>(indexes) - base) : 0;
+
+            // Publish: attachers spin on the magic before reading anything else
+            header->magic.store(SegmentHeader::MAGIC, std::memory_order_release);
+
+            register_mapping(name, header->generation, mapping);
+            return mapping;
+        }
+
+        std::shared_ptr<SegmentMapping> attach_segment(bipc::shared_memory_object &shm, const std::string &name,
+                                                       SegmentKind kind)
+        {
+            // A segment that is still being created may not be sized or stamped yet
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            auto wait_or_throw = [&](const char *what)
+            {
+                if (std::chrono::steady_clock::now() > deadline)
+                {
+                    throw std::runtime_error("Shared memory segment '" + name + "' " + what);
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            };
+
+            bipc::offset_t size = 0;
+            while (!shm.get_size(size) || static_cast<std::size_t>(size) < SegmentHeader::RESERVED_BYTES)
+            {
+                wait_or_throw("was never initialized");
+            }
+            auto mapping = std::make_shared<SegmentMapping>();
+            mapping->region = bipc::mapped_region(shm, bipc::read_write);
+
+            char *base = static_cast<char *>(mapping->region.get_address());
+            SegmentHeader *header = reinterpret_cast<SegmentHeader *>(base);
+            std::uint64_t magic;
+            while ((magic = header->magic.load(std::memory_order_acquire)) == 0)
+            {
+                wait_or_throw("was never initialized");
+            }
+            if (magic != SegmentHeader::MAGIC)
+            {
+                throw std::runtime_error("Shared memory segment '" + name + "' is not a sharedbox segment");
+            }
+            if (header->layout_version != SegmentHeader::LAYOUT_VERSION)
+            {
+                throw std::runtime_error("Shared memory segment '" + name + "' uses layout version " +
+                                         std::to_string(header->layout_version) + ", expected " +
+                                         std::to_string(SegmentHeader::LAYOUT_VERSION));
+            }
+            check_kind(*header, name, kind);
+
+            mapping->segment = segment_t(bipc::open_only, base + header->heap_offset, header->heap_size);
+
+            register_mapping(name, header->generation, mapping);
+            return mapping;
+        }
+    } // namespace
+
+    std::shared_ptr<SegmentMapping> open_segment(const std::string &name, std::size_t size, bool create,
+                                                 std::size_t stripe_count, SegmentKind kind,
+                                                 StripeBuilder build_stripes, const SegmentExtras &extras)
+    {
+        if (stripe_count == 0)
+        {
+            throw std::invalid_argument("max_keys must be at least 1");
+        }
+
+        if (create)
+        {
+            std::unique_ptr<bipc::shared_memory_object> shm;
+            try
+            {
+                shm = std::make_unique<bipc::shared_memory_object>(bipc::create_only, name.c_str(), bipc::read_write);
+            }
+            catch (const bipc::interprocess_exception &e)
+            {
+                // Someone else created it first - attach below
+                if (e.get_error_code() != bipc::already_exists_error)
+                    throw;
+            }
+            if (shm)
+            {
+                try
+                {
+                    return create_segment(*shm, name, size, stripe_count, kind, build_stripes, extras);
+                }
+                catch (...)
+                {
+                    bipc::shared_memory_object::remove(name.c_str());
+                    throw;
+                }
+            }
+        }
+
+        bipc::shared_memory_object shm(bipc::open_only, name.c_str(), bipc::read_write);
+        return attach_segment(shm, name, kind);
+    }
+
+    std::shared_ptr<SegmentMapping> reopen_segment(const std::string &name, std::uint64_t generation,
+                                                   SegmentKind kind)
+    {
+        if (std::shared_ptr<SegmentMapping> mapping = find_mapping(name, generation))
+        {
+            check_kind(*static_cast<const SegmentHeader *>(mapping->region.get_address()), name, kind);
+            return mapping;
+        }
+
+        bipc::shared_memory_object shm(bipc::open_only, name.c_str(), bipc::read_write);
+        std::shared_ptr<SegmentMapping> mapping = attach_segment(shm, name, kind);
+        if (static_cast<const SegmentHeader *>(mapping->region.get_address())->generation != generation)
+        {
+            throw std::runtime_error("Shared memory segment '" + name + "' has been recreated since this handle was made");
+        }
+        return mapping;
+    }
+
+    void lock_stripe(Mutex &mutex, LockWait wait)
+    {
+        if (wait.has_deadline())
+        {
+            if (!mutex.timed_lock(wait.deadline()))
+                throw LockTimeout("Timed out waiting for a stripe lock held by another thread or process");
+        }
+        else if (wait.may_block())
+        {
+            mutex.lock();
+        }
+        else if (!mutex.try_lock())
+        {
+            throw LockTimeout("Stripe lock is held by another thread or process");
+        }
+    }
+
+    SharedMemoryDict::SharedMemoryDict(const std::string &name, std::size_t size, bool create, std::size_t max_keys,
+                                       std::size_t bloom_capacity, CacheOptions cache, double high_water_mark,
+                                       const std::vector<std::string> &index_fields)
         : name_(name),
           max_keys_(max_keys),
           is_closed_(false),
-          segment_(create ? segment_t(boost::interprocess::open_or_create, name.c_str(), size)
-                          : segment_t(boost::interprocess::open_only, name.c_str()))
+          header_(nullptr),
+          manager_(nullptr),
+          stripes_(nullptr),
+          bloom_(nullptr),
+          bloom_words_(0),
+          policy_(EvictionPolicy::none),
+          cache_capacity_(0),
+          sketch_(nullptr),
+          sketch_words_(0),
+          indexes_(nullptr)
     {
-        auto *mgr = segment_.get_segment_manager();
-
-        // construct/find data map
-        map_ = segment_.find_or_construct<Map>("__map")(KeyLess(), MapAlloc(mgr));
-
-        // construct/find mutex array - one mutex per key slot
-        std::pair<Mutex *, std::size_t> mutexes_info = segment_.find<Mutex>("__mutexes");
-        if (mutexes_info.first == nullptr)
+        if (!(high_water_mark >= 0.0 && high_water_mark <= 1.0))
         {
-            // First time - construct array of mutexes
-            mutexes_ = segment_.construct<Mutex>("__mutexes")[max_keys_]();
+            throw std::invalid_argument("high_water_mark must be between 0 and 1");
         }
-        else
+        if (index_fields.size() > MAX_INDEX_FIELDS)
+        {
+            throw std::invalid_argument("at most " + std::to_string(MAX_INDEX_FIELDS) + " fields can be indexed");
+        }
+        for (std::size_t i = 0; i < index_fields.size(); ++i)
+        {
+            if (std::find(index_fields.begin(), index_fields.begin() + i, index_fields[i]) != index_fields.begin() + i)
+            {
+                throw std::invalid_argument("field '" + index_fields[i] + "' is indexed twice");
+            }
+        }
+        SegmentExtras extras;
+        extras.high_water_mark = high_water_mark;
+        extras.index_fields = index_fields;
+        if (bloom_capacity != 0 && max_keys != 0)
         {
-            // Already exists - use existing array
-            mutexes_ = mutexes_info.first;
-            // Verify the existing array has enough slots
-            if (mutexes_info.second < max_keys_)
+            // Whole blocks per stripe, at least one
+            const std::size_t block_bits = BLOOM_BLOCK_WORDS * 64;
+            const std::size_t stripe_bits = (bloom_capacity * BLOOM_BITS_PER_KEY + max_keys - 1) / max_keys;
+            extras.bloom_words = (stripe_bits + block_bits - 1) / block_bits * BLOOM_BLOCK_WORDS;
+        }
+        if (cache.max_entries != 0 && cache.policy != EvictionPolicy::none && max_keys != 0)
+        {
+            extras.eviction_policy = cache.policy;
+            extras.cache_capacity = (cache.max_entries + max_keys - 1) / max_keys;
+            if (cache.policy == EvictionPolicy::tinylfu)
             {
-                throw std::runtime_error("Existing shared memory has fewer mutex slots than requested");
+                extras.sketch_words = 1;
+                while (extras.sketch_words < extras.cache_capacity)
+                    extras.sketch_words *= 2;
             }
         }
+        use_mapping(open_segment(name, size, create, max_keys, SegmentKind{}, &build_stripes, extras));
+    }
+
+    SharedMemoryDict::SharedMemoryDict(const std::string &name, std::uint64_t generation)
+        : name_(name),
+          max_keys_(0),
+          is_closed_(false),
+          header_(nullptr),
+          manager_(nullptr),
+          stripes_(nullptr),
+          bloom_(nullptr),
+          bloom_words_(0),
+          policy_(EvictionPolicy::none),
+          cache_capacity_(0),
+          sketch_(nullptr),
+          sketch_words_(0),
+          indexes_(nullptr)
+    {
+        use_mapping(reopen_segment(name, generation, SegmentKind{}));
+    }
+
+    void *SharedMemoryDict::build_stripes(segment_t &segment, std::size_t stripe_count)
+    {
+        return segment.construct<Stripe>(bipc::anonymous_instance)[stripe_count](
+            MapAlloc(segment.get_segment_manager()));
+    }
+
+    // Point this handle at a mapped and validated segment
+    void SharedMemoryDict::use_mapping(std::shared_ptr<Mapping> mapping)
+    {
+        char *base = static_cast<char *>(mapping->region.get_address());
+        header_ = reinterpret_cast<SegmentHeader *>(base);
+        manager_ = mapping->segment.get_segment_manager();
+        stripes_ = reinterpret_cast<Stripe *>(base + header_->stripes_offset);
+        // Stripes are fixed by the creator; every process must hash keys the same way
+        max_keys_ = header_->stripe_count;
+        bloom_words_ = header_->bloom_words;
+        bloom_ = bloom_words_ != 0 ? reinterpret_cast<BloomWord *>(base + header_->bloom_offset) : nullptr;
+        policy_ = static_cast<EvictionPolicy>(header_->eviction_policy);
+        cache_capacity_ = static_cast<std::size_t>(header_->cache_capacity);
+        sketch_words_ = header_->sketch_words;
+        sketch_ = sketch_words_ != 0 ? reinterpret_cast<BloomWord *>(base + header_->sketch_offset) : nullptr;
+        indexes_ = header_->index_count != 0 ? reinterpret_cast<StripeIndex *>(base + header_->indexes_offset) : nullptr;
+        index_fields_.clear();
+        const char *names = base + header_->index_names_offset;
+        for (std::uint32_t i = 0; i < header_->index_count; ++i)
+        {
+            std::uint32_t size;
+            std::memcpy(&size, names, sizeof(size));
+            index_fields_.emplace_back(names + sizeof(size), size);
+            names += sizeof(size) + size;
+        }
+        mapping_ = std::move(mapping);
     }
 
     SharedMemoryDict::~SharedMemoryDict()
@@ -68,8 +560,19 @@ namespace shared_memory
         }
     }
 
-    std::size_t SharedMemoryDict::hash_bytes(const ByteVec &key) noexcept
+    std::size_t SharedMemoryDict::hash_bytes(std::string_view key) noexcept
     {
+        // Integer keys hash their payload in one step
+        if (key.size() == INT_KEY_SIZE && static_cast<unsigned char>(key[0]) == INT_KEY_TAG)
+        {
+            std::uint64_t payload = 0;
+            for (std::size_t i = 1; i < INT_KEY_SIZE; ++i)
+            {
+                payload = (payload << 8) | static_cast<unsigned char>(key[i]);
+            }
+            return static_cast<std::size_t>(mix64(payload));
+        }
+
         // 64-bit FNV-1a hash
         const std::size_t fnv_offset = 1469598103934665603ull;
         const std::size_t fnv_prime = 1099511628211ull;
@@ -82,116 +585,476 @@ namespace shared_memory
         return h;
     }
 
-    std::size_t SharedMemoryDict::get_key_index(const ByteVec &key) const
+    std::size_t SharedMemoryDict::get_key_index(std::string_view key) const
     {
         std::size_t h = hash_bytes(key);
         return h % max_keys_;
     }
 
-    Mutex &SharedMemoryDict::get_mutex_for_key(const ByteVec &key) const
+    Stripe &SharedMemoryDict::get_stripe_for_key(std::string_view key) const
     {
-        std::size_t index = get_key_index(key);
-        return mutexes_[index];
+        return stripes_[get_key_index(key)];
     }
 
-    void SharedMemoryDict::set(const std::string &key_bytes, const std::string &value_bytes)
+    BloomWord *SharedMemoryDict::bloom_block(std::size_t h) const
     {
-        check_not_closed();
-        auto *mgr = segment_.get_segment_manager();
-        ByteVec k = make_bytevec(key_bytes, mgr);
+        return bloom_ + (h % max_keys_) * bloom_words_;
+    }
 
-        Mutex &key_mutex = get_mutex_for_key(k);
-        key_mutex.lock();
-        try
+    bool SharedMemoryDict::may_contain(std::size_t h) const
+    {
+        if (bloom_ == nullptr)
+            return true;
+        const BloomProbe probe = bloom_probe(h, bloom_words_ / BLOOM_BLOCK_WORDS);
+        const BloomWord *block = bloom_block(h) + probe.block * BLOOM_BLOCK_WORDS;
+        for (std::size_t w = 0; w < BLOOM_BLOCK_WORDS; ++w)
+        {
+            if (probe.mask[w] != 0 && (block[w].load(std::memory_order_acquire) & probe.mask[w]) != probe.mask[w])
+                return false;
+        }
+        return true;
+    }
+
+    // Called with the key's stripe lock held, before the key becomes visible
+    void SharedMemoryDict::bloom_add(std::size_t h)
+    {
+        if (bloom_ == nullptr)
+            return;
+        const BloomProbe probe = bloom_probe(h, bloom_words_ / BLOOM_BLOCK_WORDS);
+        BloomWord *block = bloom_block(h) + probe.block * BLOOM_BLOCK_WORDS;
+        for (std::size_t w = 0; w < BLOOM_BLOCK_WORDS; ++w)
+        {
+            if (probe.mask[w] != 0)
+                block[w].fetch_or(probe.mask[w], std::memory_order_release);
+        }
+    }
+
+    void SharedMemoryDict::sketch_increment(Stripe &stripe, std::size_t h) const
+    {
+        if (sketch_ == nullptr)
+            return;
+        BloomWord *words = sketch_ + (&stripe - stripes_) * sketch_words_;
+        for (std::size_t row = 0; row < SKETCH_ROWS; ++row)
+        {
+            const SketchSlot slot = sketch_slot(h, row, sketch_words_);
+            BloomWord &word = words[slot.word];
+            std::uint64_t x = word.load(std::memory_order_relaxed);
+            while (((x >> slot.shift) & 15) != 15 &&
+                   !word.compare_exchange_weak(x, x + (std::uint64_t(1) << slot.shift), std::memory_order_relaxed))
+            {
+            }
+        }
+
+        // Whoever records the access that reaches the limit halves every counter
+        const std::uint64_t limit = SKETCH_RESET_FACTOR * cache_capacity_;
+        if (stripe.cache.sketch_additions.fetch_add(1, std::memory_order_relaxed) + 1 == limit)
+        {
+            for (std::size_t w = 0; w < sketch_words_; ++w)
+            {
+                std::uint64_t x = words[w].load(std::memory_order_relaxed);
+                while (!words[w].compare_exchange_weak(x, (x >> 1) & 0x7777777777777777ull,
+                                                       std::memory_order_relaxed))
+                {
+                }
+            }
+            stripe.cache.sketch_additions.fetch_sub(limit, std::memory_order_relaxed);
+        }
+    }
+
+    std::uint32_t SharedMemoryDict::sketch_estimate(const Stripe &stripe, std::size_t h) const
+    {
+        const BloomWord *words = sketch_ + (&stripe - stripes_) * sketch_words_;
+        std::uint32_t estimate = 15;
+        for (std::size_t row = 0; row < SKETCH_ROWS; ++row)
+        {
+            const SketchSlot slot = sketch_slot(h, row, sketch_words_);
+            const auto count = static_cast<std::uint32_t>((words[slot.word].load(std::memory_order_relaxed) >> slot.shift) & 15);
+            estimate = std::min(estimate, count);
+        }
+        return estimate;
+    }
+
+    void SharedMemoryDict::touch(Stripe &stripe, MapValueType &node, std::size_t h) const
+    {
+        if (policy_ == EvictionPolicy::none)
+            return;
+        RecencyList &list = list_of(stripe.cache, node);
+        unlink_node(list, node);
+        link_front(list, node, node.second.segment);
+        sketch_increment(stripe, h);
+    }
+
+    void SharedMemoryDict::record_hit(Stripe &stripe, MapValueType &node, std::size_t h) const
+    {
+        if (policy_ == EvictionPolicy::none)
+            return;
+        touch(stripe, node, h);
+        stripe.cache.hits.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void SharedMemoryDict::record_miss(Stripe &stripe, std::size_t h) const
+    {
+        if (policy_ == EvictionPolicy::none)
+            return;
+        // A miss is often followed by a set of the same key; counting it lets
+        // keys that keep coming back build up the frequency to be admitted
+        sketch_increment(stripe, h);
+        stripe.cache.misses.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void SharedMemoryDict::evict(Stripe &stripe, MapValueType &node)
+    {
+        VersionBump bump(stripe.version);
+        reindex(stripe, KeyLess::view(node.first), {});
+        unlink_node(list_of(stripe.cache, node), node);
+        stripe.map.erase(stripe.map.find(KeyLess::view(node.first)));
+        header_->entry_count.fetch_sub(1, std::memory_order_relaxed);
+        stripe.cache.evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::size_t SharedMemoryDict::heap_used() const
+    {
+        return manager_->get_size() - manager_->get_free_memory();
+    }
+
+    // Called by a writer holding the stripe lock, with the new value already
+    // allocated: `extra` more bytes are about to be used and `released`
+    // freed. Only the writer's own stripe can be evicted from, so the limit
+    // is best effort under concurrent writers
+    void SharedMemoryDict::enforce_soft_limit(Stripe &stripe, std::size_t extra, std::size_t released,
+                                              const MapValueType *keep)
+    {
+        const std::size_t limit = static_cast<std::size_t>(header_->high_water_bytes);
+        for (;;)
+        {
+            const std::size_t used = heap_used() + extra;
+            if (used <= limit + released)
+                return;
+
+            // A value larger than the whole allowance is refused without
+            // evicting anything for it
+            MapValueType *victim = nullptr;
+            if (policy_ != EvictionPolicy::none && extra <= limit + released)
+            {
+                for (RecencyList *list : {&stripe.cache.main, &stripe.cache.window})
+                {
+                    for (MapValueType *node = list->oldest.get(); node != nullptr && victim == nullptr;
+                         node = node->second.newer.get())
+                    {
+                        if (node != keep)
+                            victim = node;
+                    }
+                }
+            }
+            if (victim == nullptr)
+            {
+                header_->soft_limit_rejections.fetch_add(1, std::memory_order_relaxed);
+                throw MemoryPressure("Shared memory segment '" + name_ + "' is above its high-water mark");
+            }
+            evict(stripe, *victim);
+            header_->soft_limit_evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void SharedMemoryDict::admit(Stripe &stripe, MapValueType &node, std::size_t h)
+    {
+        CacheState &cache = stripe.cache;
+        if (policy_ == EvictionPolicy::lru)
+        {
+            link_front(cache.main, node, CacheState::MAIN);
+            while (cache.main.size > cache_capacity_)
+                evict(stripe, *cache.main.oldest);
+            return;
+        }
+        if (policy_ != EvictionPolicy::tinylfu)
+            return;
+
+        // New keys enter the window (1% of the capacity); what falls out of it
+        // is a candidate for the main area, which it joins while there is
+        // room and otherwise only by beating main's least recent entry
+        const std::size_t window_capacity = std::max<std::size_t>(1, cache_capacity_ / 100);
+        const std::size_t main_capacity = cache_capacity_ > window_capacity ? cache_capacity_ - window_capacity : 0;
+        sketch_increment(stripe, h);
+        link_front(cache.window, node, CacheState::WINDOW);
+        while (cache.window.size > window_capacity)
         {
-            auto it = map_->find(k);
-            if (it == map_->end())
+            MapValueType &candidate = *cache.window.oldest;
+            unlink_node(cache.window, candidate);
+            link_front(cache.main, candidate, CacheState::MAIN);
+            if (cache.main.size <= main_capacity)
+                continue;
+
+            MapValueType &victim = *cache.main.oldest;
+            const std::size_t candidate_hash = hash_bytes(KeyLess::view(candidate.first));
+            const std::size_t victim_hash = hash_bytes(KeyLess::view(victim.first));
+            if (main_capacity != 0 && sketch_estimate(stripe, candidate_hash) > sketch_estimate(stripe, victim_hash))
             {
-                ByteVec v = make_bytevec(value_bytes, mgr);
-                map_->emplace(std::move(k), std::move(v));
+                evict(stripe, victim);
             }
             else
             {
-                ByteVec v = make_bytevec(value_bytes, mgr);
-                it->second.swap(v);
+                evict(stripe, candidate);
+                cache.rejections.fetch_add(1, std::memory_order_relaxed);
             }
-            key_mutex.unlock();
+        }
+    }
+
+    std::uint64_t SharedMemoryDict::stripe_version(std::string_view key_bytes) const
+    {
+        check_not_closed();
+        return get_stripe_for_key(key_bytes).version.load(std::memory_order_acquire);
+    }
+
+    std::size_t SharedMemoryDict::stripe_count() const
+    {
+        return max_keys_;
+    }
+
+    std::uint64_t SharedMemoryDict::generation() const
+    {
+        return header_->generation;
+    }
+
+    const std::string &SharedMemoryDict::name() const
+    {
+        return name_;
+    }
+
+    void SharedMemoryDict::set(std::string_view key_bytes, std::string_view value_bytes, LockWait wait)
+    {
+        set_parts(key_bytes, {value_bytes}, wait);
+    }
+
+    void SharedMemoryDict::set_parts(std::string_view key_bytes, std::initializer_list<std::string_view> value_parts,
+                                     LockWait wait, std::string_view index_terms)
+    {
+        check_not_closed();
+
+        std::size_t total = 0;
+        for (std::string_view part : value_parts)
+            total += part.size();
+        reserve_room(key_bytes, total, wait);
+
+        // Allocate the value at its final size and gather the parts into it
+        ShmemAlloc<char> alloc(manager_);
+        ByteVec v(alloc);
+        v.reserve(total);
+        for (std::string_view part : value_parts)
+            v.insert(v.end(), part.begin(), part.end());
+        publish(key_bytes, v, wait, index_terms);
+    }
+
+    // Runs the soft limit check before a value is allocated, so one too large
+    // for what is left is refused (or room is made for it) instead of failing
+    // with bad_alloc. publish() checks again once the value exists
+    void SharedMemoryDict::reserve_room(std::string_view key_bytes, std::size_t value_size, LockWait wait)
+    {
+        const std::size_t limit = static_cast<std::size_t>(header_->high_water_bytes);
+        if (limit == 0 || heap_used() + value_size <= limit)
+            return;
+
+        Stripe &stripe = stripes_[hash_bytes(key_bytes) % max_keys_];
+        lock_stripe(stripe.mutex, wait);
+        try
+        {
+            auto it = stripe.map.find(key_bytes);
+            if (it == stripe.map.end())
+                enforce_soft_limit(stripe, key_bytes.size() + value_size, 0, nullptr);
+            else
+                enforce_soft_limit(stripe, value_size, it->second.value.capacity(), &*it);
+            stripe.mutex.unlock();
         }
         catch (...)
         {
-            key_mutex.unlock();
+            stripe.mutex.unlock();
             throw;
         }
     }
 
-    bool SharedMemoryDict::get(const std::string &key_bytes, std::string &out_value_bytes) const
+    void SharedMemoryDict::publish(std::string_view key_bytes, ByteVec &value, LockWait wait,
+                                   std::string_view index_terms)
+    {
+        const std::size_t h = hash_bytes(key_bytes);
+        Stripe &stripe = stripes_[h % max_keys_];
+        lock_stripe(stripe.mutex, wait);
+        try
+        {
+            store_locked(stripe, key_bytes, h, value, index_terms);
+            stripe.mutex.unlock();
+        }
+        catch (...)
+        {
+            stripe.mutex.unlock();
+            throw;
+        }
+    }
+
+    // Inserts or replaces an entry with its stripe lock held; a replaced
+    // value is swapped into `value` for the caller to free after unlocking
+    void SharedMemoryDict::store_locked(Stripe &stripe, std::string_view key_bytes, std::size_t h, ByteVec &value,
+                                        std::string_view index_terms)
+    {
+        auto it = stripe.map.find(key_bytes);
+        if (header_->high_water_bytes != 0)
+        {
+            // The value is allocated already; a new key adds its copy, an
+            // update frees the old value
+            if (it == stripe.map.end())
+                enforce_soft_limit(stripe, key_bytes.size(), 0, nullptr);
+            else
+                enforce_soft_limit(stripe, 0, it->second.value.capacity(), &*it);
+        }
+        VersionBump bump(stripe.version);
+        if (it == stripe.map.end())
+        {
+            // Only a new entry needs its key copied into the segment
+            bloom_add(h);
+            ByteVec k = make_bytevec(key_bytes, manager_);
+            auto inserted = stripe.map.emplace(std::move(k), std::move(value));
+            header_->entry_count.fetch_add(1, std::memory_order_relaxed);
+            admit(stripe, *inserted.first, h);
+        }
+        else
+        {
+            it->second.value.swap(value);
+            touch(stripe, *it, h);
+        }
+        // Indexed once stored, so find_by() never returns a key that was not
+        reindex(stripe, key_bytes, index_terms);
+    }
+
+    bool SharedMemoryDict::get(std::string_view key_bytes, std::string &out_value_bytes, LockWait wait,
+                               std::uint64_t *version) const
+    {
+        return get_with(key_bytes, [&](std::string_view v)
+                        { out_value_bytes.assign(v.data(), v.size()); }, wait, version);
+    }
+
+    bool SharedMemoryDict::peek(std::string_view key_bytes, std::string &out_value_bytes, LockWait wait) const
     {
         check_not_closed();
-        auto *mgr = segment_.get_segment_manager();
-        ByteVec k = make_bytevec(key_bytes, mgr);
 
-        Mutex &key_mutex = get_mutex_for_key(k);
-        key_mutex.lock();
+        const std::size_t h = hash_bytes(key_bytes);
+        if (!may_contain(h))
+            return false;
+        Stripe &stripe = stripes_[h % max_keys_];
+        lock_stripe(stripe.mutex, wait);
         try
         {
-            auto it = map_->find(k);
-            if (it != map_->end())
+            auto it = stripe.map.find(key_bytes);
+            bool found = (it != stripe.map.end());
+            if (found)
             {
-                const auto &v = it->second;
-                out_value_bytes.resize(v.size());
-                if (!v.empty())
-                    std::memcpy(out_value_bytes.data(), v.data(), v.size());
-                key_mutex.unlock();
-                return true;
+                const auto &v = it->second.value;
+                out_value_bytes.assign(v.data(), v.size());
             }
-            key_mutex.unlock();
+            stripe.mutex.unlock();
+            return found;
         }
         catch (...)
         {
-            key_mutex.unlock();
+            stripe.mutex.unlock();
             throw;
         }
-        return false;
     }
 
-    bool SharedMemoryDict::erase(const std::string &key_bytes)
+    bool SharedMemoryDict::erase(std::string_view key_bytes, LockWait wait)
     {
         check_not_closed();
-        auto *mgr = segment_.get_segment_manager();
-        ByteVec k = make_bytevec(key_bytes, mgr);
 
-        Mutex &key_mutex = get_mutex_for_key(k);
-        key_mutex.lock();
+        const std::size_t h = hash_bytes(key_bytes);
+        if (!may_contain(h))
+            return false;
+        Stripe &stripe = stripes_[h % max_keys_];
+        lock_stripe(stripe.mutex, wait);
         try
         {
-            bool erased = (map_->erase(k) > 0);
-            key_mutex.unlock();
+            auto it = stripe.map.find(key_bytes);
+            bool erased = (it != stripe.map.end());
+            if (erased)
+            {
+                erase_locked(stripe, it);
+            }
+            stripe.mutex.unlock();
             return erased;
         }
         catch (...)
         {
-            key_mutex.unlock();
+            stripe.mutex.unlock();
             throw;
         }
     }
 
-    bool SharedMemoryDict::contains(const std::string &key_bytes) const
+    std::size_t SharedMemoryDict::erase_many(const std::string_view *keys, std::size_t count, LockWait wait)
     {
         check_not_closed();
-        auto *mgr = segment_.get_segment_manager();
-        ByteVec k = make_bytevec(key_bytes, mgr);
 
-        Mutex &key_mutex = get_mutex_for_key(k);
-        key_mutex.lock();
+        std::vector<std::uint32_t> stripe_of;
+        std::vector<std::size_t> candidates;
+        stripe_of.reserve(count);
+        candidates.reserve(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const std::size_t h = hash_bytes(keys[i]);
+            if (may_contain(h))
+            {
+                stripe_of.push_back(static_cast<std::uint32_t>(h % max_keys_));
+                candidates.push_back(i);
+            }
+        }
+        std::vector<std::size_t> group_start, order;
+        group_by_stripe(stripe_of, max_keys_, group_start, order);
+
+        std::size_t erased = 0;
+        for (std::size_t s = 0; s < max_keys_; ++s)
+        {
+            if (group_start[s] == group_start[s + 1])
+                continue;
+
+            Stripe &stripe = stripes_[s];
+            lock_stripe(stripe.mutex, wait);
+            for (std::size_t j = group_start[s]; j < group_start[s + 1]; ++j)
+            {
+                auto it = stripe.map.find(keys[candidates[order[j]]]);
+                if (it != stripe.map.end())
+                {
+                    erase_locked(stripe, it);
+                    ++erased;
+                }
+            }
+            stripe.mutex.unlock();
+        }
+        return erased;
+    }
+
+    void SharedMemoryDict::erase_locked(Stripe &stripe, Map::iterator it)
+    {
+        VersionBump bump(stripe.version);
+        reindex(stripe, KeyLess::view(it->first), {});
+        if (policy_ != EvictionPolicy::none)
+            unlink_node(list_of(stripe.cache, *it), *it);
+        stripe.map.erase(it);
+        header_->entry_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    bool SharedMemoryDict::contains(std::string_view key_bytes, LockWait wait) const
+    {
+        check_not_closed();
+
+        const std::size_t h = hash_bytes(key_bytes);
+        if (!may_contain(h))
+            return false;
+        Stripe &stripe = stripes_[h % max_keys_];
+        lock_stripe(stripe.mutex, wait);
         try
         {
-            bool found = (map_->find(k) != map_->end());
-            key_mutex.unlock();
+            bool found = (stripe.map.find(key_bytes) != stripe.map.end());
+            stripe.mutex.unlock();
             return found;
         }
         catch (...)
         {
-            key_mutex.unlock();
+            stripe.mutex.unlock();
             throw;
         }
     }
@@ -199,10 +1062,10 @@ namespace shared_memory
     std::size_t SharedMemoryDict::size() const
     {
         check_not_closed();
-        return map_->size();
+        return static_cast<std::size_t>(header_->entry_count.load(std::memory_order_relaxed));
     }
 
-    std::vector<std::string> SharedMemoryDict::keys() const
+    std::vector<std::string> SharedMemoryDict::keys(LockWait wait) const
     {
         check_not_closed();
         std::vector<std::string> out;
@@ -216,26 +1079,25 @@ namespace shared_memory
             // Lock all mutexes in order
             for (std::size_t i = 0; i < max_keys_; ++i)
             {
-                mutexes_[i].lock();
+                lock_stripe(stripes_[i].mutex, wait);
                 locked[i] = true;
             }
 
             // Now we have exclusive access to all keys - safe to iterate
-            out.reserve(map_->size());
-            for (auto const &kv : *map_)
+            out.reserve(static_cast<std::size_t>(header_->entry_count.load(std::memory_order_relaxed)));
+            for (std::size_t i = 0; i < max_keys_; ++i)
             {
-                const auto &k = kv.first;
-                std::string ks;
-                ks.resize(k.size());
-                if (!k.empty())
-                    std::memcpy(ks.data(), k.data(), k.size());
-                out.emplace_back(std::move(ks));
+                for (auto const &kv : stripes_[i].map)
+                {
+                    const auto &k = kv.first;
+                    out.emplace_back(k.data(), k.size());
+                }
             }
 
             // Unlock all mutexes in reverse order
             for (int i = static_cast<int>(max_keys_) - 1; i >= 0; --i)
             {
-                mutexes_[i].unlock();
+                stripes_[i].mutex.unlock();
                 locked[i] = false;
             }
         }
@@ -246,7 +1108,7 @@ namespace shared_memory
             {
                 if (locked[i])
                 {
-                    mutexes_[i].unlock();
+                    stripes_[i].mutex.unlock();
                 }
             }
             throw;
@@ -255,6 +1117,248 @@ namespace shared_memory
         return out;
     }
 
+    const std::vector<std::string> &SharedMemoryDict::index_fields() const
+    {
+        return index_fields_;
+    }
+
+    std::vector<std::string> SharedMemoryDict::find_by(std::string_view field, std::string_view term,
+                                                       LockWait wait) const
+    {
+        check_not_closed();
+
+        auto pos = std::find(index_fields_.begin(), index_fields_.end(), field);
+        if (pos == index_fields_.end())
+        {
+            throw std::invalid_argument("field '" + std::string(field) + "' is not indexed");
+        }
+        std::string prefix;
+        append_index_term(prefix, static_cast<std::size_t>(pos - index_fields_.begin()), term);
+
+        std::vector<std::string> out;
+        for (std::size_t s = 0; s < max_keys_; ++s)
+        {
+            Stripe &stripe = stripes_[s];
+            const Postings &postings = indexes_[s].postings;
+            lock_stripe(stripe.mutex, wait);
+            try
+            {
+                for (auto it = postings.lower_bound(std::string_view(prefix)); it != postings.end(); ++it)
+                {
+                    std::string_view posting = KeyLess::view(*it);
+                    if (posting.substr(0, prefix.size()) != prefix)
+                        break;
+                    out.emplace_back(posting.substr(prefix.size()));
+                }
+            }
+            catch (...)
+            {
+                stripe.mutex.unlock();
+                throw;
+            }
+            stripe.mutex.unlock();
+        }
+        return out;
+    }
+
+    void SharedMemoryDict::reindex(Stripe &stripe, std::string_view key_bytes, std::string_view index_terms)
+    {
+        if (indexes_ == nullptr)
+            return;
+
+        StripeIndex &index = indexes_[&stripe - stripes_];
+        std::string posting;
+        auto it = index.terms.find(key_bytes);
+        if (it != index.terms.end())
+        {
+            if (KeyLess::view(it->second) == index_terms)
+                return;
+            for_each_index_term(KeyLess::view(it->second), [&](std::string_view term)
+                                {
+                                    posting.assign(term).append(key_bytes);
+                                    auto p = index.postings.find(std::string_view(posting));
+                                    if (p != index.postings.end())
+                                        index.postings.erase(p);
+                                });
+            if (index_terms.empty())
+            {
+                index.terms.erase(it);
+                return;
+            }
+            it->second.assign(index_terms.begin(), index_terms.end());
+        }
+        else
+        {
+            if (index_terms.empty())
+                return;
+            index.terms.emplace(make_bytevec(key_bytes, manager_), make_bytevec(index_terms, manager_));
+        }
+        for_each_index_term(index_terms, [&](std::string_view term)
+                            {
+                                posting.assign(term).append(key_bytes);
+                                index.postings.insert(make_bytevec(posting, manager_));
+                            });
+    }
+
+    MemoryUsage SharedMemoryDict::memory_usage() const
+    {
+        check_not_closed();
+        MemoryUsage usage{manager_->get_size(), manager_->get_free_memory()};
+        usage.high_water_bytes = static_cast<std::size_t>(header_->high_water_bytes);
+        usage.soft_limit_evictions = header_->soft_limit_evictions.load(std::memory_order_relaxed);
+        usage.soft_limit_rejections = header_->soft_limit_rejections.load(std::memory_order_relaxed);
+        return usage;
+    }
+
+    BloomStats SharedMemoryDict::bloom_stats() const
+    {
+        check_not_closed();
+        BloomStats stats;
+        if (bloom_ == nullptr)
+            return stats;
+        const std::size_t words = max_keys_ * bloom_words_;
+        stats.bits = words * 64;
+        for (std::size_t w = 0; w < words; ++w)
+        {
+            std::uint64_t x = bloom_[w].load(std::memory_order_relaxed);
+            for (; x != 0; x &= x - 1)
+                ++stats.bits_set;
+        }
+        return stats;
+    }
+
+    CacheStats SharedMemoryDict::cache_stats() const
+    {
+        check_not_closed();
+        CacheStats stats;
+        stats.policy = policy_;
+        stats.max_entries = cache_capacity_ * max_keys_;
+        for (std::size_t i = 0; i < max_keys_; ++i)
+        {
+            const CacheState &cache = stripes_[i].cache;
+            stats.hits += cache.hits.load(std::memory_order_relaxed);
+            stats.misses += cache.misses.load(std::memory_order_relaxed);
+            stats.evictions += cache.evictions.load(std::memory_order_relaxed);
+            stats.rejections += cache.rejections.load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+    std::size_t SharedMemoryDict::compact(LockWait wait)
+    {
+        check_not_closed();
+        std::size_t moved = 0;
+        for (std::size_t i = 0; i < max_keys_; ++i)
+        {
+            for (int attempt = 0; attempt < COMPACT_ATTEMPTS; ++attempt)
+            {
+                if (compact_stripe(stripes_[i], i, wait, moved))
+                    break;
+            }
+        }
+        return moved;
+    }
+
+    bool SharedMemoryDict::compact_stripe(Stripe &stripe, std::size_t index, LockWait wait, std::size_t &moved)
+    {
+        // Built a chunk at a time, releasing the lock in between. Any write
+        // bumps the stripe version, so an unchanged version means the map, and
+        // the position in it, are as the previous chunk left them
+        Map fresh{KeyLess(), MapAlloc(manager_)};
+        std::vector<std::uint64_t> fresh_bloom(bloom_ != nullptr ? bloom_words_ : 0, 0);
+        Map::iterator next;
+        std::uint64_t version = 0;
+        bool started = false;
+        for (;;)
+        {
+            lock_stripe(stripe.mutex, wait);
+            try
+            {
+                if (!started)
+                {
+                    next = stripe.map.begin();
+                    version = stripe.version.load(std::memory_order_relaxed);
+                    started = true;
+                }
+                else if (stripe.version.load(std::memory_order_relaxed) != version)
+                {
+                    stripe.mutex.unlock();
+                    return false;
+                }
+
+                std::size_t copied = 0;
+                for (; next != stripe.map.end() && copied < COMPACT_CHUNK_BYTES; ++next)
+                {
+                    if (bloom_ != nullptr)
+                    {
+                        const std::size_t h = hash_bytes(KeyLess::view(next->first));
+                        const BloomProbe probe = bloom_probe(h, bloom_words_ / BLOOM_BLOCK_WORDS);
+                        for (std::size_t w = 0; w < BLOOM_BLOCK_WORDS; ++w)
+                        {
+                            fresh_bloom[probe.block * BLOOM_BLOCK_WORDS + w] |= probe.mask[w];
+                        }
+                    }
+                    ByteVec k(next->first.begin(), next->first.end(), ShmemAlloc<char>(manager_));
+                    ByteVec v(next->second.value.begin(), next->second.value.end(), ShmemAlloc<char>(manager_));
+                    fresh.emplace_hint(fresh.end(), std::move(k), std::move(v));
+                    copied += next->first.size() + next->second.value.size();
+                }
+                if (next != stripe.map.end())
+                {
+                    stripe.mutex.unlock();
+                    continue;
+                }
+
+                // Recompute the stripe's filter from its keys. Each word goes from
+                // old to new in one store and the new bits of every present key
+                // were already set, so lock-free readers never miss a key
+                if (bloom_ != nullptr)
+                {
+                    BloomWord *words = bloom_ + index * bloom_words_;
+                    for (std::size_t w = 0; w < bloom_words_; ++w)
+                    {
+                        words[w].store(fresh_bloom[w], std::memory_order_release);
+                    }
+                }
+
+                // Relink the copies in the recency order of the originals, which
+                // reads may have changed since they were copied
+                if (policy_ != EvictionPolicy::none)
+                {
+                    CacheState &cache = stripe.cache;
+                    for (RecencyList *list : {&cache.main, &cache.window})
+                    {
+                        RecencyList relinked;
+                        for (MapValueType *node = list->oldest.get(); node != nullptr; node = node->second.newer.get())
+                        {
+                            MapValueType &copy = *fresh.find(KeyLess::view(node->first));
+                            link_front(relinked, copy, node->second.segment);
+                        }
+                        *list = relinked;
+                    }
+                }
+                moved += fresh.size();
+                stripe.map.swap(fresh);
+                // The nodes moved: a compaction of this stripe by another handle
+                // must start over. The old nodes are freed once the lock is released
+                stripe.version.fetch_add(1, std::memory_order_release);
+                stripe.mutex.unlock();
+                return true;
+            }
+            catch (const bipc::bad_alloc &)
+            {
+                // Not enough room to copy this stripe; leave it as it was
+                stripe.mutex.unlock();
+                return true;
+            }
+            catch (...)
+            {
+                stripe.mutex.unlock();
+                throw;
+            }
+        }
+    }
+
     void SharedMemoryDict::close()
     {
         // Close access to shared memory without removing it
@@ -279,4 +1383,103 @@ namespace shared_memory
         return is_closed_;
     }
 
+    ValueWriter::ValueWriter(SharedMemoryDict &dict, std::string_view key_bytes, std::size_t size_hint,
+                             LockWait wait)
+        : dict_(&dict),
+          key_(key_bytes),
+          buffer_(nullptr),
+          wait_(wait)
+    {
+        dict_->check_not_closed();
+        dict_->reserve_room(key_, size_hint, wait_);
+        auto *mgr = dict_->manager_;
+
+        // The pending value lives in the segment as an anonymous object, so the
+        // bytes are written exactly once and commit() only swaps buffers
+        buffer_ = dict_->mapping_->segment.construct<ByteVec>(bipc::anonymous_instance)(ShmemAlloc<char>(mgr));
+        try
+        {
+            buffer_->reserve(size_hint);
+        }
+        catch (...)
+        {
+            discard();
+            throw;
+        }
+    }
+
+    ValueWriter::~ValueWriter()
+    {
+        discard();
+    }
+
+    void ValueWriter::check_open() const
+    {
+        if (buffer_ == nullptr)
+        {
+            throw std::runtime_error("ValueWriter has already been committed or discarded");
+        }
+        dict_->check_not_closed();
+    }
+
+    void ValueWriter::write(const char *data, std::size_t size)
+    {
+        check_open();
+        if (size == 0)
+            return;
+
+        // Grow geometrically so an undersized hint still costs amortized O(1),
+        // unless doubling alone would cross the soft limit. The old buffer is
+        // freed only once the new one is filled, so the growth allocates it whole
+        const std::size_t needed = buffer_->size() + size;
+        if (needed > buffer_->capacity())
+        {
+            std::size_t grown = std::max(needed, buffer_->capacity() * 2);
+            const std::size_t limit = static_cast<std::size_t>(dict_->header_->high_water_bytes);
+            if (limit != 0 && dict_->heap_used() + grown > limit)
+                grown = needed;
+            dict_->reserve_room(key_, grown, wait_);
+            buffer_->reserve(grown);
+        }
+        buffer_->insert(buffer_->end(), data, data + size);
+    }
+
+    void ValueWriter::commit(LockWait wait, std::string_view index_terms)
+    {
+        check_open();
+
+        // Hand back the slack left by an oversized hint or the last doubling.
+        // With a version 2 allocator the vector only shrinks its block in
+        // place, so this never copies the value; smaller tails are published
+        // with it rather than split off as free blocks too small to reuse
+        static_assert(ShmemAlloc<char>::version::value == 2, "shrink_to_fit() must not reallocate");
+        if (buffer_->capacity() - buffer_->size() >= WRITER_SLACK_BYTES)
+        {
+            buffer_->shrink_to_fit();
+        }
+        dict_->publish(key_, *buffer_, wait, index_terms);
+
+        // After publishing, buffer_ holds the previous value (or nothing)
+        discard();
+    }
+
+    void ValueWriter::discard()
+    {
+        if (buffer_ != nullptr)
+        {
+            dict_->mapping_->segment.destroy_ptr(buffer_);
+            buffer_ = nullptr;
+        }
+    }
+
+    std::size_t ValueWriter::size() const
+    {
+        return buffer_ != nullptr ? buffer_->size() : 0;
+    }
+
+    bool ValueWriter::is_open() const
+    {
+        return buffer_ != nullptr;
+    }
+
 } // namespace shared_memory
\ No newline at end of file
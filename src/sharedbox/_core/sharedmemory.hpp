@@ -1,21 +1,126 @@
 #pragma once
 
-#include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/indexes/iset_index.hpp>
+#include <boost/interprocess/managed_external_buffer.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/mem_algo/rbtree_best_fit.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
 #include <boost/interprocess/sync/interprocess_mutex.hpp>
 #include <boost/container/vector.hpp>
 #include <boost/container/map.hpp>
+#include <boost/container/set.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <cstring>
+#include <exception>
+#include <initializer_list>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 #include <memory>
+#include <stdexcept>
 
 namespace bipc = boost::interprocess;
 
 namespace shared_memory
 {
 
+    // splitmix64 finalizer: spreads every input bit over the whole word, so
+    // sequential ids land in different stripes and slots
+    constexpr std::uint64_t mix64(std::uint64_t x) noexcept
+    {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebull;
+        x ^= x >> 31;
+        return x;
+    }
+
+    // Hint that *address will be read soon; a no-op where unsupported
+    inline void prefetch(const void *address) noexcept
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(address, 0, 3);
+#else
+        (void)address;
+#endif
+    }
+
+    // Orders the indices of a batch of keys by stripe for batch lookups, so each
+    // stripe is locked once. After the call, order[group_start[s]] up to
+    // order[group_start[s + 1]] are the keys in stripe s, in input order
+    inline void group_by_stripe(const std::vector<std::uint32_t> &stripe_of, std::size_t stripe_count,
+                                std::vector<std::size_t> &group_start, std::vector<std::size_t> &order)
+    {
+        group_start.assign(stripe_count + 1, 0);
+        for (std::uint32_t s : stripe_of)
+        {
+            ++group_start[s + 1];
+        }
+        for (std::size_t s = 0; s < stripe_count; ++s)
+        {
+            group_start[s + 1] += group_start[s];
+        }
+        order.resize(stripe_of.size());
+        std::vector<std::size_t> next(group_start.begin(), group_start.end() - 1);
+        for (std::size_t i = 0; i < stripe_of.size(); ++i)
+        {
+            order[next[stripe_of[i]]++] = i;
+        }
+    }
+
+    // Runs fn(t) for every t below `threads`, each on its own thread (t = 0 on
+    // the calling one), and rethrows the first exception any of them raised
+    // once all have finished
+    template <class Fn>
+    void run_on_threads(std::size_t threads, Fn &&fn)
+    {
+        if (threads <= 1)
+        {
+            fn(std::size_t(0));
+            return;
+        }
+        std::vector<std::thread> workers;
+        std::vector<std::exception_ptr> errors(threads);
+        workers.reserve(threads - 1);
+        auto guarded = [&](std::size_t t)
+        {
+            try
+            {
+                fn(t);
+            }
+            catch (...)
+            {
+                errors[t] = std::current_exception();
+            }
+        };
+        for (std::size_t t = 1; t < threads; ++t)
+        {
+            workers.emplace_back(guarded, t);
+        }
+        guarded(0);
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+        for (const std::exception_ptr &error : errors)
+        {
+            if (error)
+                std::rethrow_exception(error);
+        }
+    }
+
     // Type aliases and definitions moved outside class
-    using segment_t = bipc::managed_shared_memory;
+    // The heap lives behind a fixed SegmentHeader inside one mapped region. Its
+    // allocator is shared between processes, so it needs the interprocess
+    // mutex family (managed_external_buffer defaults to null_mutex_family)
+    using segment_t = bipc::basic_managed_external_buffer<char, bipc::rbtree_best_fit<bipc::mutex_family>,
+                                                          bipc::iset_index>;
     using segment_manager_t = segment_t::segment_manager;
 
     template <class T>
@@ -23,56 +128,730 @@ namespace shared_memory
 
     using ByteVec = boost::container::vector<char, ShmemAlloc<char>>;
 
+    // Orders stored keys and also compares them against plain byte views, so
+    // lookups never have to allocate a key inside the segment
     struct KeyLess
     {
-        bool operator()(const ByteVec &a, const ByteVec &b) const noexcept
+        using is_transparent = void;
+
+        static std::string_view view(const ByteVec &v) noexcept
+        {
+            return std::string_view(v.data(), v.size());
+        }
+
+        static bool less(std::string_view a, std::string_view b) noexcept
         {
-            const std::size_t as = a.size();
-            const std::size_t bs = b.size();
-            const std::size_t n = as < bs ? as : bs;
+            const std::size_t n = a.size() < b.size() ? a.size() : b.size();
             int cmp = n ? std::memcmp(a.data(), b.data(), n) : 0;
             if (cmp != 0)
                 return cmp < 0;
-            return as < bs;
+            return a.size() < b.size();
         }
+
+        bool operator()(const ByteVec &a, const ByteVec &b) const noexcept { return less(view(a), view(b)); }
+        bool operator()(const ByteVec &a, std::string_view b) const noexcept { return less(view(a), b); }
+        bool operator()(std::string_view a, const ByteVec &b) const noexcept { return less(a, view(b)); }
+    };
+
+    struct Entry;
+    using MapValueType = std::pair<const ByteVec, Entry>;
+
+    // A stored value. In cache mode the entry is also linked into its stripe's
+    // recency lists; map nodes never move, so the links point straight at them
+    struct Entry
+    {
+        Entry(ByteVec &&v) : value(std::move(v)) {}
+
+        ByteVec value;
+        bipc::offset_ptr<MapValueType> newer;
+        bipc::offset_ptr<MapValueType> older;
+        std::uint8_t segment = 0; // RecencyList the entry is on, see CacheState
     };
 
-    using MapValueType = std::pair<const ByteVec, ByteVec>;
     using MapAlloc = ShmemAlloc<MapValueType>;
-    using Map = boost::container::map<ByteVec, ByteVec, KeyLess, MapAlloc>;
+    using Map = boost::container::map<ByteVec, Entry, KeyLess, MapAlloc>;
     using Mutex = bipc::interprocess_mutex;
 
+    // Per-stripe write counter; must be address-free to be shared between processes
+    using Version = std::atomic<std::uint64_t>;
+    static_assert(Version::is_always_lock_free, "stripe versions must be lock-free atomics");
+
+    // Entries of a stripe from most to least recently used
+    struct RecencyList
+    {
+        bipc::offset_ptr<MapValueType> newest;
+        bipc::offset_ptr<MapValueType> oldest;
+        std::uint64_t size = 0;
+    };
+
+    // Eviction state of a stripe in cache mode. The lists are only touched
+    // with the stripe mutex held; the counters are atomics because lookups the
+    // Bloom filter answers count their misses without it
+    struct CacheState
+    {
+        static constexpr std::uint8_t MAIN = 0;
+        static constexpr std::uint8_t WINDOW = 1;
+
+        RecencyList main;
+        RecencyList window; // admission window of the tinylfu policy
+        std::atomic<std::uint64_t> hits{0};
+        std::atomic<std::uint64_t> misses{0};
+        std::atomic<std::uint64_t> evictions{0};
+        std::atomic<std::uint64_t> rejections{0};      // candidates the tinylfu policy turned away
+        std::atomic<std::uint64_t> sketch_additions{0}; // since the sketch was last halved
+    };
+
+    // One lock stripe: the mutex, its write version and the entries hashing to it.
+    // Each stripe owns its map, so writers holding different stripes never
+    // touch the same tree
+    struct Stripe
+    {
+        explicit Stripe(const MapAlloc &alloc) : version(0), map(KeyLess(), alloc) {}
+
+        Mutex mutex;
+        Version version;
+        Map map;
+        CacheState cache;
+    };
+
+    // Secondary indexes of one stripe, kept apart from Stripe so segments
+    // without indexes do not pay for them. Each element of `postings` is an
+    // index term (see append_index_term) followed by the key stored under it,
+    // so the keys of a term are adjacent; `terms` maps every indexed key to
+    // its index terms, so overwriting or erasing it can drop its postings
+    using Postings = boost::container::set<ByteVec, KeyLess, ShmemAlloc<ByteVec>>;
+    using IndexedTerms = boost::container::map<ByteVec, ByteVec, KeyLess, ShmemAlloc<std::pair<const ByteVec, ByteVec>>>;
+    struct StripeIndex
+    {
+        explicit StripeIndex(segment_manager_t *mgr) : postings(KeyLess(), mgr), terms(KeyLess(), mgr) {}
+
+        Postings postings;
+        IndexedTerms terms;
+    };
+    constexpr std::size_t MAX_INDEX_FIELDS = 255;
+
+    // Appends the index term of field number `field` (its position in
+    // index_fields()) to a buffer of terms for one value: the field, the
+    // length of the term and the term itself
+    inline void append_index_term(std::string &terms, std::size_t field, std::string_view term)
+    {
+        const auto field_byte = static_cast<char>(field);
+        const auto size = static_cast<std::uint32_t>(term.size());
+        terms.push_back(field_byte);
+        terms.append(reinterpret_cast<const char *>(&size), sizeof(size));
+        terms.append(term);
+    }
+
+    // Fixed header at offset 0 of every segment. Attaching maps the segment and
+    // validates this header instead of looking up named objects under the
+    // segment's global lock. Offsets are in bytes from the start of the segment
+    struct SegmentHeader
+    {
+        static constexpr std::uint64_t MAGIC = 0x31584F4244524853ull; // "SHRDBOX1" little-endian
+        static constexpr std::uint32_t LAYOUT_VERSION = 6;
+        static constexpr std::size_t RESERVED_BYTES = 256; // the heap starts here
+
+        std::atomic<std::uint64_t> magic; // stored last; zero while the segment is being created
+        std::uint32_t layout_version;
+        std::uint32_t stripe_count;
+        std::uint64_t heap_offset;
+        std::uint64_t heap_size;
+        std::uint64_t stripes_offset;
+        std::atomic<std::uint64_t> entry_count;
+        std::uint64_t generation; // random per creation, tells a recreated segment of the same name apart
+        std::uint32_t container_kind; // SegmentKind of the stripes; zero in segments created before it existed
+        std::uint32_t key_size;
+        std::uint32_t value_size;
+        std::uint32_t bloom_words; // Bloom filter words per stripe, 0 without a filter
+        std::uint64_t bloom_offset;
+        std::uint64_t cache_capacity; // entries per stripe in cache mode, 0 otherwise
+        std::uint32_t eviction_policy; // EvictionPolicy
+        std::uint32_t sketch_words; // frequency sketch words per stripe (tinylfu only)
+        std::uint64_t sketch_offset;
+        std::uint64_t high_water_bytes; // soft limit on heap usage, 0 for none
+        std::atomic<std::uint64_t> soft_limit_evictions;
+        std::atomic<std::uint64_t> soft_limit_rejections;
+        std::uint32_t index_count; // secondary index fields, 0 for none
+        std::uint32_t index_names_size;
+        std::uint64_t index_names_offset; // each field name as a u32 length followed by its bytes
+        std::uint64_t indexes_offset; // StripeIndex array, one per stripe
+    };
+    static_assert(sizeof(SegmentHeader) <= SegmentHeader::RESERVED_BYTES, "segment header outgrew its slot");
+
+    // What a segment's stripes hold, so a handle never attaches to another
+    // kind of container. Zero is SharedMemoryDict; typed maps record the size
+    // of their keys and values as well
+    struct SegmentKind
+    {
+        static constexpr std::uint32_t BYTES_DICT = 0;
+        static constexpr std::uint32_t TYPED_MAP = 1;
+
+        std::uint32_t container = BYTES_DICT;
+        std::uint32_t key_size = 0;
+        std::uint32_t value_size = 0;
+    };
+
+    // Raised when a stripe lock cannot be acquired within the allowed wait
+    class LockTimeout : public std::runtime_error
+    {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // Raised when a write would take the segment past its high-water mark and
+    // no room could be made by evicting; nothing was written
+    class MemoryPressure : public std::runtime_error
+    {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // How long an operation may wait for a stripe lock. A timed wait fixes its
+    // deadline on creation, so an operation taking several stripes (keys())
+    // shares one budget between them
+    class LockWait
+    {
+    public:
+        static LockWait forever() { return LockWait(Mode::forever, {}); }
+        static LockWait none() { return LockWait(Mode::none, {}); } // try once, never block
+        static LockWait for_duration(std::chrono::microseconds timeout)
+        {
+            if (timeout.count() <= 0)
+                return none();
+            return LockWait(Mode::until, boost::posix_time::microsec_clock::universal_time() +
+                                             boost::posix_time::microseconds(timeout.count()));
+        }
+
+        bool may_block() const { return mode_ != Mode::none; }
+        bool has_deadline() const { return mode_ == Mode::until; }
+        const boost::posix_time::ptime &deadline() const { return deadline_; }
+
+    private:
+        enum class Mode
+        {
+            forever,
+            none,
+            until
+        };
+
+        LockWait(Mode mode, boost::posix_time::ptime deadline) : mode_(mode), deadline_(deadline) {}
+
+        Mode mode_;
+        boost::posix_time::ptime deadline_;
+    };
+
+    // Blocked Bloom filter over the keys of each stripe, stored in the segment
+    // heap: a key sets BLOOM_PROBES bits within one 64-byte block of its
+    // stripe's filter. Writers set bits under the stripe lock before inserting;
+    // readers test them without locking, so most misses never take the lock.
+    // Erased keys leave their bits set until compact() rebuilds the filter
+    using BloomWord = std::atomic<std::uint64_t>;
+    static_assert(BloomWord::is_always_lock_free, "Bloom filter words must be lock-free atomics");
+    constexpr std::size_t BLOOM_BLOCK_WORDS = 8; // one cache line
+    constexpr std::size_t BLOOM_PROBES = 7;
+    constexpr std::size_t BLOOM_BITS_PER_KEY = 10; // about 1% false positives at capacity
+
+    // Health of a segment's Bloom filter; the false positive rate is estimated
+    // from the share of bits set, so it rises with keys erased since the last
+    // compact() as well as with keys present
+    struct BloomStats
+    {
+        std::size_t bits = 0; // 0 when the segment has no filter
+        std::size_t bits_set = 0;
+
+        double fill_ratio() const { return bits == 0 ? 0.0 : static_cast<double>(bits_set) / bits; }
+        double false_positive_rate() const;
+    };
+
+    // How a dictionary in cache mode picks entries to evict once a stripe
+    // holds its share of max_entries:
+    //  - lru evicts the least recently used entry of the stripe
+    //  - tinylfu (W-TinyLFU) lets new keys into a small LRU window; an entry
+    //    leaving the window replaces the least recently used entry of the main
+    //    area only if a frequency sketch shared by all processes has seen it
+    //    more often, so one-hit wonders cannot flush the hot set
+    enum class EvictionPolicy : std::uint32_t
+    {
+        none = 0,
+        lru = 1,
+        tinylfu = 2
+    };
+
+    // Cache mode of a new segment; max_entries of 0 keeps every entry. Bounds
+    // are enforced per stripe (max_entries / stripe count, rounded up)
+    struct CacheOptions
+    {
+        std::size_t max_entries = 0;
+        EvictionPolicy policy = EvictionPolicy::lru;
+    };
+
+    // Cache mode counters, summed over every stripe and every process
+    struct CacheStats
+    {
+        EvictionPolicy policy = EvictionPolicy::none;
+        std::size_t max_entries = 0;
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t evictions = 0;
+        std::uint64_t rejections = 0;
+
+        double hit_rate() const { return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / (hits + misses); }
+    };
+
+    // Heap usage of a segment. The allocator cannot report how free memory
+    // is split into runs, so fragmentation shows up only as large values
+    // failing to fit while free_bytes is high
+    struct MemoryUsage
+    {
+        std::size_t total_bytes;
+        std::size_t free_bytes;
+        std::size_t high_water_bytes = 0; // 0 without a soft limit
+        std::uint64_t soft_limit_evictions = 0;
+        std::uint64_t soft_limit_rejections = 0;
+    };
+
+    // A mapped segment, shared by every handle to it within the process
+    struct SegmentMapping
+    {
+        bipc::mapped_region region;
+        segment_t segment;
+    };
+
+    // Constructs the stripe array of a new segment in its heap and returns it
+    using StripeBuilder = void *(*)(segment_t &segment, std::size_t stripe_count);
+
+    // Creates the segment (when `create` is set and it does not exist yet) or
+    // attaches to it, validating its header against `kind`. Only the creator
+    // calls build_stripes and sets up the optional SharedMemoryDict structures
+    // in `extras`; everyone adopts the creator's stripe count and extras
+    struct SegmentExtras
+    {
+        std::size_t bloom_words = 0; // per stripe
+        std::size_t cache_capacity = 0; // per stripe
+        EvictionPolicy eviction_policy = EvictionPolicy::none;
+        std::size_t sketch_words = 0; // per stripe
+        double high_water_mark = 0.0; // share of the heap, 0 for no soft limit
+        std::vector<std::string> index_fields;
+    };
+    std::shared_ptr<SegmentMapping> open_segment(const std::string &name, std::size_t size, bool create,
+                                                 std::size_t stripe_count, SegmentKind kind,
+                                                 StripeBuilder build_stripes, const SegmentExtras &extras = {});
+    // Reopens the segment identified by name and generation, reusing this
+    // process's mapping of it when there is one (including one inherited
+    // through fork()); throws if the segment has been recreated since
+    std::shared_ptr<SegmentMapping> reopen_segment(const std::string &name, std::uint64_t generation,
+                                                   SegmentKind kind);
+
+    // Acquires a stripe mutex within `wait` or throws LockTimeout
+    void lock_stripe(Mutex &mutex, LockWait wait);
+
+    class SharedMemoryDict;
+
+    // Builds a value directly inside the segment, so large values never need
+    // a full private copy; readers see nothing until commit() publishes it.
+    // The soft limit is checked for size_hint and before every growth of the
+    // buffer, which evicts or throws MemoryPressure like set(); `wait` bounds
+    // the stripe lock that eviction takes
+    class ValueWriter
+    {
+    public:
+        ValueWriter(SharedMemoryDict &dict, std::string_view key_bytes, std::size_t size_hint,
+                    LockWait wait = LockWait::forever());
+        ~ValueWriter(); // discards the value if it was never committed
+
+        ValueWriter(const ValueWriter &) = delete;
+        ValueWriter &operator=(const ValueWriter &) = delete;
+
+        void write(const char *data, std::size_t size);
+        // Atomically replaces (or inserts) the value under key, indexed under
+        // `index_terms`; on LockTimeout the pending value is left intact and
+        // commit() may be retried
+        void commit(LockWait wait = LockWait::forever(), std::string_view index_terms = {});
+        void discard(); // releases the reserved space without publishing
+        std::size_t size() const;
+        bool is_open() const;
+
+    private:
+        void check_open() const;
+
+        SharedMemoryDict *dict_;
+        std::string key_;
+        ByteVec *buffer_;
+        LockWait wait_;
+    };
+
     class SharedMemoryDict
     {
     public:
-        SharedMemoryDict(const std::string &name, std::size_t size, bool create, std::size_t max_keys = 128);
+        // bloom_capacity > 0 gives a new segment a Bloom filter sized for that
+        // many keys, which lets lookups of absent keys skip the stripe lock.
+        // cache.max_entries > 0 puts a new segment in cache mode: inserting
+        // into a full stripe evicts an entry chosen by cache.policy.
+        // high_water_mark in (0, 1] is a soft limit on the share of the heap in
+        // use: a write that would cross it evicts from its stripe in cache mode
+        // and otherwise fails with MemoryPressure, before the heap runs out.
+        // index_fields names up to MAX_INDEX_FIELDS secondary indexes; writers
+        // pass the index terms of each value and find_by() looks keys up by them
+        SharedMemoryDict(const std::string &name, std::size_t size, bool create, std::size_t max_keys = 128,
+                         std::size_t bloom_capacity = 0, CacheOptions cache = {}, double high_water_mark = 0.0,
+                         const std::vector<std::string> &index_fields = {});
+        // Reopens the segment identified by name and generation (see generation()).
+        // Reuses this process's mapping of it when there is one, including a
+        // mapping inherited through fork(); otherwise attaches by name and
+        // throws if the segment has been recreated since
+        SharedMemoryDict(const std::string &name, std::uint64_t generation);
         ~SharedMemoryDict();
 
-        void set(const std::string &key_bytes, const std::string &value_bytes);
-        bool get(const std::string &key_bytes, std::string &out_value_bytes) const;
-        bool erase(const std::string &key_bytes);
-        bool contains(const std::string &key_bytes) const;
+        // Every keyed operation throws LockTimeout if its stripe lock cannot be
+        // acquired within `wait`; nothing is modified in that case
+        void set(std::string_view key_bytes, std::string_view value_bytes,
+                 LockWait wait = LockWait::forever());
+        // Stores the concatenation of the parts without assembling it in private
+        // memory. index_terms (built with append_index_term) replace the terms
+        // the key was indexed under; writes without them unindex it
+        void set_parts(std::string_view key_bytes, std::initializer_list<std::string_view> value_parts,
+                       LockWait wait = LockWait::forever(), std::string_view index_terms = {});
+        // Lookups optionally report the stripe version the value was read at.
+        // In cache mode they count as uses of the key for eviction
+        bool get(std::string_view key_bytes, std::string &out_value_bytes,
+                 LockWait wait = LockWait::forever(), std::uint64_t *version = nullptr) const;
+        // get() without affecting eviction or the cache statistics
+        bool peek(std::string_view key_bytes, std::string &out_value_bytes,
+                  LockWait wait = LockWait::forever()) const;
+        // Calls fn(value_view) while the value's stripe lock is held, so callers can
+        // decode straight from the segment; fn must not call back into this dict
+        template <class Fn>
+        bool get_with(std::string_view key_bytes, Fn &&fn, LockWait wait = LockWait::forever(),
+                      std::uint64_t *version = nullptr) const;
+        // Looks up a batch of keys taking each stripe lock once: keys are grouped
+        // by stripe and every group is read under one acquisition, in stripe
+        // order. Calls fn(index, value_view) for each key found, with its stripe
+        // lock held; fn must not call back into this dict. A timed wait bounds
+        // the whole batch. Returns the number of keys found
+        template <class Fn>
+        std::size_t get_many_with(const std::string_view *keys, std::size_t count, Fn &&fn,
+                                  LockWait wait = LockWait::forever()) const;
+        // Stores a batch of entries taking each stripe lock once. fill(index,
+        // value) appends the bytes of value `index` to an empty buffer in the
+        // segment; it runs with no lock held and, with threads > 1, on that
+        // many threads at once, each owning a share of the stripes. Entries of
+        // a stripe are stored in batch order, so a repeated key keeps its last
+        // value. On failure the entries already stored stay. index_terms, when
+        // given, holds the index terms of each entry
+        template <class Fill>
+        void set_many_with(const std::string_view *keys, std::size_t count, Fill &&fill, std::size_t threads = 1,
+                           LockWait wait = LockWait::forever(), const std::string_view *index_terms = nullptr);
+        // Calls fn(worker, key_view, value_view) for every entry with its stripe
+        // lock held, one stripe at a time. With threads > 1 the stripes are
+        // shared out among that many threads; worker (below threads) tells
+        // them apart, so fn can accumulate per thread without synchronizing.
+        // Does not count as a use in cache mode; fn must not call back into
+        // this dict. A timed wait bounds each stripe
+        template <class Fn>
+        void scan_with(Fn &&fn, std::size_t threads = 1, LockWait wait = LockWait::forever()) const;
+        bool erase(std::string_view key_bytes, LockWait wait = LockWait::forever());
+        // Erases a batch of keys taking each stripe lock once, in stripe order.
+        // A timed wait bounds each stripe. Returns the number of keys erased
+        std::size_t erase_many(const std::string_view *keys, std::size_t count,
+                               LockWait wait = LockWait::forever());
+        bool contains(std::string_view key_bytes, LockWait wait = LockWait::forever()) const;
         std::size_t size() const;
-        std::vector<std::string> keys() const;
+        std::vector<std::string> keys(LockWait wait = LockWait::forever()) const;
+
+        // Fields the creator of the segment declared secondary indexes for
+        const std::vector<std::string> &index_fields() const;
+        // Keys currently indexed under `term` for `field`, collected one stripe
+        // lock at a time; throws std::invalid_argument if field is not indexed.
+        // A timed wait bounds the whole lookup
+        std::vector<std::string> find_by(std::string_view field, std::string_view term,
+                                         LockWait wait = LockWait::forever()) const;
+
+        // Lock-free read of the key's stripe version, which every write to the
+        // stripe bumps; a copy read at an unchanged version is still current
+        std::uint64_t stripe_version(std::string_view key_bytes) const;
+        // Stripe count chosen by the creator of the segment
+        std::size_t stripe_count() const;
+        MemoryUsage memory_usage() const;
+        BloomStats bloom_stats() const;
+        CacheStats cache_stats() const;
+        // Rebuilds each stripe's map from fresh allocations and then frees the
+        // old nodes, keys and values together so they can coalesce. The copy
+        // is made a chunk at a time, holding the stripe's lock only for each
+        // chunk and the final swap, and starts over if the stripe is written
+        // in between; a stripe written during every attempt, or that does not
+        // fit twice, is skipped. `wait` bounds each acquisition. Also clears
+        // the Bloom filter bits of erased keys. Returns the number of entries
+        // relocated
+        std::size_t compact(LockWait wait = LockWait::forever());
+
+        // Identifies this particular segment; a new segment under the same name gets a new one
+        std::uint64_t generation() const;
+        const std::string &name() const;
 
         void close();           // Close access to shared memory without removing it
         void unlink();          // Remove shared memory segment
         bool is_closed() const; // Check if the connection has been closed
 
+        using Mapping = SegmentMapping;
+
     private:
-        static ByteVec make_bytevec(const std::string &s, segment_manager_t *mgr);
-        static std::size_t hash_bytes(const ByteVec &key) noexcept;
-        std::size_t get_key_index(const ByteVec &key) const;
-        Mutex &get_mutex_for_key(const ByteVec &key) const;
+        friend class ValueWriter;
+
+        static void *build_stripes(segment_t &segment, std::size_t stripe_count);
+        void use_mapping(std::shared_ptr<Mapping> mapping);
+
+        static ByteVec make_bytevec(std::string_view s, segment_manager_t *mgr);
+        static std::size_t hash_bytes(std::string_view key) noexcept;
+        std::size_t get_key_index(std::string_view key) const;
+        Stripe &get_stripe_for_key(std::string_view key) const;
+        // False only if the key is certainly absent; h is hash_bytes(key)
+        bool may_contain(std::size_t h) const;
+        void bloom_add(std::size_t h);
+        BloomWord *bloom_block(std::size_t h) const;
+
+        // Cache mode bookkeeping, called with the stripe lock held (record_miss
+        // also without it)
+        void record_hit(Stripe &stripe, MapValueType &node, std::size_t h) const;
+        void record_miss(Stripe &stripe, std::size_t h) const;
+        void admit(Stripe &stripe, MapValueType &node, std::size_t h);
+        void touch(Stripe &stripe, MapValueType &node, std::size_t h) const;
+        void evict(Stripe &stripe, MapValueType &node);
+        // One attempt of compact() at a stripe; false if it was written during the copy
+        bool compact_stripe(Stripe &stripe, std::size_t index, LockWait wait, std::size_t &moved);
+        // Heap bytes in use, which the soft limit is measured against. Only
+        // stored data allocates (entries, indexes, values being written or
+        // copied by compact()); statistics must never allocate, even briefly
+        std::size_t heap_used() const;
+        void enforce_soft_limit(Stripe &stripe, std::size_t extra, std::size_t released, const MapValueType *keep);
+        void reserve_room(std::string_view key_bytes, std::size_t value_size, LockWait wait);
+        void sketch_increment(Stripe &stripe, std::size_t h) const;
+        std::uint32_t sketch_estimate(const Stripe &stripe, std::size_t h) const;
+        void publish(std::string_view key_bytes, ByteVec &value, LockWait wait, std::string_view index_terms);
+        void store_locked(Stripe &stripe, std::string_view key_bytes, std::size_t h, ByteVec &value,
+                          std::string_view index_terms);
+        void erase_locked(Stripe &stripe, Map::iterator it);
+        // Replaces the postings of a key with those of index_terms, with the
+        // stripe lock held; empty terms unindex the key
+        void reindex(Stripe &stripe, std::string_view key_bytes, std::string_view index_terms);
         void check_not_closed() const;
 
         std::string name_;
         std::size_t max_keys_;
-        bool is_closed_;
+        std::atomic<bool> is_closed_; // other threads may close the handle while it is in use
 
-        segment_t segment_;
-        Map *map_;
-        Mutex *mutexes_;
+        std::shared_ptr<Mapping> mapping_;
+        SegmentHeader *header_;
+        segment_manager_t *manager_;
+        Stripe *stripes_;
+        BloomWord *bloom_; // stripe_count * bloom_words_ words, or null
+        std::size_t bloom_words_;
+        EvictionPolicy policy_;
+        std::size_t cache_capacity_; // per stripe
+        BloomWord *sketch_; // stripe_count * sketch_words_ words, or null
+        std::size_t sketch_words_;
+        StripeIndex *indexes_; // one per stripe, or null without secondary indexes
+        std::vector<std::string> index_fields_;
     };
 
+    template <class Fn>
+    bool SharedMemoryDict::get_with(std::string_view key_bytes, Fn &&fn, LockWait wait,
+                                    std::uint64_t *version) const
+    {
+        check_not_closed();
+
+        const std::size_t h = hash_bytes(key_bytes);
+        Stripe &stripe = stripes_[h % max_keys_];
+        if (!may_contain(h))
+        {
+            if (version != nullptr)
+            {
+                *version = stripe.version.load(std::memory_order_acquire);
+            }
+            record_miss(stripe, h);
+            return false;
+        }
+        lock_stripe(stripe.mutex, wait);
+        try
+        {
+            if (version != nullptr)
+            {
+                *version = stripe.version.load(std::memory_order_acquire);
+            }
+            auto it = stripe.map.find(key_bytes);
+            if (it != stripe.map.end())
+            {
+                record_hit(stripe, *it, h);
+                const auto &v = it->second.value;
+                fn(std::string_view(v.data(), v.size()));
+                stripe.mutex.unlock();
+                return true;
+            }
+            record_miss(stripe, h);
+            stripe.mutex.unlock();
+        }
+        catch (...)
+        {
+            stripe.mutex.unlock();
+            throw;
+        }
+        return false;
+    }
+
+    template <class Fn>
+    std::size_t SharedMemoryDict::get_many_with(const std::string_view *keys, std::size_t count, Fn &&fn,
+                                                LockWait wait) const
+    {
+        check_not_closed();
+
+        // Keys the Bloom filter rules out are left out of the groups, so a
+        // stripe none of whose keys may be present is never locked
+        std::vector<std::uint32_t> stripe_of;
+        std::vector<std::size_t> candidates, hashes;
+        stripe_of.reserve(count);
+        candidates.reserve(count);
+        hashes.reserve(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const std::size_t h = hash_bytes(keys[i]);
+            if (may_contain(h))
+            {
+                stripe_of.push_back(static_cast<std::uint32_t>(h % max_keys_));
+                candidates.push_back(i);
+                hashes.push_back(h);
+            }
+            else
+            {
+                record_miss(stripes_[h % max_keys_], h);
+            }
+        }
+        std::vector<std::size_t> group_start, order;
+        group_by_stripe(stripe_of, max_keys_, group_start, order);
+
+        std::size_t found = 0;
+        for (std::size_t s = 0; s < max_keys_; ++s)
+        {
+            if (group_start[s] == group_start[s + 1])
+                continue;
+
+            Stripe &stripe = stripes_[s];
+            lock_stripe(stripe.mutex, wait);
+            try
+            {
+                for (std::size_t j = group_start[s]; j < group_start[s + 1]; ++j)
+                {
+                    const std::size_t c = order[j];
+                    auto it = stripe.map.find(keys[candidates[c]]);
+                    if (it != stripe.map.end())
+                    {
+                        record_hit(stripe, *it, hashes[c]);
+                        const auto &v = it->second.value;
+                        fn(candidates[c], std::string_view(v.data(), v.size()));
+                        ++found;
+                    }
+                    else
+                    {
+                        record_miss(stripe, hashes[c]);
+                    }
+                }
+            }
+            catch (...)
+            {
+                stripe.mutex.unlock();
+                throw;
+            }
+            stripe.mutex.unlock();
+        }
+        return found;
+    }
+
+    template <class Fill>
+    void SharedMemoryDict::set_many_with(const std::string_view *keys, std::size_t count, Fill &&fill,
+                                         std::size_t threads, LockWait wait, const std::string_view *index_terms)
+    {
+        check_not_closed();
+
+        std::vector<std::uint32_t> stripe_of(count);
+        std::vector<std::size_t> hashes(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            hashes[i] = hash_bytes(keys[i]);
+            stripe_of[i] = static_cast<std::uint32_t>(hashes[i] % max_keys_);
+        }
+        std::vector<std::size_t> group_start, order;
+        group_by_stripe(stripe_of, max_keys_, group_start, order);
+
+        // Values are built before the stripe is locked, so the copies run in
+        // parallel and the lock is only held for the inserts
+        auto store_stripes = [&](std::size_t first, std::size_t step)
+        {
+            std::vector<ByteVec> values;
+            for (std::size_t s = first; s < max_keys_; s += step)
+            {
+                const std::size_t begin = group_start[s], end = group_start[s + 1];
+                if (begin == end)
+                    continue;
+
+                values.clear();
+                values.reserve(end - begin);
+                for (std::size_t j = begin; j < end; ++j)
+                {
+                    values.emplace_back(ShmemAlloc<char>(manager_));
+                    fill(order[j], values.back());
+                }
+
+                Stripe &stripe = stripes_[s];
+                lock_stripe(stripe.mutex, wait);
+                try
+                {
+                    for (std::size_t j = begin; j < end; ++j)
+                    {
+                        const std::size_t i = order[j];
+                        store_locked(stripe, keys[i], hashes[i], values[j - begin],
+                                     index_terms != nullptr ? index_terms[i] : std::string_view());
+                    }
+                }
+                catch (...)
+                {
+                    stripe.mutex.unlock();
+                    throw;
+                }
+                stripe.mutex.unlock();
+            }
+        };
+
+        threads = std::max<std::size_t>(1, std::min(threads, max_keys_));
+        run_on_threads(threads, [&](std::size_t t)
+                       { store_stripes(t, threads); });
+    }
+
+    template <class Fn>
+    void SharedMemoryDict::scan_with(Fn &&fn, std::size_t threads, LockWait wait) const
+    {
+        check_not_closed();
+
+        threads = std::max<std::size_t>(1, std::min(threads, max_keys_));
+        auto scan_stripes = [&](std::size_t worker)
+        {
+            for (std::size_t s = worker; s < max_keys_; s += threads)
+            {
+                Stripe &stripe = stripes_[s];
+                lock_stripe(stripe.mutex, wait);
+                try
+                {
+                    for (const MapValueType &entry : stripe.map)
+                    {
+                        fn(worker, KeyLess::view(entry.first), KeyLess::view(entry.second.value));
+                    }
+                }
+                catch (...)
+                {
+                    stripe.mutex.unlock();
+                    throw;
+                }
+                stripe.mutex.unlock();
+            }
+        };
+        run_on_threads(threads, scan_stripes);
+    }
+
 } // namespace shared_memory
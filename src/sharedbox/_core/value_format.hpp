@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Encoding of the keys and values stored by the Python bindings. The segment
+// itself stores opaque bytes; these constants are what every client has to
+// agree on to read entries written by another one. See docs/format.md
+namespace shared_memory
+{
+
+    constexpr std::uint32_t VALUE_FORMAT_VERSION = 3; // bumped whenever an encoding below changes
+
+    // str keys are stored as their UTF-8 bytes. Other key types start with a
+    // tag byte that never occurs in UTF-8, so they cannot collide with them
+    constexpr std::uint8_t INT_KEY_TAG = 0xFF; // [tag] [int64 big-endian, sign bit flipped]
+    constexpr std::size_t INT_KEY_SIZE = 9;
+    constexpr std::uint8_t BYTES_KEY_TAG = 0xFE; // [tag] [raw bytes]
+
+    // First byte of every value
+    constexpr std::uint8_t PICKLE_MARKER = 0x00;  // Marker byte for pickle-serialized data
+    constexpr std::uint8_t NUMPY_MARKER = 0x01;   // Marker byte for numpy-serialized data
+    constexpr std::uint8_t BYTES_MARKER = 0x02;   // Marker byte for raw bytes (streamed values)
+    constexpr std::uint8_t PICKLE5_MARKER = 0x03; // Marker byte for pickle with out-of-band buffers
+    constexpr std::uint8_t NONE_MARKER = 0x04;    // Marker byte for None
+    constexpr std::uint8_t BOOL_MARKER = 0x05;    // Marker byte for bool: [marker] [0|1]
+    constexpr std::uint8_t INT_MARKER = 0x06;     // Marker byte for int: [marker] [int64 LE]
+    constexpr std::uint8_t FLOAT_MARKER = 0x07;   // Marker byte for float: [marker] [float64 LE]
+    constexpr std::uint8_t STR_MARKER = 0x08;     // Marker byte for str: [marker] [utf-8]
+
+    constexpr std::size_t OOB_ALIGNMENT = 16;     // Alignment of out-of-band buffers within a value
+    constexpr std::uint32_t NUMPY_MAX_DIMS = 64;  // Highest ndim numpy supports
+
+} // namespace shared_memory
@@ -1,3 +1,63 @@
+from collections.abc import Awaitable, Callable, Sequence
+from typing import Literal
+
+import numpy
+
+
+class LockTimeout(TimeoutError):
+    pass
+
+class MemoryPressure(MemoryError):
+    pass
+
+class SharedDictWriter:
+    def write(self, data: object) -> int:
+        """
+        Append a bytes-like chunk to the pending value; returns the number of bytes written
+        """
+
+    def close(self) -> None:
+        """Publish the value atomically under its key"""
+
+    def discard(self) -> None:
+        """Drop the pending value without publishing it"""
+
+    @property
+    def bytes_written(self) -> int:
+        """Number of bytes written so far"""
+
+    @property
+    def closed(self) -> bool:
+        """Whether the value has been published or discarded"""
+
+    def __enter__(self) -> object: ...
+    def __exit__(
+        self, exc_type: object | None, exc_value: object | None, traceback: object | None
+    ) -> bool: ...
+
+class SharedDictBatch:
+    def __setitem__(self, key: str | int | bytes | bytearray | memoryview, value: object) -> None:
+        """Buffer an update of the key; values are encoded right away"""
+
+    def __delitem__(self, key: str | int | bytes | bytearray | memoryview) -> None:
+        """Buffer the removal of the key; a key that does not exist is ignored"""
+
+    def __len__(self) -> int:
+        """Number of keys with buffered updates"""
+
+    def flush(self) -> int:
+        """
+        Apply the buffered updates, locking each stripe once; returns how many were applied
+        """
+
+    def discard(self) -> None:
+        """Drop the buffered updates without applying them"""
+
+    def __enter__(self) -> object: ...
+    def __exit__(
+        self, exc_type: object | None, exc_value: object | None, traceback: object | None
+    ) -> bool: ...
+
 class SharedDict:
     def __init__(
         self,
@@ -6,9 +66,19 @@ class SharedDict:
         size: int = 134217728,
         create: bool = True,
         max_keys: int = 128,
+        local_cache_size: int = 0,
+        bloom_capacity: int = 0,
+        max_entries: int = 0,
+        eviction_policy: str = "lru",
+        high_water_mark: float = 0.0,
+        on_memory_pressure: Callable[[SharedDict], object] | None = None,
+        indexes: Sequence[str] = (),
     ) -> None:
         """Create or open a shared memory dictionary"""
 
+    def __getstate__(self) -> tuple[str, int, int]: ...
+    def __setstate__(self, arg: tuple[str, int, int], /) -> None: ...
+
     def close(self) -> None:
         """Close access to shared memory without removing it"""
 
@@ -19,13 +89,82 @@ class SharedDict:
         """Check if this SharedDict connection has been closed"""
 
     def __len__(self) -> int: ...
-    def __contains__(self, arg: str, /) -> bool: ...
-    def __getitem__(self, arg: str, /) -> object: ...
-    def __setitem__(self, arg0: str, arg1: object, /) -> None: ...
-    def __delitem__(self, arg: str, /) -> None: ...
-    def get(self, key: str, default: object | None = None) -> object: ...
-    def keys(self) -> list:
-        """Return list of all keys"""
+    def __contains__(self, arg: str | int | bytes | bytearray | memoryview, /) -> bool: ...
+    def __getitem__(self, arg: str | int | bytes | bytearray | memoryview, /) -> object: ...
+    def __setitem__(self, arg0: str | int | bytes | bytearray | memoryview, arg1: object, /) -> None: ...
+    def __delitem__(self, arg: str | int | bytes | bytearray | memoryview, /) -> None: ...
+    def get(
+        self,
+        key: str | int | bytes | bytearray | memoryview,
+        default: object | None = None,
+        *,
+        timeout: float | None = None,
+        nonblocking: bool = False,
+    ) -> object:
+        """
+        Return the value for key, or default if it is missing; raises LockTimeout if the key's lock is not acquired within timeout seconds (or at once if nonblocking)
+        """
+
+    def set(
+        self,
+        key: str | int | bytes | bytearray | memoryview,
+        value: object,
+        *,
+        timeout: float | None = None,
+        nonblocking: bool = False,
+    ) -> None:
+        """Store value under key; raises LockTimeout like get()"""
+
+    def erase(
+        self, key: str | int | bytes | bytearray | memoryview, *, timeout: float | None = None, nonblocking: bool = False
+    ) -> bool:
+        """Remove key and return whether it was present; raises LockTimeout like get()"""
+
+    def get_many(
+        self,
+        keys: Sequence[str | int | bytes | bytearray | memoryview],
+        default: object | None = None,
+        *,
+        timeout: float | None = None,
+        nonblocking: bool = False,
+    ) -> list:
+        """
+        Return a list with the value of each key, or default for missing keys; timeout bounds the whole batch
+        """
+
+    def get_many_numpy(
+        self,
+        ids: numpy.ndarray,
+        dtype: object = "float64",
+        *,
+        timeout: float | None = None,
+        nonblocking: bool = False,
+    ) -> tuple[numpy.ndarray, numpy.ndarray]:
+        """
+        Look up an int64 array of int keys holding numbers; returns (values, found) arrays, with values of the given bool, int64 or float64 dtype in native byte order and 0 where found is False
+        """
+
+    def aget(self, key: str | int | bytes | bytearray | memoryview, default: object | None = None) -> Awaitable[object]:
+        """Awaitable get(); waits for a busy stripe lock off the event loop"""
+
+    def aset(self, key: str | int | bytes | bytearray | memoryview, value: object) -> Awaitable[None]:
+        """Awaitable __setitem__(); waits for a busy stripe lock off the event loop"""
+
+    def aget_many(self, keys: Sequence[str | int | bytes | bytearray | memoryview], default: object | None = None) -> Awaitable[list]:
+        """Awaitable get_many(); waits for busy stripe locks off the event loop"""
+
+    def writer(self, key: str | int | bytes | bytearray | memoryview, size_hint: int = 0) -> SharedDictWriter:
+        """
+        Stream a bytes value into shared memory; it is published when the writer is closed
+        """
+
+    def batch(self, flush_entries: int = 1024, flush_interval: float | None = None) -> SharedDictBatch:
+        """
+        Buffer updates and apply them grouped by stripe, once flush_entries keys are pending or at the first update made flush_interval seconds after the oldest pending one; there is no background thread, so an idle batch is only applied by flush() or on exit
+        """
+
+    def keys(self, *, timeout: float | None = None, nonblocking: bool = False) -> list:
+        """Return list of all keys; raises LockTimeout like get()"""
 
     def values(self) -> list:
         """Return list of all values"""
@@ -33,6 +172,31 @@ class SharedDict:
     def items(self) -> list:
         """Return list of (key, value) tuples"""
 
+    def find_by(self, field: str, value: str | int | bytes | bytearray | memoryview, *, timeout: float | None = None, nonblocking: bool = False) -> list:
+        """
+        Return the keys of dict values whose indexed field equals value, without reading any value; raises LockTimeout like get()
+        """
+
+    def scan_reduce(
+        self,
+        op: Literal["count", "sum", "min", "max", "mean", "keys"],
+        *,
+        where: tuple[Literal["<", "<=", ">", ">=", "==", "!="], float] | None = None,
+        threads: int = 0,
+        timeout: float | None = None,
+        nonblocking: bool = False,
+    ) -> float | int | list | None:
+        """
+        Reduce every number held by bool, int, float and numeric numpy values ('count', 'sum', 'min', 'max', 'mean'), or list the keys of values holding a number that passes where=(comparison, threshold) ('keys'); stripes are scanned on threads (one per CPU by default) without the GIL.
+        Sums, minima and maxima of integers alone are exact ints; timeout bounds the whole scan
+        """
+
+    def compact(self) -> int:
+        """
+        Rebuild each lock stripe from fresh allocations to reduce fragmentation; returns the number of entries relocated.
+        Stripes are copied a chunk at a time under their lock, and a stripe written during every attempt is skipped
+        """
+
     def get_stats(self) -> dict:
         """Get runtime statistics and diagnostic information"""
 
@@ -1,7 +1,5 @@
 #include "shareddict.hpp"
-#ifdef __linux__
-#include <sstream>
-#endif
+#include <cstdio>
 
 // Helper to write multi-byte values in little-endian format
 template <typename T>
@@ -22,356 +20,2485 @@ static T read_le(const char *&ptr)
     {
         value |= static_cast<T>(static_cast<uint8_t>(ptr[i])) << (i * 8);
     }
-    ptr += sizeof(T);
-    return value;
+    ptr += sizeof(T);
+    return value;
+}
+
+// Thread-local scratch buffers reused across operations, so steady-state
+// operations on small values do not allocate
+struct Scratch
+{
+    std::string buffer;
+    bool in_use = false;
+};
+
+static Scratch &header_scratch()
+{
+    thread_local Scratch scratch;
+    return scratch;
+}
+
+// Wrap a new reference returned by the Python C API, raising on failure
+static nb::object checked(PyObject *obj)
+{
+    if (obj == nullptr)
+    {
+        throw nb::python_error();
+    }
+    return nb::steal(obj);
+}
+
+// Python types of the core exceptions, set when the module registers them
+static PyObject *lock_timeout_type = nullptr;
+static PyObject *memory_pressure_type = nullptr;
+
+// Sets the Python error for an exception caught where nanobind cannot
+// translate it, such as in a destructor
+static void set_python_error(std::exception_ptr error)
+{
+    try
+    {
+        std::rethrow_exception(error);
+    }
+    catch (nb::python_error &e)
+    {
+        e.restore();
+    }
+    catch (const LockTimeout &e)
+    {
+        PyErr_SetString(lock_timeout_type, e.what());
+    }
+    catch (const MemoryPressure &e)
+    {
+        PyErr_SetString(memory_pressure_type, e.what());
+    }
+    catch (const std::exception &e)
+    {
+        PyErr_SetString(PyExc_RuntimeError, e.what());
+    }
+    catch (...)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "unknown C++ exception");
+    }
+}
+
+// KeyError carrying the original key object, like dict
+[[noreturn]] static void raise_key_error(const nb::handle &key)
+{
+    PyErr_SetObject(PyExc_KeyError, key.ptr());
+    throw nb::python_error();
+}
+
+// Writes the stored form of an int key (INT_KEY_SIZE bytes): big-endian with
+// the sign bit flipped, so keys sort like the numbers
+static void pack_int_key(int64_t value, char *out)
+{
+    uint64_t bits = static_cast<uint64_t>(value) ^ (uint64_t(1) << 63);
+    out[0] = static_cast<char>(INT_KEY_TAG);
+    for (size_t i = 1; i < INT_KEY_SIZE; ++i)
+    {
+        out[i] = static_cast<char>((bits >> ((INT_KEY_SIZE - 1 - i) * 8)) & 0xFF);
+    }
+}
+
+bool Key::from_python(nb::handle obj, Key &out) noexcept
+{
+    PyObject *ptr = obj.ptr();
+    if (PyUnicode_Check(ptr))
+    {
+        // The UTF-8 form is cached on the str object, which the key keeps alive
+        Py_ssize_t size = 0;
+        const char *utf8 = PyUnicode_AsUTF8AndSize(ptr, &size);
+        if (utf8 == nullptr)
+        {
+            PyErr_Clear();
+            return false;
+        }
+        out.view_ = std::string_view(utf8, static_cast<size_t>(size));
+        out.packed_size_ = 0;
+        out.spilled_ = false;
+    }
+    else if (PyLong_Check(ptr))
+    {
+        int overflow = 0;
+        long long value = PyLong_AsLongLongAndOverflow(ptr, &overflow);
+        if (overflow != 0 || (value == -1 && PyErr_Occurred()))
+        {
+            PyErr_Clear();
+            return false;
+        }
+        pack_int_key(value, out.packed_);
+        out.packed_size_ = INT_KEY_SIZE;
+    }
+    else if (PyBytes_Check(ptr))
+    {
+        if (!out.pack(BYTES_KEY_TAG, PyBytes_AS_STRING(ptr), static_cast<size_t>(PyBytes_GET_SIZE(ptr))))
+            return false;
+    }
+    else if (PyByteArray_Check(ptr) || PyMemoryView_Check(ptr))
+    {
+        // Compared by content, like bytes == memoryview in Python
+        Py_buffer view;
+        if (PyObject_GetBuffer(ptr, &view, PyBUF_SIMPLE) != 0)
+        {
+            PyErr_Clear();
+            return false;
+        }
+        bool packed = out.pack(BYTES_KEY_TAG, static_cast<const char *>(view.buf), static_cast<size_t>(view.len));
+        PyBuffer_Release(&view);
+        if (!packed)
+            return false;
+    }
+    else
+    {
+        return false;
+    }
+    out.object_ = nb::borrow(obj);
+    return true;
+}
+
+bool Key::pack(uint8_t tag, const char *data, size_t size) noexcept
+{
+    if (size < INLINE_BYTES)
+    {
+        packed_[0] = static_cast<char>(tag);
+        std::memcpy(packed_ + 1, data, size);
+        packed_size_ = static_cast<uint8_t>(size + 1);
+        spilled_ = false;
+    }
+    else
+    {
+        try
+        {
+            spill_.assign(1, static_cast<char>(tag));
+            spill_.append(data, size);
+        }
+        catch (const std::bad_alloc &)
+        {
+            return false;
+        }
+        packed_size_ = 0;
+        spilled_ = true;
+    }
+    return true;
+}
+
+nb::object Key::decode(std::string_view stored)
+{
+    if (stored.size() == INT_KEY_SIZE && static_cast<uint8_t>(stored[0]) == INT_KEY_TAG)
+    {
+        uint64_t bits = 0;
+        for (size_t i = 1; i < INT_KEY_SIZE; ++i)
+        {
+            bits = (bits << 8) | static_cast<uint8_t>(stored[i]);
+        }
+        return checked(PyLong_FromLongLong(static_cast<long long>(bits ^ (uint64_t(1) << 63))));
+    }
+    if (!stored.empty() && static_cast<uint8_t>(stored[0]) == BYTES_KEY_TAG)
+    {
+        return checked(PyBytes_FromStringAndSize(stored.data() + 1, static_cast<Py_ssize_t>(stored.size() - 1)));
+    }
+    return checked(PyUnicode_DecodeUTF8(stored.data(), static_cast<Py_ssize_t>(stored.size()), "strict"));
+}
+
+// Run a core operation that waits for a stripe lock. A blocking wait first
+// tries the lock with the GIL held; only a contended stripe makes the thread
+// wait with the GIL released, so other Python threads (and event loops) keep
+// running while uncontended operations never pay for a GIL round trip.
+// `op` must not touch Python objects
+template <class Op>
+static auto run_locked(LockWait wait, Op &&op) -> decltype(op(wait))
+{
+    if (wait.may_block())
+    {
+        try
+        {
+            return op(LockWait::none());
+        }
+        catch (const LockTimeout &)
+        {
+            // Contended - fall through to the blocking wait
+        }
+        nb::gil_scoped_release release;
+        return op(wait);
+    }
+    return op(wait);
+}
+
+// Translate the timeout=/nonblocking= arguments of an operation into a stripe
+// lock wait; the semantics mirror threading.Lock.acquire()
+static LockWait lock_wait(std::optional<double> timeout, bool nonblocking)
+{
+    if (nonblocking)
+    {
+        if (timeout)
+        {
+            throw nb::value_error("can't specify a timeout for a non-blocking call");
+        }
+        return LockWait::none();
+    }
+    if (!timeout)
+    {
+        return LockWait::forever();
+    }
+    if (!(*timeout >= 0.0))
+    {
+        throw nb::value_error("timeout value must be a non-negative number");
+    }
+    return LockWait::for_duration(std::chrono::microseconds(static_cast<int64_t>(*timeout * 1e6)));
+}
+
+// Hands out a scratch buffer for the duration of one operation; a buffer
+// grown past SCRATCH_RETAIN_BYTES is released afterwards rather than kept.
+// Pickling runs Python code that may write to a dictionary again on the same
+// thread, so an operation nested in another gets a buffer of its own
+class ScratchBuffer
+{
+public:
+    explicit ScratchBuffer(Scratch &scratch) : scratch_(scratch.in_use ? nullptr : &scratch)
+    {
+        if (scratch_ != nullptr)
+        {
+            scratch_->in_use = true;
+            scratch_->buffer.clear();
+        }
+    }
+    ~ScratchBuffer()
+    {
+        if (scratch_ == nullptr)
+        {
+            return;
+        }
+        if (scratch_->buffer.capacity() > SCRATCH_RETAIN_BYTES)
+        {
+            std::string().swap(scratch_->buffer);
+        }
+        scratch_->in_use = false;
+    }
+
+    ScratchBuffer(const ScratchBuffer &) = delete;
+    ScratchBuffer &operator=(const ScratchBuffer &) = delete;
+
+    std::string &get() { return scratch_ != nullptr ? scratch_->buffer : nested_; }
+
+private:
+    Scratch *scratch_;
+    std::string nested_;
+};
+
+// The pickle module of the calling interpreter. Found in its sys.modules
+// without going through the import machinery once imported; not cached
+// process-wide, which would hand one interpreter's module to another and
+// race between threads of free-threaded builds
+static nb::object interpreter_pickle_module()
+{
+    PyObject *module = PyImport_GetModule(nb::str("pickle").ptr());
+    if (module != nullptr)
+    {
+        return nb::steal(module);
+    }
+    if (PyErr_Occurred())
+    {
+        throw nb::python_error();
+    }
+    return nb::module_::import_("pickle");
+}
+
+static EvictionPolicy parse_eviction_policy(const std::string &policy)
+{
+    if (policy == "lru")
+        return EvictionPolicy::lru;
+    if (policy == "tinylfu")
+        return EvictionPolicy::tinylfu;
+    throw nb::value_error("eviction_policy must be 'lru' or 'tinylfu'");
+}
+
+static const char *eviction_policy_name(EvictionPolicy policy)
+{
+    switch (policy)
+    {
+    case EvictionPolicy::lru:
+        return "lru";
+    case EvictionPolicy::tinylfu:
+        return "tinylfu";
+    default:
+        return "none";
+    }
+}
+
+// The indexed fields chosen by the creator of the segment, as dict keys
+static std::vector<nb::object> index_names_of(const SharedMemoryDict &shm)
+{
+    std::vector<nb::object> names;
+    for (const std::string &field : shm.index_fields())
+    {
+        names.push_back(nb::str(field.data(), field.size()));
+    }
+    return names;
+}
+
+SharedDict::SharedDict(
+    const std::string &name,
+    nb::object data,
+    const size_t size,
+    const bool create,
+    const size_t max_keys,
+    const size_t local_cache_size,
+    const size_t bloom_capacity,
+    const size_t max_entries,
+    const std::string &eviction_policy,
+    const double high_water_mark,
+    nb::object on_memory_pressure,
+    const std::vector<std::string> &indexes) : name_(name),
+                                     size_(size),
+                                     created_(create),
+                                     max_keys_(max_keys),
+                                     local_cache_size_(local_cache_size),
+                                     shm_ptr_(nullptr),
+                                     on_memory_pressure_(std::move(on_memory_pressure))
+{
+    pickle_module_ = interpreter_pickle_module();
+
+    CacheOptions cache{max_entries, parse_eviction_policy(eviction_policy)};
+    shm_ptr_ = new SharedMemoryDict(name_, size_, create, max_keys_, bloom_capacity, cache, high_water_mark, indexes);
+    max_keys_ = shm_ptr_->stripe_count();
+    index_names_ = index_names_of(*shm_ptr_);
+
+    if (!data.is_none())
+    {
+        initialize_data(data);
+    }
+}
+
+SharedDict::SharedDict(const std::string &name, uint64_t generation, size_t local_cache_size)
+    : name_(name),
+      size_(0),
+      created_(false),
+      max_keys_(0),
+      local_cache_size_(local_cache_size),
+      shm_ptr_(nullptr)
+{
+    pickle_module_ = interpreter_pickle_module();
+
+    shm_ptr_ = new SharedMemoryDict(name_, generation);
+    max_keys_ = shm_ptr_->stripe_count();
+    index_names_ = index_names_of(*shm_ptr_);
+}
+
+// Pickled form: just enough to find the same segment again. Unpickling in this
+// process, or in a child forked from it, reuses the existing mapping
+nb::tuple SharedDict::__getstate__() const
+{
+    if (is_closed())
+    {
+        throw std::runtime_error("Cannot pickle a closed SharedDict");
+    }
+    return nb::make_tuple(name_, shm_ptr_->generation(), local_cache_size_);
+}
+
+SharedDict::~SharedDict()
+{
+    if (shm_ptr_ != nullptr)
+    {
+        // The C++ destructor will call close() if not already closed
+        delete shm_ptr_;
+        shm_ptr_ = nullptr;
+    }
+}
+
+void SharedDict::close()
+{
+    // Cached objects are released after unlocking; their finalizers may use this dict
+    std::unordered_map<std::string, LocalEntry> dropped;
+    {
+        nb::ft_lock_guard guard(local_cache_mutex_);
+        dropped.swap(local_cache_);
+    }
+    dropped.clear();
+    if (shm_ptr_ != nullptr)
+    {
+        shm_ptr_->close();
+    }
+}
+
+void SharedDict::unlink()
+{
+    if (shm_ptr_ != nullptr)
+    {
+        if (!shm_ptr_->is_closed())
+        {
+            throw std::runtime_error("Cannot unlink a SharedDict that is still open. Call close() first.");
+        }
+        shm_ptr_->unlink();
+    }
+}
+
+bool SharedDict::is_closed() const
+{
+    if (shm_ptr_ == nullptr)
+    {
+        return true;
+    }
+    return shm_ptr_->is_closed();
+}
+
+// Check if object is a numpy array (without importing numpy if not needed)
+bool SharedDict::is_numpy_array(const nb::object &obj) const
+{
+    // Use nanobind's built-in check for ndarray
+    return nb::isinstance<nb::ndarray<>>(obj);
+}
+
+// Serialize value: use native C++ for numpy, pickle for everything else.
+// Contiguous buffers found while pickling are collected out-of-band in `buffers`
+SerializedValue SharedDict::serialize_value(const nb::object &obj, std::string &header, nb::list &buffers) const
+{
+    static const char pickle_marker = static_cast<char>(PICKLE_MARKER);
+
+    SerializedValue native;
+    if (serialize_native(obj, header, native))
+    {
+        return native;
+    }
+    else if (is_numpy_array(obj))
+    {
+        // Native numpy serialization; the array data is stored straight from its buffer
+        std::string_view payload = serialize_numpy(nb::cast<nb::ndarray<>>(obj), header);
+        return SerializedValue{header, payload, obj};
+    }
+    else
+    {
+        // Call pickle.dumps with highest protocol; protocol 5 hands large
+        // contiguous buffers (arrays nested in containers, bytes-like blocks)
+        // to the callback instead of inlining them in the stream
+        nb::object pickled = pickle_module_.attr("dumps")(
+            obj,
+            nb::arg("protocol") = pickle_module_.attr("HIGHEST_PROTOCOL"),
+            nb::arg("buffer_callback") = buffers.attr("append"));
+        nb::bytes pickled_bytes = nb::cast<nb::bytes>(pickled);
+
+        // The pickled bytes are stored as-is behind the marker
+        std::string_view payload(pickled_bytes.c_str(), pickled_bytes.size());
+        return SerializedValue{std::string_view(&pickle_marker, 1), payload, pickled_bytes};
+    }
+}
+
+// Native encodings for exact built-in scalars, which skip pickle entirely.
+// Subclasses (IntEnum, str subclasses, ...) keep going through pickle so their
+// type survives the round trip
+bool SharedDict::serialize_native(const nb::object &obj, std::string &header, SerializedValue &out) const
+{
+    PyObject *ptr = obj.ptr();
+
+    if (ptr == Py_None)
+    {
+        header.push_back(NONE_MARKER);
+    }
+    else if (PyBool_Check(ptr))
+    {
+        header.push_back(BOOL_MARKER);
+        header.push_back(ptr == Py_True ? 1 : 0);
+    }
+    else if (PyLong_CheckExact(ptr))
+    {
+        int overflow = 0;
+        long long value = PyLong_AsLongLongAndOverflow(ptr, &overflow);
+        if (overflow != 0 || (value == -1 && PyErr_Occurred()))
+        {
+            // Does not fit in 64 bits - let pickle handle it
+            PyErr_Clear();
+            return false;
+        }
+        header.push_back(INT_MARKER);
+        write_le<uint64_t>(header, static_cast<uint64_t>(value));
+    }
+    else if (PyFloat_CheckExact(ptr))
+    {
+        double value = PyFloat_AS_DOUBLE(ptr);
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        header.push_back(FLOAT_MARKER);
+        write_le<uint64_t>(header, bits);
+    }
+    else if (PyUnicode_CheckExact(ptr))
+    {
+        // The UTF-8 form is cached on the str object, so this does not copy
+        Py_ssize_t size = 0;
+        const char *utf8 = PyUnicode_AsUTF8AndSize(ptr, &size);
+        if (utf8 == nullptr)
+        {
+            // Lone surrogates cannot be encoded - let pickle handle it
+            PyErr_Clear();
+            return false;
+        }
+        header.push_back(STR_MARKER);
+        out = SerializedValue{header, std::string_view(utf8, static_cast<size_t>(size)), obj};
+        return true;
+    }
+    else if (PyBytes_CheckExact(ptr))
+    {
+        header.push_back(BYTES_MARKER);
+        out = SerializedValue{header, std::string_view(PyBytes_AS_STRING(ptr), PyBytes_GET_SIZE(ptr)), obj};
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+
+    out = SerializedValue{header, std::string_view(), nb::object()};
+    return true;
+}
+
+// Copy a value out of shared memory while its stripe lock is held.
+// Only C-level allocations happen here: running Python code could release
+// the GIL while the interprocess lock is held and deadlock other threads
+void SharedDict::capture_value(std::string_view data, CapturedValue &out) const
+{
+    if (data.empty())
+    {
+        throw std::runtime_error("Empty data cannot be deserialized");
+    }
+
+    const uint8_t marker = static_cast<uint8_t>(data[0]);
+    const char *payload = data.data() + 1;
+    const size_t payload_size = data.size() - 1;
+    out.marker = marker;
+    out.decoded = true;
+
+    switch (marker)
+    {
+    case NONE_MARKER:
+        out.object = nb::none();
+        break;
+    case BOOL_MARKER:
+        out.object = nb::bool_(payload_size > 0 && payload[0] != 0);
+        break;
+    case INT_MARKER:
+    case FLOAT_MARKER:
+    {
+        if (payload_size != sizeof(uint64_t))
+        {
+            throw std::runtime_error("Corrupted scalar value");
+        }
+        uint64_t bits = read_le<uint64_t>(payload);
+        if (marker == INT_MARKER)
+        {
+            out.object = checked(PyLong_FromLongLong(static_cast<long long>(bits)));
+        }
+        else
+        {
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            out.object = checked(PyFloat_FromDouble(value));
+        }
+        break;
+    }
+    case STR_MARKER:
+        out.object = checked(PyUnicode_DecodeUTF8(payload, static_cast<Py_ssize_t>(payload_size), "strict"));
+        break;
+    case BYTES_MARKER:
+        // Raw bytes: stored bytes objects and values written through SharedDict.writer()
+        out.object = checked(PyBytes_FromStringAndSize(payload, static_cast<Py_ssize_t>(payload_size)));
+        break;
+    case NUMPY_MARKER:
+        out.decoded = false;
+        capture_numpy(payload, payload_size, out);
+        break;
+    case PICKLE5_MARKER:
+        // Offsets in the layout are relative to the value start, so keep the marker
+        out.decoded = false;
+        out.object = checked(PyByteArray_FromStringAndSize(data.data(), static_cast<Py_ssize_t>(data.size())));
+        break;
+    case PICKLE_MARKER:
+        out.decoded = false;
+        out.object = checked(PyBytes_FromStringAndSize(payload, static_cast<Py_ssize_t>(payload_size)));
+        break;
+    default:
+        // Legacy data without marker - assume pickle
+        out.decoded = false;
+        out.object = checked(PyBytes_FromStringAndSize(data.data(), static_cast<Py_ssize_t>(data.size())));
+        break;
+    }
+}
+
+// Turn a captured value into its Python object once the lock is released
+nb::object SharedDict::finish_value(CapturedValue &captured) const
+{
+    if (captured.decoded)
+    {
+        return captured.object;
+    }
+    else if (captured.marker == NUMPY_MARKER)
+    {
+        return finish_numpy(captured);
+    }
+    else if (captured.marker == PICKLE5_MARKER)
+    {
+        return deserialize_out_of_band(captured.object);
+    }
+    else
+    {
+        return pickle_module_.attr("loads")(captured.object);
+    }
+}
+
+// Round offsets up so out-of-band buffers start suitably aligned
+static size_t align_up(size_t offset)
+{
+    return (offset + OOB_ALIGNMENT - 1) & ~(OOB_ALIGNMENT - 1);
+}
+
+// Slice a memoryview without copying; the slice keeps the base object alive
+static nb::object slice_view(const nb::object &view, size_t start, size_t stop)
+{
+    nb::object bounds = nb::steal(PySlice_New(nb::int_(start).ptr(), nb::int_(stop).ptr(), nullptr));
+    if (!bounds.is_valid())
+    {
+        throw nb::python_error();
+    }
+    nb::object result = nb::steal(PyObject_GetItem(view.ptr(), bounds.ptr()));
+    if (!result.is_valid())
+    {
+        throw nb::python_error();
+    }
+    return result;
+}
+
+// Write a protocol 5 pickle stream and its out-of-band buffers straight into
+// shared memory, so each buffer is copied exactly once
+void SharedDict::store_out_of_band(std::string_view key, std::string &header, std::string_view stream,
+                                   const nb::list &buffers, LockWait wait, std::string_view index_terms)
+{
+    std::unique_ptr<ValueWriter> writer = write_out_of_band(key, header, stream, buffers, wait);
+    run_locked(wait, [&](LockWait w)
+               { writer->commit(w, index_terms); });
+}
+
+// Copies the value of store_out_of_band() into an unpublished ValueWriter;
+// only the soft limit check may take the stripe lock here
+std::unique_ptr<ValueWriter> SharedDict::write_out_of_band(std::string_view key, std::string &header,
+                                                           std::string_view stream, const nb::list &buffers,
+                                                           LockWait wait)
+{
+    const size_t count = buffers.size();
+
+    // Pin the raw memory of every PickleBuffer for the duration of the copy
+    std::vector<Py_buffer> views(count);
+    size_t pinned = 0;
+    auto release_views = [&]()
+    {
+        for (size_t i = 0; i < pinned; ++i)
+        {
+            PyBuffer_Release(&views[i]);
+        }
+    };
+
+    try
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            nb::object raw = buffers[i].attr("raw")();
+            if (PyObject_GetBuffer(raw.ptr(), &views[i], PyBUF_SIMPLE) != 0)
+            {
+                throw nb::python_error();
+            }
+            ++pinned;
+        }
+
+        // Only the marker precedes the stream, whatever the caller left here
+        header.clear();
+        header.push_back(PICKLE5_MARKER);
+        write_le<uint32_t>(header, static_cast<uint32_t>(count));
+        write_le<uint64_t>(header, static_cast<uint64_t>(stream.size()));
+        for (size_t i = 0; i < count; ++i)
+        {
+            write_le<uint64_t>(header, static_cast<uint64_t>(views[i].len));
+        }
+
+        size_t total = header.size() + stream.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            total = align_up(total) + static_cast<size_t>(views[i].len);
+        }
+
+        static const char padding[OOB_ALIGNMENT] = {};
+        auto writer = std::make_unique<ValueWriter>(*shm_ptr_, key, total, wait);
+        writer->write(header.data(), header.size());
+        writer->write(stream.data(), stream.size());
+        for (size_t i = 0; i < count; ++i)
+        {
+            writer->write(padding, align_up(writer->size()) - writer->size());
+            writer->write(static_cast<const char *>(views[i].buf), static_cast<size_t>(views[i].len));
+        }
+        release_views();
+        return writer;
+    }
+    catch (...)
+    {
+        release_views();
+        throw;
+    }
+}
+
+// Rebuild a protocol 5 pickle whose buffers follow the stream. The value was
+// copied once into a bytearray and the buffers are handed to pickle as
+// memoryviews over it, so arrays come back writable without further copies
+nb::object SharedDict::deserialize_out_of_band(const nb::object &storage) const
+{
+    const char *data = PyByteArray_AS_STRING(storage.ptr());
+    const size_t size = static_cast<size_t>(PyByteArray_GET_SIZE(storage.ptr()));
+    static const char *const corrupted = "Corrupted out-of-band pickle value";
+
+    // Every length is checked against the bytes left before it is used, so a
+    // damaged value can neither read past the copy nor size a huge allocation
+    size_t offset = 1 + sizeof(uint32_t) + sizeof(uint64_t);
+    if (size < offset)
+    {
+        throw nb::value_error(corrupted);
+    }
+    const char *ptr = data + 1;
+    uint32_t count = read_le<uint32_t>(ptr);
+    uint64_t stream_len = read_le<uint64_t>(ptr);
+    if (count > (size - offset) / sizeof(uint64_t))
+    {
+        throw nb::value_error(corrupted);
+    }
+    std::vector<uint64_t> lengths(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        lengths[i] = read_le<uint64_t>(ptr);
+    }
+    offset += count * sizeof(uint64_t);
+    if (stream_len > size - offset)
+    {
+        throw nb::value_error(corrupted);
+    }
+
+    nb::object view = checked(PyMemoryView_FromObject(storage.ptr()));
+    nb::object stream = slice_view(view, offset, offset + stream_len);
+    offset += stream_len;
+
+    nb::list buffers;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        offset = align_up(offset);
+        if (offset > size || lengths[i] > size - offset)
+        {
+            throw nb::value_error(corrupted);
+        }
+        buffers.append(slice_view(view, offset, offset + lengths[i]));
+        offset += lengths[i];
+    }
+
+    return pickle_module_.attr("loads")(stream, nb::arg("buffers") = buffers);
+}
+
+// Native numpy serialization - direct memory access, no pickle.
+// Writes the marker and array header into `header` and returns a view of the
+// array data, which is copied into shared memory without an intermediate buffer
+std::string_view SharedDict::serialize_numpy(const nb::ndarray<> &arr, std::string &header) const
+{
+    // Write marker
+    header.push_back(NUMPY_MARKER);
+
+    // Get dtype information
+    nb::dlpack::dtype dtype = arr.dtype();
+
+    // Format dtype string manually based on dlpack dtype
+    // Format: [<,>,|][type_code][itemsize]
+    char endian = '<'; // little-endian (most common)
+    char type_code;
+
+    nb::dlpack::dtype_code code_value = static_cast<nb::dlpack::dtype_code>(dtype.code);
+
+    switch (code_value)
+    {
+    case nb::dlpack::dtype_code::Int:
+        type_code = 'i';
+        break;
+    case nb::dlpack::dtype_code::UInt:
+        type_code = 'u';
+        break;
+    case nb::dlpack::dtype_code::Float:
+        type_code = 'f';
+        break;
+    case nb::dlpack::dtype_code::Complex:
+        type_code = 'c';
+        break;
+    case nb::dlpack::dtype_code::Bool:
+        type_code = 'b';
+        break;
+    default:
+        throw std::runtime_error("Unsupported numpy dtype");
+    }
+
+    // Build dtype string (e.g., "<f8" for little-endian float64)
+    char dtype_str[16];
+    int dtype_len = std::snprintf(dtype_str, sizeof(dtype_str), "%c%c%u", endian, type_code,
+                                  static_cast<unsigned>(dtype.bits / 8));
+
+    // Write dtype length and dtype string
+    write_le<uint32_t>(header, static_cast<uint32_t>(dtype_len));
+    header.append(dtype_str, static_cast<size_t>(dtype_len));
+
+    // Write ndim
+    write_le<uint32_t>(header, static_cast<uint32_t>(arr.ndim()));
+
+    // Write shape
+    for (size_t i = 0; i < arr.ndim(); ++i)
+    {
+        write_le<uint64_t>(header, static_cast<uint64_t>(arr.shape(i)));
+    }
+
+    // Write data length
+    size_t data_len = arr.nbytes();
+    write_le<uint64_t>(header, static_cast<uint64_t>(data_len));
+
+    // Array data is borrowed, not copied
+    return std::string_view(static_cast<const char *>(arr.data()), data_len);
+}
+
+// Native numpy deserialization, first half: parse the header and copy the
+// array data straight from shared memory into a bytearray (runs under the lock)
+void SharedDict::capture_numpy(const char *data, size_t size, CapturedValue &out) const
+{
+    const char *ptr = data;
+
+    // Read dtype length and string
+    uint32_t dtype_len = read_le<uint32_t>(ptr);
+    if (dtype_len >= sizeof(out.dtype))
+    {
+        throw std::runtime_error("Corrupted numpy value");
+    }
+    std::memcpy(out.dtype, ptr, dtype_len);
+    out.dtype[dtype_len] = '\0';
+    ptr += dtype_len;
+
+    // Read ndim and shape
+    out.ndim = read_le<uint32_t>(ptr);
+    if (out.ndim > NUMPY_MAX_DIMS)
+    {
+        throw std::runtime_error("Corrupted numpy value");
+    }
+    for (uint32_t i = 0; i < out.ndim; ++i)
+    {
+        out.shape[i] = read_le<uint64_t>(ptr);
+    }
+
+    // Read data length
+    uint64_t data_len = read_le<uint64_t>(ptr);
+    if (static_cast<size_t>(ptr - data) + data_len > size)
+    {
+        throw std::runtime_error("Corrupted numpy value");
+    }
+
+    // The one and only copy of the array data
+    out.object = checked(PyByteArray_FromStringAndSize(ptr, static_cast<Py_ssize_t>(data_len)));
+}
+
+// Native numpy deserialization, second half: wrap the captured bytearray
+// without copying; the array owns it and stays writable
+nb::object SharedDict::finish_numpy(const CapturedValue &captured) const
+{
+    // Import numpy module
+    nb::object np = nb::module_::import_("numpy");
+
+    nb::object arr = np.attr("frombuffer")(captured.object, nb::arg("dtype") = nb::str(captured.dtype));
+
+    // Reshape unless the flat buffer already has the right shape
+    if (captured.ndim != 1)
+    {
+        nb::object shape_tuple = checked(PyTuple_New(captured.ndim));
+        for (uint32_t i = 0; i < captured.ndim; ++i)
+        {
+            PyTuple_SET_ITEM(shape_tuple.ptr(), i, nb::int_(captured.shape[i]).release().ptr());
+        }
+        arr = arr.attr("reshape")(shape_tuple);
+    }
+    return arr;
+}
+
+// Bulk loading of the constructor's data. Values are serialized in batches
+// with the GIL held; only pickling actually needs it, the other encodings just
+// reference the bytes of their objects. Each batch is then copied into the
+// segment with the GIL released, by several threads that each own a share of
+// the lock stripes
+void SharedDict::initialize_data(const nb::object &data)
+{
+    if (!nb::isinstance<nb::dict>(data))
+    {
+        throw nb::type_error("Argument 'data' has incorrect type (expected dict)");
+    }
+
+    nb::dict data_dict = nb::cast<nb::dict>(data);
+    size_t initialized_count = 0;
+
+    // Keys, value headers and index terms of the batch live in one arena;
+    // payloads point into the objects kept in `owners`
+    struct PendingEntry
+    {
+        size_t key_offset;
+        size_t key_size;
+        size_t header_offset;
+        size_t header_size;
+        size_t terms_size; // after the header
+        std::string_view payload;
+    };
+    std::string arena;
+    std::vector<PendingEntry> pending;
+    std::vector<nb::object> owners;
+    pending.reserve(std::min(INIT_BATCH_ENTRIES, data_dict.size()));
+
+    auto flush = [&]()
+    {
+        if (pending.empty())
+            return;
+        std::vector<std::string_view> keys, terms;
+        keys.reserve(pending.size());
+        terms.reserve(pending.size());
+        for (const PendingEntry &entry : pending)
+        {
+            keys.emplace_back(arena.data() + entry.key_offset, entry.key_size);
+            terms.emplace_back(arena.data() + entry.header_offset + entry.header_size, entry.terms_size);
+        }
+        const size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                                pending.size() / INIT_ENTRIES_PER_THREAD + 1);
+        {
+            nb::gil_scoped_release release;
+            shm_ptr_->set_many_with(
+                keys.data(), keys.size(),
+                [&](size_t i, ByteVec &value)
+                {
+                    const PendingEntry &entry = pending[i];
+                    const char *header = arena.data() + entry.header_offset;
+                    value.reserve(entry.header_size + entry.payload.size());
+                    value.insert(value.end(), header, header + entry.header_size);
+                    value.insert(value.end(), entry.payload.begin(), entry.payload.end());
+                },
+                threads, LockWait::forever(), terms.data());
+        }
+        initialized_count += pending.size();
+        arena.clear();
+        pending.clear();
+        owners.clear();
+    };
+
+    // Track if we had a type error to re-throw it
+    bool had_type_error = false;
+    std::string type_error_msg;
+
+    try
+    {
+        try
+        {
+            for (auto item : data_dict)
+            {
+                Key key;
+                if (!Key::from_python(item.first, key))
+                {
+                    had_type_error = true;
+                    type_error_msg = "All keys must be str, int (within the int64 range) or bytes-like";
+                    throw std::runtime_error(type_error_msg);
+                }
+
+                nb::object value = nb::borrow(item.second);
+                ScratchBuffer header(header_scratch());
+                nb::list buffers;
+                SerializedValue serialized = serialize_value(value, header.get(), buffers);
+                if (buffers.size() != 0)
+                {
+                    // Out-of-band buffers are pinned and copied one value at a time
+                    std::string terms;
+                    index_terms(value, terms);
+                    store_out_of_band(key.bytes(), header.get(), serialized.payload, buffers, LockWait::forever(),
+                                      terms);
+                    initialized_count++;
+                    continue;
+                }
+
+                PendingEntry entry{arena.size(), key.bytes().size(), 0, serialized.header.size(), 0,
+                                   serialized.payload};
+                arena.append(key.bytes());
+                entry.header_offset = arena.size();
+                arena.append(serialized.header);
+                index_terms(value, arena);
+                entry.terms_size = arena.size() - entry.header_offset - entry.header_size;
+                pending.push_back(entry);
+                if (serialized.payload_owner.is_valid())
+                {
+                    owners.push_back(std::move(serialized.payload_owner));
+                }
+                if (pending.size() == INIT_BATCH_ENTRIES)
+                {
+                    flush();
+                }
+            }
+        }
+        catch (...)
+        {
+            // Entries before the failing one are stored, as with item-by-item loading
+            flush();
+            throw;
+        }
+        flush();
+    }
+    catch (const std::exception &e)
+    {
+        // Check if it was a type error
+        if (had_type_error)
+        {
+            throw nb::type_error(type_error_msg.c_str());
+        }
+
+        // Wrap other exceptions in ValueError
+        std::string error_msg = "Failed to initialize SharedDict after " +
+                                std::to_string(initialized_count) + " items: " + e.what();
+        throw nb::value_error(error_msg.c_str());
+    }
+}
+
+size_t SharedDict::__len__() const
+{
+    return shm_ptr_->size();
+}
+
+bool SharedDict::__contains__(const Key &key) const
+{
+    return run_locked(LockWait::forever(), [&](LockWait w)
+                      { return shm_ptr_->contains(key.bytes(), w); });
+}
+
+// Look a value up and capture it for decoding. An uncontended stripe is
+// decoded straight from shared memory; a contended one is waited for with the
+// GIL released, copying the raw bytes out to decode once the GIL is back
+bool SharedDict::fetch_value(std::string_view key, LockWait wait, CapturedValue &out,
+                             uint64_t *version) const
+{
+    auto capture = [&](std::string_view data)
+    { capture_value(data, out); };
+
+    if (!wait.may_block())
+    {
+        return shm_ptr_->get_with(key, capture, wait, version);
+    }
+    try
+    {
+        return shm_ptr_->get_with(key, capture, LockWait::none(), version);
+    }
+    catch (const LockTimeout &)
+    {
+        // Contended - fall through to the blocking wait
+    }
+
+    std::string raw;
+    bool found;
+    {
+        nb::gil_scoped_release release;
+        found = shm_ptr_->get(key, raw, wait, version);
+    }
+    if (found)
+    {
+        capture_value(raw, out);
+    }
+    return found;
+}
+
+// The object a local cache entry hands out. A hit returns what a read
+// without the cache would: scalars, strings and bytes are immutable and
+// shared, while arrays and pickled values are handed out as fresh, writable
+// copies, so no caller sees another's changes. Arrays are copied from the
+// cached one; pickled values are kept encoded and unpickled on each hit,
+// and out-of-band buffers are decoded from a copy of the cached storage
+nb::object SharedDict::local_object(const LocalEntry &entry) const
+{
+    switch (entry.marker)
+    {
+    case PICKLE_MARKER:
+        return pickle_module_.attr("loads")(entry.value);
+    case PICKLE5_MARKER:
+        return deserialize_out_of_band(checked(PyByteArray_FromObject(entry.value.ptr())));
+    case NUMPY_MARKER:
+        return entry.value.attr("copy")();
+    default:
+        return entry.value;
+    }
+}
+
+// A hit of the local cache: an entry whose stripe version is unchanged, so a
+// hit costs one atomic load and a hash lookup, plus unpickling for pickled values
+bool SharedDict::cached_value(std::string_view key, nb::object &out) const
+{
+    // The cache lock is never held while running Python code
+    LocalEntry entry{0, nb::object()};
+    {
+        nb::ft_lock_guard guard(local_cache_mutex_);
+        auto it = local_cache_.find(std::string(key));
+        if (it != local_cache_.end() && it->second.version == shm_ptr_->stripe_version(key))
+        {
+            entry = it->second;
+        }
+    }
+    if (!entry.value.is_valid())
+    {
+        local_cache_misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    local_cache_hits_.fetch_add(1, std::memory_order_relaxed);
+    out = local_object(entry);
+    return true;
+}
+
+// Caches a value read at stripe version `version` and returns its object.
+// Objects leaving the cache are released after unlocking it
+nb::object SharedDict::admit_local(std::string_view key, uint64_t version, CapturedValue &captured) const
+{
+    LocalEntry entry{version, nb::object()};
+    nb::object out;
+    if (captured.decoded)
+    {
+        entry.marker = captured.marker;
+        entry.value = captured.object;
+        out = entry.value;
+    }
+    else if (captured.marker == NUMPY_MARKER)
+    {
+        // The cached array is never handed out, and read-only as a safeguard
+        entry.marker = NUMPY_MARKER;
+        out = finish_numpy(captured);
+        entry.value = out.attr("copy")();
+        entry.value.attr("setflags")(nb::arg("write") = false);
+    }
+    else
+    {
+        // Values without a marker are pickles too
+        entry.marker = captured.marker == PICKLE5_MARKER ? PICKLE5_MARKER : PICKLE_MARKER;
+        entry.value = captured.object;
+        out = local_object(entry);
+    }
+
+    nb::object dropped;
+    std::string cache_key(key);
+    nb::ft_lock_guard guard(local_cache_mutex_);
+    auto it = local_cache_.find(cache_key);
+    if (it != local_cache_.end())
+    {
+        // Another thread may have cached a newer read meanwhile
+        if (it->second.version <= entry.version)
+        {
+            dropped = std::move(it->second.value);
+            it->second = std::move(entry);
+        }
+    }
+    else
+    {
+        if (local_cache_.size() >= local_cache_size_)
+        {
+            // Hot keys are re-admitted on their next read, so any victim will do
+            dropped = std::move(local_cache_.begin()->second.value);
+            local_cache_.erase(local_cache_.begin());
+        }
+        local_cache_.emplace(std::move(cache_key), std::move(entry));
+    }
+    return out;
+}
+
+// Drops a key a lookup found absent from the local cache
+void SharedDict::forget_local(std::string_view key) const
+{
+    nb::object dropped;
+    nb::ft_lock_guard guard(local_cache_mutex_);
+    auto it = local_cache_.find(std::string(key));
+    if (it != local_cache_.end())
+    {
+        dropped = std::move(it->second.value);
+        local_cache_.erase(it);
+    }
+}
+
+// Look a value up and decode it, going through the local cache when enabled
+bool SharedDict::load_value(std::string_view key, LockWait wait, nb::object &out) const
+{
+    CapturedValue captured;
+    if (local_cache_size_ == 0)
+    {
+        if (!fetch_value(key, wait, captured))
+        {
+            return false;
+        }
+        out = finish_value(captured);
+        return true;
+    }
+
+    if (cached_value(key, out))
+    {
+        return true;
+    }
+    uint64_t version = 0;
+    if (!fetch_value(key, wait, captured, &version))
+    {
+        forget_local(key);
+        return false;
+    }
+    out = admit_local(key, version, captured);
+    return true;
+}
+
+nb::object SharedDict::__getitem__(const Key &key) const
+{
+    nb::object value;
+    if (!load_value(key.bytes(), LockWait::forever(), value))
+    {
+        raise_key_error(key.object());
+    }
+    return value;
+}
+
+void SharedDict::__setitem__(const Key &key, const nb::object &value)
+{
+    store_value(key.bytes(), value, LockWait::forever());
+}
+
+// Only dict values are indexed: each indexed field they have whose value is
+// a str, int or bytes-like object contributes a term, encoded like a key
+void SharedDict::index_terms(const nb::object &value, std::string &out) const
+{
+    if (index_names_.empty() || !PyDict_Check(value.ptr()))
+        return;
+
+    for (size_t i = 0; i < index_names_.size(); ++i)
+    {
+#if PY_VERSION_HEX >= 0x030D0000
+        PyObject *item = nullptr;
+        if (PyDict_GetItemRef(value.ptr(), index_names_[i].ptr(), &item) < 0)
+        {
+            throw nb::python_error();
+        }
+        nb::object field = nb::steal(item);
+#else
+        PyObject *item = PyDict_GetItemWithError(value.ptr(), index_names_[i].ptr());
+        if (item == nullptr && PyErr_Occurred())
+        {
+            throw nb::python_error();
+        }
+        nb::object field = nb::borrow(item);
+#endif
+        Key term;
+        if (field.is_valid() && Key::from_python(field, term))
+        {
+            append_index_term(out, i, term.bytes());
+        }
+    }
+}
+
+void SharedDict::store_value(std::string_view key, const nb::object &value, LockWait wait)
+{
+    ScratchBuffer header(header_scratch());
+    nb::list buffers;
+    SerializedValue serialized = serialize_value(value, header.get(), buffers);
+    std::string terms;
+    index_terms(value, terms);
+    try
+    {
+        if (buffers.size() == 0)
+        {
+            // Header and payload are gathered straight into the shared memory value
+            run_locked(wait, [&](LockWait w)
+                       { shm_ptr_->set_parts(key, {serialized.header, serialized.payload}, w, terms); });
+        }
+        else
+        {
+            // Out-of-band values frame the pickle stream themselves
+            store_out_of_band(key, header.get(), serialized.payload, buffers, wait, terms);
+        }
+    }
+    catch (const MemoryPressure &)
+    {
+        notify_memory_pressure();
+        throw;
+    }
+}
+
+// Called before a MemoryPressure raised by a write of this dictionary propagates
+void SharedDict::notify_memory_pressure()
+{
+    if (on_memory_pressure_.is_valid() && !on_memory_pressure_.is_none())
+    {
+        on_memory_pressure_(nb::find(this));
+    }
+}
+
+void SharedDict::__delitem__(const Key &key)
+{
+    bool erased = run_locked(LockWait::forever(), [&](LockWait w)
+                             { return shm_ptr_->erase(key.bytes(), w); });
+    if (!erased)
+    {
+        raise_key_error(key.object());
+    }
+}
+
+// Count lock timeouts of caller-bounded operations for get_stats()
+template <class Fn>
+auto SharedDict::counting_timeouts(Fn &&fn) const -> decltype(fn())
+{
+    try
+    {
+        return fn();
+    }
+    catch (const LockTimeout &)
+    {
+        lock_timeouts_.fetch_add(1, std::memory_order_relaxed);
+        throw;
+    }
+}
+
+nb::object SharedDict::get(const Key &key, const nb::object &default_value,
+                           std::optional<double> timeout, bool nonblocking) const
+{
+    LockWait wait = lock_wait(timeout, nonblocking);
+    try
+    {
+        nb::object value;
+        if (counting_timeouts([&]
+                              { return load_value(key.bytes(), wait, value); }))
+        {
+            return value;
+        }
+        return default_value;
+    }
+    catch (const LockTimeout &)
+    {
+        throw;
+    }
+    catch (const std::exception &)
+    {
+        return default_value;
+    }
+}
+
+void SharedDict::set(const Key &key, const nb::object &value, std::optional<double> timeout,
+                     bool nonblocking)
+{
+    LockWait wait = lock_wait(timeout, nonblocking);
+    counting_timeouts([&]
+                      { store_value(key.bytes(), value, wait); });
+}
+
+bool SharedDict::erase(const Key &key, std::optional<double> timeout, bool nonblocking)
+{
+    LockWait wait = lock_wait(timeout, nonblocking);
+    return counting_timeouts([&]
+                             { return run_locked(wait, [&](LockWait w)
+                                                 { return shm_ptr_->erase(key.bytes(), w); }); });
+}
+
+// Local cache hits are served first; the other keys are read in one batch
+// that takes each stripe lock once, with the GIL released, and are decoded
+// once every lock is released
+nb::list SharedDict::lookup_many(const std::vector<Key> &keys, const nb::object &default_value,
+                                 LockWait wait) const
+{
+    const size_t count = keys.size();
+    std::vector<nb::object> values(count);
+    std::vector<size_t> misses;
+    std::vector<std::string_view> miss_keys;
+    std::vector<uint64_t> versions;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const std::string_view key = keys[i].bytes();
+        if (local_cache_size_ != 0)
+        {
+            if (cached_value(key, values[i]))
+            {
+                continue;
+            }
+            // Read before the value: a write in between leaves the entry with
+            // an older version, so it is read again on its next use
+            versions.push_back(shm_ptr_->stripe_version(key));
+        }
+        misses.push_back(i);
+        miss_keys.push_back(key);
+    }
+
+    std::vector<std::string> raw(misses.size());
+    std::vector<char> found(misses.size(), 0);
+    auto copy = [&](size_t j, std::string_view data)
+    {
+        raw[j].assign(data.data(), data.size());
+        found[j] = 1;
+    };
+    if (!miss_keys.empty())
+    {
+        nb::gil_scoped_release release;
+        shm_ptr_->get_many_with(miss_keys.data(), miss_keys.size(), copy, wait);
+    }
+
+    for (size_t j = 0; j < misses.size(); ++j)
+    {
+        if (!found[j])
+        {
+            if (local_cache_size_ != 0)
+            {
+                forget_local(miss_keys[j]);
+            }
+            continue;
+        }
+        CapturedValue captured;
+        capture_value(raw[j], captured);
+        values[misses[j]] = local_cache_size_ == 0 ? finish_value(captured)
+                                                   : admit_local(miss_keys[j], versions[j], captured);
+    }
+
+    nb::list result;
+    for (auto &value : values)
+    {
+        result.append(value.is_valid() ? value : default_value);
+    }
+    return result;
+}
+
+nb::list SharedDict::get_many(const std::vector<Key> &keys, const nb::object &default_value,
+                              std::optional<double> timeout, bool nonblocking) const
+{
+    // A timeout bounds the whole batch, not each key
+    LockWait wait = lock_wait(timeout, nonblocking);
+    return counting_timeouts([&]
+                             { return lookup_many(keys, default_value, wait); });
+}
+
+// Numeric output kinds of get_many_numpy(); each also accepts the stored
+// types that numpy casts to it safely (bool -> int64 -> float64)
+enum class NumericKind
+{
+    Bool,
+    Int64,
+    Float64
+};
+
+// Converts a stored value for get_many_numpy(); false if it is not a number
+// the output kind can hold. Runs under the stripe lock without the GIL
+static bool decode_numeric(std::string_view data, NumericKind kind, char *out)
+{
+    if (data.size() < 2)
+    {
+        return false;
+    }
+    const uint8_t marker = static_cast<uint8_t>(data[0]);
+    const char *payload = data.data() + 1;
+
+    if (marker == BOOL_MARKER)
+    {
+        const bool value = payload[0] != 0;
+        switch (kind)
+        {
+        case NumericKind::Bool:
+            *reinterpret_cast<bool *>(out) = value;
+            break;
+        case NumericKind::Int64:
+            *reinterpret_cast<int64_t *>(out) = value;
+            break;
+        case NumericKind::Float64:
+            *reinterpret_cast<double *>(out) = value;
+            break;
+        }
+        return true;
+    }
+    if ((marker != INT_MARKER && marker != FLOAT_MARKER) || data.size() != 1 + sizeof(uint64_t) ||
+        kind == NumericKind::Bool)
+    {
+        return false;
+    }
+    const uint64_t bits = read_le<uint64_t>(payload);
+    if (marker == INT_MARKER)
+    {
+        if (kind == NumericKind::Int64)
+        {
+            *reinterpret_cast<int64_t *>(out) = static_cast<int64_t>(bits);
+        }
+        else
+        {
+            *reinterpret_cast<double *>(out) = static_cast<double>(static_cast<int64_t>(bits));
+        }
+        return true;
+    }
+    if (kind != NumericKind::Float64)
+    {
+        return false;
+    }
+    std::memcpy(out, &bits, sizeof(double));
+    return true;
+}
+
+nb::tuple SharedDict::get_many_numpy(const IdArray &ids, const nb::object &dtype, std::optional<double> timeout,
+                                     bool nonblocking) const
+{
+    LockWait wait = lock_wait(timeout, nonblocking);
+
+    nb::object np = nb::module_::import_("numpy");
+    nb::object out_dtype = np.attr("dtype")(dtype);
+    const std::string kind_code = nb::cast<std::string>(out_dtype.attr("kind"));
+    const size_t itemsize = nb::cast<size_t>(out_dtype.attr("itemsize"));
+    NumericKind kind;
+    if (!nb::cast<bool>(out_dtype.attr("isnative")))
+    {
+        // Values are written in the machine's byte order
+        throw nb::type_error("get_many_numpy() requires a dtype in native byte order");
+    }
+    else if (kind_code == "b" && itemsize == sizeof(bool))
+    {
+        kind = NumericKind::Bool;
+    }
+    else if (kind_code == "i" && itemsize == sizeof(int64_t))
+    {
+        kind = NumericKind::Int64;
+    }
+    else if (kind_code == "f" && itemsize == sizeof(double))
+    {
+        kind = NumericKind::Float64;
+    }
+    else
+    {
+        throw nb::type_error("get_many_numpy() supports bool, int64 and float64 outputs");
+    }
+
+    const size_t count = ids.shape(0);
+    nb::object values = np.attr("zeros")(count, nb::arg("dtype") = out_dtype);
+    nb::object found = np.attr("zeros")(count, nb::arg("dtype") = "bool");
+    char *values_data = static_cast<char *>(nb::cast<nb::ndarray<>>(values).data());
+    bool *found_data = static_cast<bool *>(nb::cast<nb::ndarray<>>(found).data());
+
+    // Keys in their stored form, packed back to back
+    std::vector<char> packed(count * INT_KEY_SIZE);
+    std::vector<std::string_view> keys(count);
+    const int64_t *id_data = ids.data();
+    for (size_t i = 0; i < count; ++i)
+    {
+        pack_int_key(id_data[i], &packed[i * INT_KEY_SIZE]);
+        keys[i] = std::string_view(&packed[i * INT_KEY_SIZE], INT_KEY_SIZE);
+    }
+
+    // Results go straight into the output arrays, so the batch runs without
+    // the GIL and creates no Python object per key
+    size_t first_mismatch = count;
+    auto store = [&](size_t i, std::string_view data)
+    {
+        if (decode_numeric(data, kind, values_data + i * itemsize))
+        {
+            found_data[i] = true;
+        }
+        else if (i < first_mismatch)
+        {
+            first_mismatch = i;
+        }
+    };
+    {
+        nb::gil_scoped_release release;
+        counting_timeouts([&]
+                          { return shm_ptr_->get_many_with(keys.data(), count, store, wait); });
+    }
+    if (first_mismatch != count)
+    {
+        throw nb::type_error(("value of id " + std::to_string(id_data[first_mismatch]) +
+                              " is not a number that fits dtype " + nb::cast<std::string>(nb::str(out_dtype)))
+                                 .c_str());
+    }
+    return nb::make_tuple(values, found);
+}
+
+// Reductions of scan_reduce()
+enum class ScanOp
+{
+    Count,
+    Sum,
+    Min,
+    Max,
+    Mean,
+    Keys
+};
+
+static ScanOp parse_scan_op(const std::string &op)
+{
+    if (op == "count")
+        return ScanOp::Count;
+    if (op == "sum")
+        return ScanOp::Sum;
+    if (op == "min")
+        return ScanOp::Min;
+    if (op == "max")
+        return ScanOp::Max;
+    if (op == "mean")
+        return ScanOp::Mean;
+    if (op == "keys")
+        return ScanOp::Keys;
+    throw nb::value_error("op must be 'count', 'sum', 'min', 'max', 'mean' or 'keys'");
+}
+
+// The where= filter of scan_reduce(): numbers compared against a threshold
+struct ScanFilter
+{
+    enum class Comparison
+    {
+        Any,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+        Equal,
+        NotEqual
+    };
+
+    Comparison comparison = Comparison::Any;
+    double threshold = 0.0;
+
+    static ScanFilter parse(const std::string &comparison, double threshold)
+    {
+        static const std::pair<const char *, Comparison> names[] = {
+            {"<", Comparison::Less},     {"<=", Comparison::LessEqual}, {">", Comparison::Greater},
+            {">=", Comparison::GreaterEqual}, {"==", Comparison::Equal}, {"!=", Comparison::NotEqual}};
+        for (const auto &name : names)
+        {
+            if (comparison == name.first)
+                return ScanFilter{name.second, threshold};
+        }
+        throw nb::value_error("where must compare with '<', '<=', '>', '>=', '==' or '!='");
+    }
+
+    bool operator()(double x) const
+    {
+        switch (comparison)
+        {
+        case Comparison::Less:
+            return x < threshold;
+        case Comparison::LessEqual:
+            return x <= threshold;
+        case Comparison::Greater:
+            return x > threshold;
+        case Comparison::GreaterEqual:
+            return x >= threshold;
+        case Comparison::Equal:
+            return x == threshold;
+        case Comparison::NotEqual:
+            return x != threshold;
+        default:
+            return true;
+        }
+    }
+};
+
+// A signed 128-bit integer, enough to sum any number of int64 and uint64
+// values exactly; portable to compilers without __int128
+struct WideInt
+{
+    uint64_t lo = 0;
+    uint64_t hi = 0; // two's complement with lo
+
+    template <class T>
+    static WideInt of(T x)
+    {
+        const uint64_t bits = static_cast<uint64_t>(x);
+        return WideInt{bits, std::is_signed_v<T> && x < 0 ? ~uint64_t{0} : 0};
+    }
+
+    WideInt &operator+=(const WideInt &other)
+    {
+        lo += other.lo;
+        hi += other.hi + (lo < other.lo ? 1 : 0);
+        return *this;
+    }
+
+    bool operator<(const WideInt &other) const
+    {
+        if (hi != other.hi)
+            return static_cast<int64_t>(hi) < static_cast<int64_t>(other.hi);
+        return lo < other.lo;
+    }
+
+    double to_double() const
+    {
+        if (static_cast<int64_t>(hi) < 0)
+        {
+            // Converting the magnitude keeps small negative values exact
+            const WideInt magnitude{~lo + 1, ~hi + (lo == 0 ? 1 : 0)};
+            return -magnitude.to_double();
+        }
+        return static_cast<double>(hi) * 18446744073709551616.0 + static_cast<double>(lo);
+    }
+
+    nb::object to_python() const
+    {
+        nb::object high = checked(PyLong_FromLongLong(static_cast<int64_t>(hi)));
+        nb::object shift = checked(PyLong_FromLong(64));
+        nb::object low = checked(PyLong_FromUnsignedLongLong(lo));
+        nb::object shifted = checked(PyNumber_Lshift(high.ptr(), shift.ptr()));
+        return checked(PyNumber_Or(shifted.ptr(), low.ptr()));
+    }
+};
+
+// Running totals of one scanning thread, a cache line apart from the others.
+// Integers and floats are totalled apart, so integers stay exact and the
+// results are ints while no float was seen
+struct alignas(64) ScanTotals
+{
+    uint64_t count = 0;
+    uint64_t float_count = 0;
+    double float_sum = 0.0;
+    double float_min = std::numeric_limits<double>::infinity();
+    double float_max = -std::numeric_limits<double>::infinity();
+    WideInt int_sum;
+    WideInt int_min;
+    WideInt int_max;
+    std::vector<std::string> keys;
+
+    template <class T>
+    void add(T x)
+    {
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            ++float_count;
+            float_sum += x;
+            float_min = std::min<double>(float_min, x);
+            float_max = std::max<double>(float_max, x);
+        }
+        else
+        {
+            const WideInt wide = WideInt::of(x);
+            const bool first = count == float_count;
+            int_sum += wide;
+            if (first || wide < int_min)
+                int_min = wide;
+            if (first || int_max < wide)
+                int_max = wide;
+        }
+        ++count;
+    }
+
+    void merge(const ScanTotals &other)
+    {
+        const uint64_t other_ints = other.count - other.float_count;
+        if (other_ints != 0)
+        {
+            const bool first = count == float_count;
+            int_sum += other.int_sum;
+            if (first || other.int_min < int_min)
+                int_min = other.int_min;
+            if (first || int_max < other.int_max)
+                int_max = other.int_max;
+        }
+        count += other.count;
+        float_count += other.float_count;
+        float_sum += other.float_sum;
+        float_min = std::min(float_min, other.float_min);
+        float_max = std::max(float_max, other.float_max);
+    }
+
+    nb::object sum() const
+    {
+        if (float_count == 0)
+            return int_sum.to_python();
+        return nb::float_(float_sum + int_sum.to_double());
+    }
+
+    nb::object min() const
+    {
+        if (count == 0)
+            return nb::none();
+        if (float_count == 0)
+            return int_min.to_python();
+        return nb::float_(count != float_count ? std::min(float_min, int_min.to_double()) : float_min);
+    }
+
+    nb::object max() const
+    {
+        if (count == 0)
+            return nb::none();
+        if (float_count == 0)
+            return int_max.to_python();
+        return nb::float_(count != float_count ? std::max(float_max, int_max.to_double()) : float_max);
+    }
+
+    nb::object mean() const
+    {
+        if (count == 0)
+            return nb::none();
+        return nb::float_((float_sum + int_sum.to_double()) / static_cast<double>(count));
+    }
+};
+
+template <class T, class Fn>
+static void for_each_element(const char *data, size_t count, Fn &&fn)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        T x;
+        std::memcpy(&x, data + i * sizeof(T), sizeof(T));
+        fn(x);
+    }
+}
+
+// Calls fn(x) for each number a stored value holds: a bool, int or float, or
+// every element of a numpy array of bools, integers or float32/float64, with
+// x of the stored C++ type (bools as uint8_t).
+// Runs under the stripe lock without the GIL; false for other values
+template <class Fn>
+static bool for_each_number(std::string_view data, Fn &&fn)
+{
+    if (data.size() < 2)
+    {
+        return false;
+    }
+    const uint8_t marker = static_cast<uint8_t>(data[0]);
+    const char *ptr = data.data() + 1;
+    const char *end = data.data() + data.size();
+
+    if (marker == BOOL_MARKER)
+    {
+        fn(static_cast<uint8_t>(ptr[0] != 0 ? 1 : 0));
+        return true;
+    }
+    if (marker == INT_MARKER || marker == FLOAT_MARKER)
+    {
+        if (data.size() != 1 + sizeof(uint64_t))
+        {
+            return false;
+        }
+        const uint64_t bits = read_le<uint64_t>(ptr);
+        if (marker == INT_MARKER)
+        {
+            fn(static_cast<int64_t>(bits));
+        }
+        else
+        {
+            double x;
+            std::memcpy(&x, &bits, sizeof(x));
+            fn(x);
+        }
+        return true;
+    }
+    if (marker != NUMPY_MARKER)
+    {
+        return false;
+    }
+
+    // Layout of serialize_numpy(); the elements are visited in storage order
+    if (end - ptr < static_cast<ptrdiff_t>(sizeof(uint32_t) + 3))
+    {
+        return false;
+    }
+    if (read_le<uint32_t>(ptr) != 3)
+    {
+        return false; // complex and other dtypes with longer names
+    }
+    const char kind = ptr[1];
+    const char item_size = ptr[2];
+    ptr += 3;
+    if (end - ptr < static_cast<ptrdiff_t>(sizeof(uint32_t)))
+    {
+        return false;
+    }
+    const uint32_t ndim = read_le<uint32_t>(ptr);
+    if (ndim > NUMPY_MAX_DIMS || static_cast<size_t>(end - ptr) < (ndim + 1) * sizeof(uint64_t))
+    {
+        return false;
+    }
+    ptr += ndim * sizeof(uint64_t);
+    const uint64_t data_len = read_le<uint64_t>(ptr);
+    if (data_len > static_cast<uint64_t>(end - ptr))
+    {
+        return false;
+    }
+
+    const size_t bytes = static_cast<size_t>(data_len);
+    switch (kind)
+    {
+    case 'b':
+    case 'u':
+        switch (item_size)
+        {
+        case '1':
+            for_each_element<uint8_t>(ptr, bytes, fn);
+            return true;
+        case '2':
+            for_each_element<uint16_t>(ptr, bytes / 2, fn);
+            return true;
+        case '4':
+            for_each_element<uint32_t>(ptr, bytes / 4, fn);
+            return true;
+        case '8':
+            for_each_element<uint64_t>(ptr, bytes / 8, fn);
+            return true;
+        }
+        return false;
+    case 'i':
+        switch (item_size)
+        {
+        case '1':
+            for_each_element<int8_t>(ptr, bytes, fn);
+            return true;
+        case '2':
+            for_each_element<int16_t>(ptr, bytes / 2, fn);
+            return true;
+        case '4':
+            for_each_element<int32_t>(ptr, bytes / 4, fn);
+            return true;
+        case '8':
+            for_each_element<int64_t>(ptr, bytes / 8, fn);
+            return true;
+        }
+        return false;
+    case 'f':
+        switch (item_size)
+        {
+        case '4':
+            for_each_element<float>(ptr, bytes / 4, fn);
+            return true;
+        case '8':
+            for_each_element<double>(ptr, bytes / 8, fn);
+            return true;
+        }
+        return false; // float16
+    default:
+        return false;
+    }
+}
+
+// Each thread scans a share of the stripes into its own totals with the GIL
+// released; the totals are merged at the end. Values are never decoded into
+// Python objects, so pickled values are skipped rather than unpickled
+nb::object SharedDict::scan_reduce(const std::string &op, std::optional<std::tuple<std::string, double>> where,
+                                   size_t threads, std::optional<double> timeout, bool nonblocking) const
+{
+    const ScanOp scan_op = parse_scan_op(op);
+    const ScanFilter filter = where ? ScanFilter::parse(std::get<0>(*where), std::get<1>(*where)) : ScanFilter{};
+    LockWait wait = lock_wait(timeout, nonblocking);
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, max_keys_);
+
+    std::vector<ScanTotals> totals(threads);
+    auto visit = [&](size_t worker, std::string_view key, std::string_view value)
+    {
+        ScanTotals &t = totals[worker];
+        bool matched = false;
+        auto add = [&](auto x)
+        {
+            if (!filter(static_cast<double>(x)))
+                return;
+            matched = true;
+            if (scan_op != ScanOp::Keys)
+                t.add(x);
+        };
+        if (for_each_number(value, add) && matched && scan_op == ScanOp::Keys)
+        {
+            t.keys.emplace_back(key);
+        }
+    };
+    counting_timeouts([&]
+                      {
+                          nb::gil_scoped_release release;
+                          shm_ptr_->scan_with(visit, threads, wait); });
+
+    if (scan_op == ScanOp::Keys)
+    {
+        nb::list result;
+        for (const ScanTotals &t : totals)
+        {
+            for (const std::string &key : t.keys)
+            {
+                result.append(Key::decode(key));
+            }
+        }
+        return result;
+    }
+
+    ScanTotals merged;
+    for (const ScanTotals &t : totals)
+    {
+        merged.merge(t);
+    }
+    switch (scan_op)
+    {
+    case ScanOp::Count:
+        return nb::int_(merged.count);
+    case ScanOp::Sum:
+        return merged.sum();
+    case ScanOp::Min:
+        return merged.min();
+    case ScanOp::Max:
+        return merged.max();
+    default:
+        return merged.mean();
+    }
 }
 
-SharedDict::SharedDict(
-    const std::string &name,
-    nb::object data,
-    const size_t size,
-    const bool create,
-    const size_t max_keys) : name_(name),
-                             size_(size),
-                             created_(create),
-                             max_keys_(max_keys),
-                             shm_ptr_(nullptr)
-{
-    pickle_module_ = nb::module_::import_("pickle");
-
-    shm_ptr_ = new SharedMemoryDict(name_, size_, create, max_keys_);
+// The asyncio variants resolve immediately when the stripe lock is free and
+// otherwise run the blocking variant on the loop's default executor, whose
+// threads wait for the lock with the GIL released
 
-    if (!data.is_none())
-    {
-        initialize_data(data);
-    }
+static nb::object running_loop()
+{
+    return nb::module_::import_("asyncio").attr("get_running_loop")();
 }
 
-SharedDict::~SharedDict()
+static nb::object completed_future(const nb::object &loop, const nb::object &result)
 {
-    if (shm_ptr_ != nullptr)
-    {
-        // The C++ destructor will call close() if not already closed
-        delete shm_ptr_;
-        shm_ptr_ = nullptr;
-    }
+    nb::object future = loop.attr("create_future")();
+    future.attr("set_result")(result);
+    return future;
 }
 
-void SharedDict::close()
+nb::object SharedDict::aget(const Key &key, const nb::object &default_value) const
 {
-    if (shm_ptr_ != nullptr)
+    nb::object loop = running_loop();
+    try
     {
-        shm_ptr_->close();
+        nb::object value;
+        bool found = load_value(key.bytes(), LockWait::none(), value);
+        return completed_future(loop, found ? value : default_value);
+    }
+    catch (const LockTimeout &)
+    {
+        return loop.attr("run_in_executor")(nb::none(), nb::find(this).attr("get"), key.object(), default_value);
     }
 }
 
-void SharedDict::unlink()
+// The value is serialized (and out-of-band buffers copied) once, on the
+// loop; a busy stripe sends only the locked publish to the executor
+nb::object SharedDict::aset(const Key &key, const nb::object &value)
 {
-    if (shm_ptr_ != nullptr)
+    nb::object loop = running_loop();
+    auto pending = std::make_shared<PendingStore>();
+    pending->owner = nb::find(this);
+    pending->key = key.bytes();
+    pending->serialized = serialize_value(value, pending->header, pending->buffers);
+    index_terms(value, pending->terms);
+    try
     {
-        if (!shm_ptr_->is_closed())
+        try
+        {
+            if (pending->buffers.size() == 0)
+            {
+                shm_ptr_->set_parts(pending->key, {pending->serialized.header, pending->serialized.payload},
+                                    LockWait::none(), pending->terms);
+            }
+            else
+            {
+                pending->writer = write_out_of_band(pending->key, pending->header, pending->serialized.payload,
+                                                    pending->buffers, LockWait::none());
+                pending->writer->commit(LockWait::none(), pending->terms);
+            }
+            return completed_future(loop, nb::none());
+        }
+        catch (const LockTimeout &)
         {
-            throw std::runtime_error("Cannot unlink a SharedDict that is still open. Call close() first.");
         }
-        shm_ptr_->unlink();
     }
+    catch (const MemoryPressure &)
+    {
+        notify_memory_pressure();
+        throw;
+    }
+    // `pending` keeps this handle alive until the executor has run
+    nb::object publish = nb::cpp_function([this, pending]()
+                                          { finish_store(*pending); });
+    return loop.attr("run_in_executor")(nb::none(), publish);
 }
 
-bool SharedDict::is_closed() const
+// The executor side of aset(): waits for the stripe lock with the GIL released
+void SharedDict::finish_store(PendingStore &pending)
 {
-    if (shm_ptr_ == nullptr)
+    try
     {
-        return true;
+        if (pending.writer)
+        {
+            run_locked(LockWait::forever(), [&](LockWait w)
+                       { pending.writer->commit(w, pending.terms); });
+        }
+        else if (pending.buffers.size() != 0)
+        {
+            // The soft limit check gave up before anything was copied
+            store_out_of_band(pending.key, pending.header, pending.serialized.payload, pending.buffers,
+                              LockWait::forever(), pending.terms);
+        }
+        else
+        {
+            run_locked(LockWait::forever(), [&](LockWait w)
+                       { shm_ptr_->set_parts(pending.key, {pending.serialized.header, pending.serialized.payload},
+                                             w, pending.terms); });
+        }
+    }
+    catch (const MemoryPressure &)
+    {
+        notify_memory_pressure();
+        throw;
     }
-    return shm_ptr_->is_closed();
 }
 
-// Check if object is a numpy array (without importing numpy if not needed)
-bool SharedDict::is_numpy_array(const nb::object &obj) const
+nb::object SharedDict::aget_many(const std::vector<Key> &keys, const nb::object &default_value) const
 {
-    // Use nanobind's built-in check for ndarray
-    return nb::isinstance<nb::ndarray<>>(obj);
+    nb::object loop = running_loop();
+    try
+    {
+        return completed_future(loop, lookup_many(keys, default_value, LockWait::none()));
+    }
+    catch (const LockTimeout &)
+    {
+        // Any busy stripe sends the whole batch to the executor
+        return loop.attr("run_in_executor")(nb::none(), nb::find(this).attr("get_many"), nb::cast(keys),
+                                            default_value);
+    }
 }
 
-// Serialize value: use native C++ for numpy, pickle for everything else
-std::string SharedDict::serialize_value(const nb::object &obj) const
+SharedDictWriter *SharedDict::writer(const Key &key, size_t size_hint)
 {
-    if (is_numpy_array(obj))
+    try
     {
-        // Native numpy serialization
-        return serialize_numpy(nb::cast<nb::ndarray<>>(obj));
+        return new SharedDictWriter(*this, key.bytes(), size_hint);
     }
-    else
+    catch (const MemoryPressure &)
     {
-        // Use pickle for Python objects
-        std::string result;
-        result.push_back(PICKLE_MARKER);
-
-        // Call pickle.dumps with highest protocol
-        nb::object pickled = pickle_module_.attr("dumps")(
-            obj,
-            nb::arg("protocol") = pickle_module_.attr("HIGHEST_PROTOCOL"));
-        nb::bytes pickled_bytes = nb::cast<nb::bytes>(pickled);
+        notify_memory_pressure();
+        throw;
+    }
+}
 
-        // Append pickled data
-        const char *data = PyBytes_AsString(pickled_bytes.ptr());
-        Py_ssize_t size = PyBytes_Size(pickled_bytes.ptr());
-        result.append(data, size);
+SharedDictBatch *SharedDict::batch(size_t flush_entries, std::optional<double> flush_interval)
+{
+    return new SharedDictBatch(*this, flush_entries, flush_interval);
+}
 
-        return result;
-    }
+SharedDictWriter::SharedDictWriter(SharedDict &dict, std::string_view key, size_t size_hint)
+    : dict_(dict), writer_(*dict.shm_ptr_, key, size_hint + 1)
+{
+    const char marker = static_cast<char>(BYTES_MARKER);
+    writer_.write(&marker, 1);
 }
 
-// Deserialize value: check marker to determine format
-nb::object SharedDict::deserialize_value(const std::string &data) const
+size_t SharedDictWriter::write(const nb::handle &data)
 {
-    if (data.empty())
+    // Accept any contiguous buffer (bytes, bytearray, memoryview, numpy, ...)
+    Py_buffer view;
+    if (PyObject_GetBuffer(data.ptr(), &view, PyBUF_SIMPLE) != 0)
     {
-        throw std::runtime_error("Empty data cannot be deserialized");
+        throw nb::python_error();
     }
 
-    uint8_t marker = static_cast<uint8_t>(data[0]);
-
-    if (marker == NUMPY_MARKER)
+    const size_t size = static_cast<size_t>(view.len);
+    try
     {
-        // Native numpy deserialization
-        return deserialize_numpy(data.data() + 1, data.size() - 1);
+        // The copy into shared memory does not touch Python state
+        nb::gil_scoped_release release;
+        writer_.write(static_cast<const char *>(view.buf), size);
     }
-    else if (marker == PICKLE_MARKER)
+    catch (const MemoryPressure &)
     {
-        // Pickle deserialization (skip marker)
-        nb::bytes pickled_data = nb::bytes(data.data() + 1, data.size() - 1);
-        return pickle_module_.attr("loads")(pickled_data);
+        PyBuffer_Release(&view);
+        dict_.notify_memory_pressure();
+        throw;
     }
-    else
+    catch (...)
     {
-        // Legacy data without marker - assume pickle
-        nb::bytes pickled_data = nb::bytes(data.data(), data.size());
-        return pickle_module_.attr("loads")(pickled_data);
+        PyBuffer_Release(&view);
+        throw;
     }
+    PyBuffer_Release(&view);
+    return size;
 }
 
-// Native numpy serialization - direct memory access, no pickle
-std::string SharedDict::serialize_numpy(const nb::ndarray<> &arr) const
+void SharedDictWriter::close()
 {
-    std::string result;
-    result.reserve(1024); // Reserve some space upfront
-
-    // Write marker
-    result.push_back(NUMPY_MARKER);
-
-    // Get dtype information
-    nb::dlpack::dtype dtype = arr.dtype();
-    std::ostringstream dtype_stream;
-
-    // Format dtype string manually based on dlpack dtype
-    // Format: [<,>,|][type_code][itemsize]
-    char endian = '<'; // little-endian (most common)
-    char type_code;
-
-    nb::dlpack::dtype_code code_value = static_cast<nb::dlpack::dtype_code>(dtype.code);
-
-    switch (code_value)
+    if (writer_.is_open())
     {
-    case nb::dlpack::dtype_code::Int:
-        type_code = 'i';
-        break;
-    case nb::dlpack::dtype_code::UInt:
-        type_code = 'u';
-        break;
-    case nb::dlpack::dtype_code::Float:
-        type_code = 'f';
-        break;
-    case nb::dlpack::dtype_code::Complex:
-        type_code = 'c';
-        break;
-    case nb::dlpack::dtype_code::Bool:
-        type_code = 'b';
-        break;
-    default:
-        throw std::runtime_error("Unsupported numpy dtype");
+        try
+        {
+            run_locked(LockWait::forever(), [&](LockWait w)
+                       { writer_.commit(w); });
+        }
+        catch (const MemoryPressure &)
+        {
+            dict_.notify_memory_pressure();
+            throw;
+        }
     }
+}
 
-    // Build dtype string (e.g., "<f8" for little-endian float64)
-    dtype_stream << endian << type_code << (dtype.bits / 8);
-    std::string dtype_str = dtype_stream.str();
+void SharedDictWriter::discard()
+{
+    writer_.discard();
+}
 
-    // Write dtype length and dtype string
-    write_le<uint32_t>(result, static_cast<uint32_t>(dtype_str.size()));
-    result.append(dtype_str);
+size_t SharedDictWriter::bytes_written() const
+{
+    // Exclude the marker byte
+    return writer_.is_open() ? writer_.size() - 1 : 0;
+}
 
-    // Write ndim
-    write_le<uint32_t>(result, static_cast<uint32_t>(arr.ndim()));
+bool SharedDictWriter::closed() const
+{
+    return !writer_.is_open();
+}
 
-    // Write shape
-    for (size_t i = 0; i < arr.ndim(); ++i)
+bool SharedDictWriter::__exit__(const nb::handle &exc_type, const nb::handle &, const nb::handle &)
+{
+    if (exc_type.is_none())
     {
-        write_le<uint64_t>(result, static_cast<uint64_t>(arr.shape(i)));
+        close();
     }
-
-    // Write data length
-    size_t data_len = arr.nbytes();
-    write_le<uint64_t>(result, static_cast<uint64_t>(data_len));
-
-    // Write array data (direct memory copy)
-    const char *data_ptr = static_cast<const char *>(arr.data());
-    result.append(data_ptr, data_len);
-
-    return result;
+    else
+    {
+        discard();
+    }
+    return false; // never swallow the exception
 }
 
-// Native numpy deserialization - reconstruct from raw bytes
-nb::object SharedDict::deserialize_numpy(const char *data, size_t size) const
+SharedDictBatch::SharedDictBatch(SharedDict &dict, size_t flush_entries, std::optional<double> flush_interval)
+    : dict_(dict), flush_entries_(flush_entries)
 {
-    const char *ptr = data;
-
-    // Read dtype length and string
-    uint32_t dtype_len = read_le<uint32_t>(ptr);
-    std::string dtype_str(ptr, dtype_len);
-    ptr += dtype_len;
-
-    // Read ndim
-    uint32_t ndim = read_le<uint32_t>(ptr);
-
-    // Read shape
-    std::vector<size_t> shape(ndim);
-    for (uint32_t i = 0; i < ndim; ++i)
+    if (flush_entries == 0)
     {
-        shape[i] = static_cast<size_t>(read_le<uint64_t>(ptr));
+        throw nb::value_error("flush_entries must be at least 1");
     }
-
-    // Read data length
-    uint64_t data_len = read_le<uint64_t>(ptr);
-
-    // Get pointer to array data
-    const void *array_data = ptr;
-
-    // Import numpy module
-    nb::object np = nb::module_::import_("numpy");
-
-    // Create numpy array from buffer
-    // Use frombuffer + reshape for proper numpy array
-    nb::bytes data_bytes = nb::bytes(static_cast<const char *>(array_data), data_len);
-    nb::object arr = np.attr("frombuffer")(data_bytes, nb::arg("dtype") = dtype_str);
-
-    // Need to reshape if multi-dimensional
-    if (ndim > 1)
+    if (flush_interval)
     {
-        nb::tuple shape_tuple = nb::make_tuple();
-        for (size_t s : shape)
+        if (*flush_interval < 0)
         {
-            shape_tuple = nb::tuple(nb::tuple(shape_tuple) + nb::make_tuple(s));
+            throw nb::value_error("flush_interval must be non-negative");
         }
-        arr = arr.attr("reshape")(shape_tuple);
+        flush_interval_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(*flush_interval));
     }
-
-    // Return a copy to ensure proper memory ownership
-    return np.attr("array")(arr, nb::arg("copy") = true);
 }
 
-void SharedDict::initialize_data(const nb::object &data)
+SharedDictBatch::~SharedDictBatch()
 {
-    if (!nb::isinstance<nb::dict>(data))
+    // Like a buffered file, a batch that is dropped writes what it still holds.
+    // If that fails the updates not yet applied are lost, and the error goes
+    // to sys.unraisablehook like one raised in __del__
+    try
     {
-        throw nb::type_error("Argument 'data' has incorrect type (expected dict)");
+        flush();
     }
+    catch (...)
+    {
+        set_python_error(std::current_exception());
+#if PY_VERSION_HEX >= 0x030D0000
+        PyErr_FormatUnraisable("Exception ignored while flushing a dropped SharedDictBatch; its updates are lost");
+#else
+        PyErr_WriteUnraisable(nb::find(&dict_).ptr());
+#endif
+    }
+}
 
-    nb::dict data_dict = nb::cast<nb::dict>(data);
-    int initialized_count = 0;
-
-    // Track if we had a type error to re-throw it
-    bool had_type_error = false;
-    std::string type_error_msg;
-
-    try
+void SharedDictBatch::__setitem__(const Key &key, const nb::object &value)
+{
+    ScratchBuffer header(header_scratch());
+    nb::list buffers;
+    SerializedValue serialized = dict_.serialize_value(value, header.get(), buffers);
+    std::string terms;
+    dict_.index_terms(value, terms);
+    if (buffers.size() != 0)
     {
-        for (auto item : data_dict)
+        // Out-of-band pickles are stored directly, after the updates before them
+        flush();
+        try
         {
-            nb::handle key_handle = item.first;
-            nb::handle value_handle = item.second;
-
-            if (!nb::isinstance<nb::str>(key_handle))
-            {
-                had_type_error = true;
-                type_error_msg = "All keys must be strings";
-                throw std::runtime_error(type_error_msg);
-            }
-
-            std::string key = nb::cast<std::string>(key_handle);
-            nb::object value = nb::cast<nb::object>(value_handle);
-
-            __setitem__(key, value);
-            initialized_count++;
+            dict_.store_out_of_band(key.bytes(), header.get(), serialized.payload, buffers, LockWait::forever(),
+                                    terms);
         }
-    }
-    catch (const std::exception &e)
-    {
-        // Check if it was a type error
-        if (had_type_error)
+        catch (const MemoryPressure &)
         {
-            throw nb::type_error(type_error_msg.c_str());
+            dict_.notify_memory_pressure();
+            throw;
         }
+        return;
+    }
+    if (add(key.bytes(), serialized.header, serialized.payload, terms, false))
+    {
+        flush();
+    }
+}
 
-        // Wrap other exceptions in ValueError
-        std::string error_msg = "Failed to initialize SharedDict after " +
-                                std::to_string(initialized_count) + " items: " + e.what();
-        throw nb::value_error(error_msg.c_str());
+void SharedDictBatch::__delitem__(const Key &key)
+{
+    // Whether the key exists is only known when the batch is applied, so a
+    // missing key is ignored rather than raising KeyError
+    if (add(key.bytes(), {}, {}, {}, true))
+    {
+        flush();
     }
 }
 
-size_t SharedDict::__len__() const
+bool SharedDictBatch::add(std::string_view key, std::string_view header, std::string_view payload,
+                          std::string_view terms, bool erase)
 {
-    return shm_ptr_->size();
+    nb::ft_lock_guard guard(mutex_);
+    Pending &p = pending_;
+    if (p.updates.empty())
+    {
+        first_update_ = std::chrono::steady_clock::now();
+    }
+
+    // A later update of a key replaces the earlier one and reuses its key bytes
+    auto slot = p.slots.try_emplace(std::string(key), p.updates.size());
+    if (slot.second)
+    {
+        p.updates.push_back({p.arena.size(), key.size(), 0, 0, 0, false});
+        p.arena.append(key);
+    }
+    Update &update = p.updates[slot.first->second];
+    update.value_offset = p.arena.size();
+    update.value_size = header.size() + payload.size();
+    update.terms_size = terms.size();
+    update.erase = erase;
+    p.arena.append(header);
+    p.arena.append(payload);
+    p.arena.append(terms);
+
+    return p.updates.size() >= flush_entries_ || p.arena.size() >= BATCH_FLUSH_BYTES ||
+           (flush_interval_ && std::chrono::steady_clock::now() - first_update_ >= *flush_interval_);
+}
+
+size_t SharedDictBatch::__len__() const
+{
+    nb::ft_lock_guard guard(mutex_);
+    return pending_.updates.size();
 }
 
-bool SharedDict::__contains__(const std::string &key) const
+size_t SharedDictBatch::flush()
 {
-    return shm_ptr_->contains(key);
+    // The updates are taken out of the batch before they are applied, so other
+    // threads can keep buffering while this one waits for stripe locks. A
+    // flush already applying holds flush_mutex_ with the GIL released, so it
+    // is waited for without the GIL
+    std::unique_lock<std::mutex> flushing(flush_mutex_, std::try_to_lock);
+    if (!flushing.owns_lock())
+    {
+        nb::gil_scoped_release release;
+        flushing.lock();
+    }
+    Pending pending;
+    {
+        nb::ft_lock_guard guard(mutex_);
+        std::swap(pending, pending_);
+    }
+    try
+    {
+        apply(pending);
+    }
+    catch (const MemoryPressure &)
+    {
+        // The callback may use this batch, so it runs once the flush is over
+        flushing.unlock();
+        dict_.notify_memory_pressure();
+        throw;
+    }
+    return pending.updates.size();
 }
 
-nb::object SharedDict::__getitem__(const std::string &key) const
+void SharedDictBatch::apply(const Pending &pending)
 {
-    std::string value_data;
-    if (!shm_ptr_->get(key, value_data))
+    if (pending.updates.empty())
+        return;
+
+    std::vector<std::string_view> stored, erased, terms;
+    std::vector<const Update *> values;
+    values.reserve(pending.updates.size());
+    for (const Update &update : pending.updates)
+    {
+        std::string_view key(pending.arena.data() + update.key_offset, update.key_size);
+        if (update.erase)
+        {
+            erased.push_back(key);
+        }
+        else
+        {
+            stored.push_back(key);
+            values.push_back(&update);
+            terms.emplace_back(pending.arena.data() + update.value_offset + update.value_size, update.terms_size);
+        }
+    }
+
+    nb::gil_scoped_release release;
+    SharedMemoryDict &shm = *dict_.shm_ptr_;
+    if (!stored.empty())
+    {
+        shm.set_many_with(stored.data(), stored.size(),
+                          [&](size_t i, ByteVec &value)
+                          {
+                              const char *data = pending.arena.data() + values[i]->value_offset;
+                              value.assign(data, data + values[i]->value_size);
+                          },
+                          1, LockWait::forever(), terms.data());
+    }
+    if (!erased.empty())
     {
-        throw nb::key_error(key.c_str());
+        shm.erase_many(erased.data(), erased.size());
     }
-    return deserialize_value(value_data);
 }
 
-void SharedDict::__setitem__(const std::string &key, const nb::object &value)
+void SharedDictBatch::discard()
 {
-    std::string value_data = serialize_value(value);
-    shm_ptr_->set(key, value_data);
+    Pending dropped;
+    nb::ft_lock_guard guard(mutex_);
+    std::swap(dropped, pending_);
 }
 
-void SharedDict::__delitem__(const std::string &key)
+bool SharedDictBatch::__exit__(const nb::handle &exc_type, const nb::handle &, const nb::handle &)
 {
-    if (!shm_ptr_->erase(key))
+    if (exc_type.is_none())
     {
-        throw nb::key_error(key.c_str());
+        flush();
     }
+    else
+    {
+        discard();
+    }
+    return false; // never swallow the exception
 }
 
-nb::object SharedDict::get(const std::string &key, const nb::object &default_value) const
+// Copy all keys out; this takes every stripe lock, so wait with the GIL released
+std::vector<std::string> SharedDict::snapshot_keys(LockWait wait) const
 {
-    try
+    if (!wait.may_block())
     {
-        return __getitem__(key);
+        return shm_ptr_->keys(wait);
     }
-    catch (const std::exception &)
+    nb::gil_scoped_release release;
+    return shm_ptr_->keys(wait);
+}
+
+nb::list SharedDict::keys(std::optional<double> timeout, bool nonblocking) const
+{
+    LockWait wait = lock_wait(timeout, nonblocking);
+    std::vector<std::string> key_vec = counting_timeouts([&]
+                                                         { return snapshot_keys(wait); });
+    nb::list result;
+    for (const auto &key : key_vec)
     {
-        return default_value;
+        result.append(Key::decode(key));
     }
+    return result;
 }
 
-nb::list SharedDict::keys() const
+nb::list SharedDict::find_by(const std::string &field, const Key &value, std::optional<double> timeout,
+                             bool nonblocking) const
 {
-    std::vector<std::string> key_vec = shm_ptr_->keys();
+    LockWait wait = lock_wait(timeout, nonblocking);
+    auto lookup = [&]() -> std::vector<std::string>
+    {
+        // Takes every stripe lock in turn, so wait with the GIL released
+        if (!wait.may_block())
+            return shm_ptr_->find_by(field, value.bytes(), wait);
+        nb::gil_scoped_release release;
+        return shm_ptr_->find_by(field, value.bytes(), wait);
+    };
+    std::vector<std::string> key_vec = counting_timeouts(lookup);
     nb::list result;
     for (const auto &key : key_vec)
     {
-        result.append(key);
+        result.append(Key::decode(key));
     }
     return result;
 }
@@ -379,9 +2506,14 @@ nb::list SharedDict::keys() const
 nb::list SharedDict::values() const
 {
     nb::list result;
-    for (const auto &key : shm_ptr_->keys())
+    for (const auto &key : snapshot_keys())
     {
-        result.append(__getitem__(key));
+        nb::object value;
+        if (!load_value(key, LockWait::forever(), value))
+        {
+            raise_key_error(Key::decode(key));
+        }
+        result.append(value);
     }
     return result;
 }
@@ -389,20 +2521,31 @@ nb::list SharedDict::values() const
 nb::list SharedDict::items() const
 {
     nb::list result;
-    for (const auto &key : shm_ptr_->keys())
+    for (const auto &key : snapshot_keys())
     {
-        nb::tuple item = nb::make_tuple(key, __getitem__(key));
-        result.append(item);
+        nb::object value;
+        if (!load_value(key, LockWait::forever(), value))
+        {
+            raise_key_error(Key::decode(key));
+        }
+        result.append(nb::make_tuple(Key::decode(key), value));
     }
     return result;
 }
 
+size_t SharedDict::compact()
+{
+    // Takes the stripe locks one by one; other threads keep running meanwhile
+    nb::gil_scoped_release release;
+    return shm_ptr_->compact();
+}
+
 nb::dict SharedDict::get_stats() const
 {
     nb::dict stats;
 
     // Get sample of keys
-    std::vector<std::string> all_keys = shm_ptr_->keys();
+    std::vector<std::string> all_keys = snapshot_keys();
     size_t sample_size = std::min(all_keys.size(), size_t(100));
 
     size_t total_key_bytes = 0;
@@ -414,7 +2557,8 @@ nb::dict SharedDict::get_stats() const
         total_key_bytes += key.size();
 
         std::string value_data;
-        if (shm_ptr_->get(key, value_data))
+        if (run_locked(LockWait::forever(), [&](LockWait w)
+                       { return shm_ptr_->peek(key, value_data, w); }))
         {
             total_value_bytes += value_data.size();
         }
@@ -429,6 +2573,41 @@ nb::dict SharedDict::get_stats() const
     stats["avg_value_pickle_bytes"] = avg_value_bytes;
     stats["estimated_data_bytes"] = static_cast<int>(shm_ptr_->size() * (avg_key_bytes + avg_value_bytes));
     stats["segment_name"] = name_;
+    stats["lock_timeouts"] = lock_timeouts_.load(std::memory_order_relaxed);
+
+    MemoryUsage usage = shm_ptr_->memory_usage();
+    stats["segment_bytes"] = usage.total_bytes;
+    stats["high_water_bytes"] = usage.high_water_bytes;
+    stats["soft_limit_evictions"] = usage.soft_limit_evictions;
+    stats["soft_limit_rejections"] = usage.soft_limit_rejections;
+    stats["free_bytes"] = usage.free_bytes;
+
+    BloomStats bloom = shm_ptr_->bloom_stats();
+    stats["bloom_filter_bits"] = bloom.bits;
+    stats["bloom_fill_ratio"] = bloom.fill_ratio();
+    stats["bloom_false_positive_rate"] = bloom.false_positive_rate();
+    CacheStats cache = shm_ptr_->cache_stats();
+    stats["eviction_policy"] = eviction_policy_name(cache.policy);
+    stats["max_entries"] = cache.max_entries;
+    stats["hits"] = cache.hits;
+    stats["misses"] = cache.misses;
+    stats["hit_rate"] = cache.hit_rate();
+    stats["evictions"] = cache.evictions;
+    stats["admissions_rejected"] = cache.rejections;
+    nb::list indexes;
+    for (const nb::object &field : index_names_)
+    {
+        indexes.append(field);
+    }
+    stats["indexes"] = indexes;
+    size_t local_cache_entries;
+    {
+        nb::ft_lock_guard guard(local_cache_mutex_);
+        local_cache_entries = local_cache_.size();
+    }
+    stats["local_cache_entries"] = local_cache_entries;
+    stats["local_cache_hits"] = local_cache_hits_.load(std::memory_order_relaxed);
+    stats["local_cache_misses"] = local_cache_misses_.load(std::memory_order_relaxed);
 
     return stats;
 }
@@ -500,14 +2679,68 @@ NB_MODULE(_shareddict, m)
 {
     m.doc() = "Native shared memory dictionary implementation using nanobind";
 
+    lock_timeout_type = nb::exception<LockTimeout>(m, "LockTimeout", PyExc_TimeoutError).ptr();
+    memory_pressure_type = nb::exception<MemoryPressure>(m, "MemoryPressure", PyExc_MemoryError).ptr();
+
+    nb::class_<SharedDictWriter>(m, "SharedDictWriter")
+        .def("write", &SharedDictWriter::write,
+             nb::arg("data"),
+             "Append a bytes-like chunk to the pending value; returns the number of bytes written")
+        .def("close", &SharedDictWriter::close,
+             "Publish the value atomically under its key")
+        .def("discard", &SharedDictWriter::discard,
+             "Drop the pending value without publishing it")
+        .def_prop_ro("bytes_written", &SharedDictWriter::bytes_written,
+                     "Number of bytes written so far")
+        .def_prop_ro("closed", &SharedDictWriter::closed,
+                     "Whether the value has been published or discarded")
+        .def("__enter__", [](nb::handle self)
+             { return nb::borrow(self); })
+        .def("__exit__", &SharedDictWriter::__exit__,
+             nb::arg("exc_type").none(),
+             nb::arg("exc_value").none(),
+             nb::arg("traceback").none());
+
+    nb::class_<SharedDictBatch>(m, "SharedDictBatch")
+        .def("__setitem__", &SharedDictBatch::__setitem__,
+             nb::arg("key"),
+             nb::arg("value"),
+             "Buffer an update of the key; values are encoded right away")
+        .def("__delitem__", &SharedDictBatch::__delitem__,
+             nb::arg("key"),
+             "Buffer the removal of the key; a key that does not exist is ignored")
+        .def("__len__", &SharedDictBatch::__len__,
+             "Number of keys with buffered updates")
+        .def("flush", &SharedDictBatch::flush,
+             "Apply the buffered updates, locking each stripe once; returns how many were applied")
+        .def("discard", &SharedDictBatch::discard,
+             "Drop the buffered updates without applying them")
+        .def("__enter__", [](nb::handle self)
+             { return nb::borrow(self); })
+        .def("__exit__", &SharedDictBatch::__exit__,
+             nb::arg("exc_type").none(),
+             nb::arg("exc_value").none(),
+             nb::arg("traceback").none());
+
     nb::class_<SharedDict>(m, "SharedDict")
-        .def(nb::init<const std::string &, nb::object, size_t, bool, size_t>(),
+        .def(nb::init<const std::string &, nb::object, size_t, bool, size_t, size_t, size_t, size_t,
+                      const std::string &, double, nb::object, const std::vector<std::string> &>(),
              nb::arg("name"),
              nb::arg("data") = nb::none(),
              nb::arg("size") = DEFAULT_SIZE,
              nb::arg("create") = true,
              nb::arg("max_keys") = DEFAULT_MAX_KEYS,
+             nb::arg("local_cache_size") = 0,
+             nb::arg("bloom_capacity") = 0,
+             nb::arg("max_entries") = 0,
+             nb::arg("eviction_policy") = "lru",
+             nb::arg("high_water_mark") = 0.0,
+             nb::arg("on_memory_pressure") = nb::none(),
+             nb::arg("indexes") = std::vector<std::string>(),
              "Create or open a shared memory dictionary")
+        .def("__getstate__", &SharedDict::__getstate__)
+        .def("__setstate__", [](SharedDict &self, const std::tuple<std::string, uint64_t, size_t> &state)
+             { new (&self) SharedDict(std::get<0>(state), std::get<1>(state), std::get<2>(state)); })
         .def("close", &SharedDict::close,
              "Close access to shared memory without removing it")
         .def("unlink", &SharedDict::unlink,
@@ -521,13 +2754,98 @@ NB_MODULE(_shareddict, m)
         .def("__delitem__", &SharedDict::__delitem__)
         .def("get", &SharedDict::get,
              nb::arg("key"),
-             nb::arg("default") = nb::none())
+             nb::arg("default") = nb::none(),
+             nb::kw_only(),
+             nb::arg("timeout") = nb::none(),
+             nb::arg("nonblocking") = false,
+             "Return the value for key, or default if it is missing; raises LockTimeout "
+             "if the key's lock is not acquired within timeout seconds (or at once if nonblocking)")
+        .def("set", &SharedDict::set,
+             nb::arg("key"),
+             nb::arg("value"),
+             nb::kw_only(),
+             nb::arg("timeout") = nb::none(),
+             nb::arg("nonblocking") = false,
+             "Store value under key; raises LockTimeout like get()")
+        .def("erase", &SharedDict::erase,
+             nb::arg("key"),
+             nb::kw_only(),
+             nb::arg("timeout") = nb::none(),
+             nb::arg("nonblocking") = false,
+             "Remove key and return whether it was present; raises LockTimeout like get()")
+        .def("get_many", &SharedDict::get_many,
+             nb::arg("keys"),
+             nb::arg("default") = nb::none(),
+             nb::kw_only(),
+             nb::arg("timeout") = nb::none(),
+             nb::arg("nonblocking") = false,
+             "Return a list with the value of each key, or default for missing keys; "
+             "timeout bounds the whole batch")
+        .def("get_many_numpy", &SharedDict::get_many_numpy,
+             nb::arg("ids"),
+             nb::arg("dtype") = "float64",
+             nb::kw_only(),
+             nb::arg("timeout") = nb::none(),
+             nb::arg("nonblocking") = false,
+             "Look up an int64 array of int keys holding numbers; returns (values, found) arrays, "
+             "with values of the given bool, int64 or float64 dtype in native byte order and 0 where "
+             "found is False")
+        .def("aget", &SharedDict::aget,
+             nb::arg("key"),
+             nb::arg("default") = nb::none(),
+             "Awaitable get(); waits for a busy stripe lock off the event loop")
+        .def("aset", &SharedDict::aset,
+             nb::arg("key"),
+             nb::arg("value"),
+             "Awaitable __setitem__(); waits for a busy stripe lock off the event loop")
+        .def("aget_many", &SharedDict::aget_many,
+             nb::arg("keys"),
+             nb::arg("default") = nb::none(),
+             "Awaitable get_many(); waits for busy stripe locks off the event loop")
+        .def("writer", &SharedDict::writer,
+             nb::arg("key"),
+             nb::arg("size_hint") = 0,
+             nb::keep_alive<0, 1>(),
+             "Stream a bytes value into shared memory; it is published when the writer is closed")
+        .def("batch", &SharedDict::batch,
+             nb::arg("flush_entries") = DEFAULT_BATCH_ENTRIES,
+             nb::arg("flush_interval") = nb::none(),
+             nb::keep_alive<0, 1>(),
+             "Buffer updates and apply them grouped by stripe, once flush_entries keys are pending or at the "
+             "first update made flush_interval seconds after the oldest pending one; there is no background "
+             "thread, so an idle batch is only applied by flush() or on exit")
         .def("keys", &SharedDict::keys,
-             "Return list of all keys")
+             nb::kw_only(),
+             nb::arg("timeout") = nb::none(),
+             nb::arg("nonblocking") = false,
+             "Return list of all keys; raises LockTimeout like get()")
         .def("values", &SharedDict::values,
              "Return list of all values")
         .def("items", &SharedDict::items,
              "Return list of (key, value) tuples")
+        .def("scan_reduce", &SharedDict::scan_reduce,
+             nb::arg("op"),
+             nb::kw_only(),
+             nb::arg("where").none() = nb::none(),
+             nb::arg("threads") = 0,
+             nb::arg("timeout") = nb::none(),
+             nb::arg("nonblocking") = false,
+             "Reduce every number held by bool, int, float and numeric numpy values ('count', 'sum', 'min', "
+             "'max', 'mean'), or list the keys of values holding a number that passes where=(comparison, "
+             "threshold) ('keys'); stripes are scanned on threads (one per CPU by default) without the GIL. "
+             "Sums, minima and maxima of integers alone are exact ints; timeout bounds the whole scan")
+        .def("find_by", &SharedDict::find_by,
+             nb::arg("field"),
+             nb::arg("value"),
+             nb::kw_only(),
+             nb::arg("timeout") = nb::none(),
+             nb::arg("nonblocking") = false,
+             "Return the keys of dict values whose indexed field equals value, without reading any value; "
+             "raises LockTimeout like get()")
+        .def("compact", &SharedDict::compact,
+             "Rebuild each lock stripe from fresh allocations to reduce fragmentation; "
+             "returns the number of entries relocated. Stripes are copied a chunk at a time under their lock, "
+             "and a stripe written during every attempt is skipped")
         .def("get_stats", &SharedDict::get_stats,
              "Get runtime statistics and diagnostic information")
         .def("recommend_sizing", &SharedDict::recommend_sizing,
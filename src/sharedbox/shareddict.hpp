@@ -2,24 +2,75 @@
 
 #include <nanobind/nanobind.h>
 #include <nanobind/ndarray.h>
+#include <nanobind/stl/optional.h>
 #include <nanobind/stl/string.h>
+#include <nanobind/stl/tuple.h>
 #include <nanobind/stl/vector.h>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 #include "_core/sharedmemory.hpp"
+#include "_core/value_format.hpp"
 
 namespace nb = nanobind;
 using namespace shared_memory;
 
 constexpr size_t DEFAULT_SIZE = 128 * 1024 * 1024; // 128 MB
 constexpr size_t DEFAULT_MAX_KEYS = 128;           // Default max keys if not specified
-constexpr uint8_t PICKLE_MARKER = 0x00;            // Marker byte for pickle-serialized data
-constexpr uint8_t NUMPY_MARKER = 0x01;             // Marker byte for numpy-serialized data
+constexpr size_t SCRATCH_RETAIN_BYTES = 64 * 1024; // Largest scratch buffer kept alive per thread
+constexpr size_t INIT_BATCH_ENTRIES = 65536;        // Entries serialized per batch by initial data loading
+constexpr size_t INIT_ENTRIES_PER_THREAD = 4096;    // Smallest share of a batch worth another loading thread
+constexpr size_t DEFAULT_BATCH_ENTRIES = 1024;      // Updates SharedDict.batch() buffers before flushing
+constexpr size_t BATCH_FLUSH_BYTES = 4 * 1024 * 1024; // Buffered key and value bytes that also force a flush
+
+// A dictionary key in its stored form (see docs/format.md). str keys are
+// their UTF-8 bytes, borrowed from the str object; int keys are packed into a
+// fixed INT_KEY_SIZE-byte tagged form, so they are neither formatted into
+// strings nor hashed byte by byte; bytes-like keys are their tag followed by
+// the buffer contents, assembled on the stack unless they are unusually long
+class Key
+{
+public:
+    // False for unsupported types and ints outside the int64 range; never raises
+    static bool from_python(nb::handle obj, Key &out) noexcept;
+    // The Python key a stored key was made from
+    static nb::object decode(std::string_view stored);
+
+    std::string_view bytes() const
+    {
+        if (packed_size_ != 0)
+            return std::string_view(packed_, packed_size_);
+        return spilled_ ? std::string_view(spill_) : view_;
+    }
+    const nb::object &object() const { return object_; }
+
+private:
+    static constexpr size_t INLINE_BYTES = 64; // room for a tagged SHA-512 digest
+
+    // Tag followed by data, inline when it fits; false if the spill cannot be allocated
+    bool pack(uint8_t tag, const char *data, size_t size) noexcept;
+
+    nb::object object_;
+    std::string_view view_;
+    std::string spill_; // packed keys longer than INLINE_BYTES
+    bool spilled_ = false;
+    char packed_[INLINE_BYTES] = {};
+    uint8_t packed_size_ = 0;
+};
 
 // Native numpy array header for efficient serialization
-// Layout: [marker(1)] [dtype_len(4)] [ndim(4)] [shape[0]..shape[n](8*n)] [data_len(8)] [data]
+// Layout: [marker(1)] [dtype_len(4)] [dtype(dtype_len)] [ndim(4)] [shape[0]..shape[n](8*n)] [data_len(8)] [data]
 struct NumpyHeader
 {
     uint32_t dtype_len;
@@ -29,6 +80,126 @@ struct NumpyHeader
     std::string dtype_str;
 };
 
+// A value ready to be stored: an encoding header followed by a payload that is
+// borrowed from a live Python object, so the two never have to be concatenated
+struct SerializedValue
+{
+    std::string_view header;
+    std::string_view payload;
+    nb::object payload_owner; // keeps the payload alive until it has been stored
+};
+
+// A value copied out of shared memory while its stripe lock was held. Native
+// encodings are already decoded into `object`; otherwise `object` holds the
+// private copy that finish_value() decodes once the lock has been released
+struct CapturedValue
+{
+    uint8_t marker = PICKLE_MARKER;
+    bool decoded = false;
+    nb::object object;
+
+    // Numpy header, parsed while the value was locked
+    char dtype[16] = {};
+    uint32_t ndim = 0;
+    uint64_t shape[NUMPY_MAX_DIMS] = {};
+};
+
+// Pickle protocol 5 value with out-of-band buffers
+// Layout: [marker(1)] [nbuf(4)] [stream_len(8)] [buf_len[0]..buf_len[n](8*n)] [stream]
+//         then each buffer, starting at an OOB_ALIGNMENT boundary from the value start
+
+class SharedDict;
+
+// Streams a bytes value straight into shared memory; returned by SharedDict.writer()
+class SharedDictWriter
+{
+public:
+    SharedDictWriter(SharedDict &dict, std::string_view key, size_t size_hint);
+
+    size_t write(const nb::handle &data);
+    void close();
+    void discard();
+    size_t bytes_written() const;
+    bool closed() const;
+
+    // Context manager support: commit on success, discard on exception
+    bool __exit__(const nb::handle &exc_type, const nb::handle &exc_value, const nb::handle &traceback);
+
+private:
+    SharedDict &dict_;
+    ValueWriter writer_;
+};
+
+// Buffers updates to a SharedDict and applies them in groups; returned by
+// SharedDict.batch(). Only the last update of each key is kept, and a flush
+// stores the entries of each stripe under one acquisition of its lock
+class SharedDictBatch
+{
+public:
+    SharedDictBatch(SharedDict &dict, size_t flush_entries, std::optional<double> flush_interval);
+    ~SharedDictBatch();
+
+    void __setitem__(const Key &key, const nb::object &value);
+    void __delitem__(const Key &key);
+    size_t __len__() const;
+    size_t flush();
+    void discard();
+
+    // Context manager support: flush on success, discard on exception
+    bool __exit__(const nb::handle &exc_type, const nb::handle &exc_value, const nb::handle &traceback);
+
+private:
+    // Keys and encoded values are copied into the arena, so later changes to
+    // the objects do not leak into the buffered update
+    struct Update
+    {
+        size_t key_offset;
+        size_t key_size;
+        size_t value_offset;
+        size_t value_size;
+        size_t terms_size; // index terms, stored after the value
+        bool erase;
+    };
+    struct Pending
+    {
+        std::string arena;
+        std::vector<Update> updates;
+        std::unordered_map<std::string, size_t> slots; // key -> index in updates
+    };
+
+    // Buffers an update; true when the batch is due for a flush
+    bool add(std::string_view key, std::string_view header, std::string_view payload, std::string_view terms,
+             bool erase);
+    void apply(const Pending &pending);
+
+    SharedDict &dict_;
+    size_t flush_entries_;
+    std::optional<std::chrono::steady_clock::duration> flush_interval_;
+    std::chrono::steady_clock::time_point first_update_; // of the pending updates
+    mutable nb::ft_mutex mutex_;
+    Pending pending_;
+    // Held from taking the pending updates until they are applied, so flushes
+    // apply in the order they took them. Needed with the GIL too, which
+    // apply() releases while it waits for stripe locks
+    std::mutex flush_mutex_;
+};
+
+namespace nanobind::detail
+{
+    template <>
+    struct type_caster<Key>
+    {
+        NB_TYPE_CASTER(Key, const_name("str | int | bytes | bytearray | memoryview"))
+
+        bool from_python(handle src, uint8_t, cleanup_list *) noexcept { return Key::from_python(src, value); }
+
+        static handle from_cpp(const Key &key, rv_policy, cleanup_list *) noexcept
+        {
+            return key.object().inc_ref();
+        }
+    };
+} // namespace nanobind::detail
+
 class SharedDict
 {
 public:
@@ -37,9 +208,21 @@ public:
         nb::object data = nb::none(),
         size_t size = DEFAULT_SIZE,
         bool create = true,
-        size_t max_keys = DEFAULT_MAX_KEYS);
+        size_t max_keys = DEFAULT_MAX_KEYS,
+        size_t local_cache_size = 0,
+        size_t bloom_capacity = 0,
+        size_t max_entries = 0,
+        const std::string &eviction_policy = "lru",
+        double high_water_mark = 0.0,
+        nb::object on_memory_pressure = nb::none(),
+        const std::vector<std::string> &indexes = {});
+    // Reattach from a pickled handle (see __getstate__)
+    SharedDict(const std::string &name, uint64_t generation, size_t local_cache_size);
     ~SharedDict();
 
+    // Pickle support: a lightweight handle of name, segment generation and cache size
+    nb::tuple __getstate__() const;
+
     // Lifecycle management
     void close();
     void unlink();
@@ -47,38 +230,149 @@ public:
 
     // Python dict-like interface (using nanobind protocols)
     size_t __len__() const;
-    bool __contains__(const std::string &key) const;
-    nb::object __getitem__(const std::string &key) const;
-    void __setitem__(const std::string &key, const nb::object &value);
-    void __delitem__(const std::string &key);
-    nb::object get(const std::string &key, const nb::object &default_value = nb::none()) const;
+    bool __contains__(const Key &key) const;
+    nb::object __getitem__(const Key &key) const;
+    void __setitem__(const Key &key, const nb::object &value);
+    void __delitem__(const Key &key);
+
+    // Bounded operations: timeout (seconds) or nonblocking limit how long the
+    // stripe lock is waited for, raising LockTimeout when it is not acquired
+    nb::object get(const Key &key, const nb::object &default_value = nb::none(),
+                   std::optional<double> timeout = std::nullopt, bool nonblocking = false) const;
+    void set(const Key &key, const nb::object &value,
+             std::optional<double> timeout = std::nullopt, bool nonblocking = false);
+    bool erase(const Key &key, std::optional<double> timeout = std::nullopt, bool nonblocking = false);
+    nb::list get_many(const std::vector<Key> &keys, const nb::object &default_value = nb::none(),
+                      std::optional<double> timeout = std::nullopt, bool nonblocking = false) const;
+
+    // Vectorized lookup of int keys whose values are bool, int or float
+    using IdArray = nb::ndarray<const int64_t, nb::ndim<1>, nb::c_contig, nb::device::cpu>;
+    nb::tuple get_many_numpy(const IdArray &ids, const nb::object &dtype = nb::str("float64"),
+                             std::optional<double> timeout = std::nullopt, bool nonblocking = false) const;
+
+    // Native reduction over the numbers of every value, on several threads
+    nb::object scan_reduce(const std::string &op, std::optional<std::tuple<std::string, double>> where = std::nullopt,
+                           size_t threads = 0, std::optional<double> timeout = std::nullopt,
+                           bool nonblocking = false) const;
+
+    // asyncio support: awaitables that complete immediately when the stripe lock
+    // is free and otherwise wait for it on the event loop's executor
+    nb::object aget(const Key &key, const nb::object &default_value = nb::none()) const;
+    nb::object aset(const Key &key, const nb::object &value);
+    nb::object aget_many(const std::vector<Key> &keys, const nb::object &default_value = nb::none()) const;
+
+    // Streaming writes of large bytes values
+    SharedDictWriter *writer(const Key &key, size_t size_hint = 0);
+
+    // Write combining for high rates of small updates
+    SharedDictBatch *batch(size_t flush_entries = DEFAULT_BATCH_ENTRIES,
+                           std::optional<double> flush_interval = std::nullopt);
 
     // Python iteration support
-    nb::list keys() const;
+    nb::list keys(std::optional<double> timeout = std::nullopt, bool nonblocking = false) const;
     nb::list values() const;
     nb::list items() const;
 
+    // Keys of the dict values whose indexed field equals value
+    nb::list find_by(const std::string &field, const Key &value, std::optional<double> timeout = std::nullopt,
+                     bool nonblocking = false) const;
+
+    // Online defragmentation, one stripe at a time
+    size_t compact();
+
     // Statistics and sizing (implemented via Python utils module)
     nb::dict get_stats() const;
     nb::dict recommend_sizing(nb::object target_entries = nb::none()) const;
 
 private:
+    friend class SharedDictBatch;
+    friend class SharedDictWriter;
+
     std::string name_;
     size_t size_;
     bool created_;
     size_t max_keys_;
+    size_t local_cache_size_;
     SharedMemoryDict *shm_ptr_;
 
-    // Python pickle module for generic object serialization
+    // Process-local cache of decoded values, validated against stripe versions.
+    // The mutex only does something in free-threaded builds; elsewhere the
+    // GIL already serializes access
+    struct LocalEntry
+    {
+        uint64_t version;
+        nb::object value;                  // the object, or the pickle for pickled values
+        uint8_t marker = PICKLE_MARKER;
+    };
+    mutable nb::ft_mutex local_cache_mutex_;
+    mutable std::unordered_map<std::string, LocalEntry> local_cache_;
+    mutable std::atomic<uint64_t> local_cache_hits_{0};
+    mutable std::atomic<uint64_t> local_cache_misses_{0};
+
+    // Pickle module of the interpreter that made this handle; read-only after construction
     nb::object pickle_module_;
 
+    // Bounded operations that gave up waiting for a stripe lock
+    mutable std::atomic<uint64_t> lock_timeouts_{0};
+
+    // Called with this dictionary when one of its writes hits the soft limit
+    nb::object on_memory_pressure_;
+    void notify_memory_pressure();
+
+    // Names of the segment's indexed fields as str objects; read-only after construction
+    std::vector<nb::object> index_names_;
+
     // Core serialization methods
-    std::string serialize_value(const nb::object &obj) const;
-    nb::object deserialize_value(const std::string &data) const;
+    SerializedValue serialize_value(const nb::object &obj, std::string &header, nb::list &buffers) const;
+    // Secondary index terms of a value (see append_index_term); none unless it is a dict
+    void index_terms(const nb::object &value, std::string &out) const;
+
+    // A write aset() serialized but could not publish without waiting; the
+    // executor only takes the stripe lock and publishes it
+    struct PendingStore
+    {
+        nb::object owner; // keeps this handle alive until the write is done
+        std::string key;
+        std::string header;
+        SerializedValue serialized;
+        nb::list buffers;
+        std::string terms;
+        std::unique_ptr<ValueWriter> writer; // the out-of-band value, once copied
+    };
+    void finish_store(PendingStore &pending);
+
+    // Lock-aware building blocks shared by the blocking and asyncio variants
+    bool fetch_value(std::string_view key, LockWait wait, CapturedValue &out, uint64_t *version = nullptr) const;
+    bool load_value(std::string_view key, LockWait wait, nb::object &out) const;
+    void store_value(std::string_view key, const nb::object &value, LockWait wait);
+    nb::list lookup_many(const std::vector<Key> &keys, const nb::object &default_value, LockWait wait) const;
+    std::vector<std::string> snapshot_keys(LockWait wait = LockWait::forever()) const;
+    template <class Fn>
+    auto counting_timeouts(Fn &&fn) const -> decltype(fn());
+
+    // Two-phase decoding: capture runs under the stripe lock, finish after it
+    void capture_value(std::string_view data, CapturedValue &out) const;
+    nb::object finish_value(CapturedValue &captured) const;
+
+    // Native encodings for None, bool, int, float, str and bytes
+    bool serialize_native(const nb::object &obj, std::string &header, SerializedValue &out) const;
+
+    // Pickle protocol 5 out-of-band buffers, copied once into shared memory
+    void store_out_of_band(std::string_view key, std::string &header, std::string_view stream,
+                           const nb::list &buffers, LockWait wait, std::string_view index_terms);
+    std::unique_ptr<ValueWriter> write_out_of_band(std::string_view key, std::string &header,
+                                                   std::string_view stream, const nb::list &buffers, LockWait wait);
+    nb::object deserialize_out_of_band(const nb::object &storage) const;
 
     // Native numpy array serialization (no pickle overhead)
-    std::string serialize_numpy(const nb::ndarray<> &arr) const;
-    nb::object deserialize_numpy(const char *data, size_t size) const;
+    std::string_view serialize_numpy(const nb::ndarray<> &arr, std::string &header) const;
+    void capture_numpy(const char *data, size_t size, CapturedValue &out) const;
+    nb::object finish_numpy(const CapturedValue &captured) const;
+    nb::object local_object(const LocalEntry &entry) const;
+    // Local cache lookups and updates; see load_value()
+    bool cached_value(std::string_view key, nb::object &out) const;
+    nb::object admit_local(std::string_view key, uint64_t version, CapturedValue &captured) const;
+    void forget_local(std::string_view key) const;
 
     // Helper to check if object is numpy array
     bool is_numpy_array(const nb::object &obj) const;
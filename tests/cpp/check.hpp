@@ -0,0 +1,71 @@
+#pragma once
+
+// Minimal assertions for the C++ tests of the core library. A failed CHECK
+// reports its location and lets the test continue; run_tests() returns a
+// nonzero exit status if any check failed or a test threw
+
+#include <cstdio>
+#include <exception>
+#include <initializer_list>
+#include <utility>
+
+namespace sharedbox_test
+{
+
+    inline int &failures()
+    {
+        static int count = 0;
+        return count;
+    }
+
+    inline void report(const char *file, int line, const char *what)
+    {
+        std::fprintf(stderr, "%s:%d: %s\n", file, line, what);
+        ++failures();
+    }
+
+    using TestFn = void (*)();
+
+    inline int run_tests(std::initializer_list<std::pair<const char *, TestFn>> tests)
+    {
+        for (const auto &test : tests)
+        {
+            const int before = failures();
+            try
+            {
+                test.second();
+            }
+            catch (const std::exception &e)
+            {
+                std::fprintf(stderr, "%s: unexpected exception: %s\n", test.first, e.what());
+                ++failures();
+            }
+            std::printf("%s %s\n", failures() == before ? "PASS" : "FAIL", test.first);
+        }
+        return failures() == 0 ? 0 : 1;
+    }
+
+} // namespace sharedbox_test
+
+#define CHECK(cond)                                                        \
+    do                                                                     \
+    {                                                                      \
+        if (!(cond))                                                       \
+            sharedbox_test::report(__FILE__, __LINE__, "CHECK(" #cond ") failed"); \
+    } while (0)
+
+#define CHECK_THROWS(expr, type)                                                           \
+    do                                                                                     \
+    {                                                                                      \
+        bool caught_ = false;                                                              \
+        try                                                                                \
+        {                                                                                  \
+            expr;                                                                          \
+        }                                                                                  \
+        catch (const type &)                                                               \
+        {                                                                                  \
+            caught_ = true;                                                                \
+        }                                                                                  \
+        if (!caught_)                                                                      \
+            sharedbox_test::report(__FILE__, __LINE__, "CHECK_THROWS(" #expr ", " #type ") did not throw"); \
+    } while (0)
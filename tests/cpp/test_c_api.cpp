@@ -0,0 +1,126 @@
+// Tests of the C interface (sharedbox.h), including what examples/c_client wrote
+
+#include "check.hpp"
+#include "sharedbox.h"
+#include "sharedmemory.hpp"
+#include "value_format.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+using namespace shared_memory;
+
+namespace
+{
+
+    // A segment left over from an earlier, crashed run would be attached instead of created
+    std::string fresh_name(const char *name)
+    {
+        bipc::shared_memory_object::remove(name);
+        return name;
+    }
+
+    void test_get_str()
+    {
+        const std::string name = fresh_name("sharedbox_test_c_str");
+        sharedbox_dict *dict = nullptr;
+        CHECK(sharedbox_open(name.c_str(), 4 << 20, 1, 8, &dict) == SHAREDBOX_OK);
+        CHECK(sharedbox_set_str(dict, "k", 1, "value", 5, SHAREDBOX_WAIT_FOREVER) == SHAREDBOX_OK);
+
+        // Rejected before anything is copied, so no buffer can leak
+        size_t len = 0;
+        CHECK(sharedbox_get_str(dict, "k", 1, nullptr, &len, SHAREDBOX_WAIT_FOREVER) == SHAREDBOX_INVALID);
+
+        char *utf8 = nullptr;
+        CHECK(sharedbox_get_str(dict, "k", 1, &utf8, &len, SHAREDBOX_WAIT_FOREVER) == SHAREDBOX_OK);
+        CHECK(utf8 != nullptr && len == 5 && std::strcmp(utf8, "value") == 0);
+        sharedbox_free(utf8);
+
+        utf8 = nullptr;
+        CHECK(sharedbox_get_str(dict, "missing", 7, &utf8, &len, SHAREDBOX_WAIT_FOREVER) == SHAREDBOX_NOT_FOUND);
+        CHECK(utf8 == nullptr);
+
+        sharedbox_close(dict);
+        CHECK(sharedbox_unlink(name.c_str()) == SHAREDBOX_OK);
+    }
+
+    // Pickles written from C could be dicts the indexes would miss; typed
+    // values are never indexed, so writing one unindexes the key
+    void test_indexed_segment()
+    {
+        const std::string name = fresh_name("sharedbox_test_c_indexed");
+        SharedMemoryDict indexed(name, 4 << 20, true, 8, 0, {}, 0.0, {"status"});
+        std::string terms;
+        append_index_term(terms, 0, "ready");
+        const char pickled[] = {static_cast<char>(PICKLE_MARKER), '.'};
+        indexed.set_parts("a", {std::string_view(pickled, sizeof(pickled))}, LockWait::forever(), terms);
+        CHECK(indexed.find_by("status", "ready").size() == 1);
+
+        sharedbox_dict *dict = nullptr;
+        CHECK(sharedbox_open(name.c_str(), 0, 0, 0, &dict) == SHAREDBOX_OK);
+        for (const std::uint8_t marker : {PICKLE_MARKER, PICKLE5_MARKER, std::uint8_t{0x80}})
+        {
+            const char value[] = {static_cast<char>(marker), '.'};
+            CHECK(sharedbox_set_raw(dict, "a", 1, value, sizeof(value), SHAREDBOX_WAIT_FOREVER) == SHAREDBOX_INVALID);
+        }
+        CHECK(indexed.find_by("status", "ready").size() == 1);
+
+        const char str_value[] = {static_cast<char>(STR_MARKER), 'x'};
+        CHECK(sharedbox_set_raw(dict, "b", 1, str_value, sizeof(str_value), SHAREDBOX_WAIT_FOREVER) == SHAREDBOX_OK);
+        CHECK(sharedbox_set_str(dict, "a", 1, "done", 4, SHAREDBOX_WAIT_FOREVER) == SHAREDBOX_OK);
+        CHECK(indexed.find_by("status", "ready").empty());
+        CHECK(sharedbox_size(dict) == 2);
+
+        sharedbox_close(dict);
+        indexed.close();
+        indexed.unlink();
+    }
+
+    // Runs after the c_client example (see CMakeLists.txt) and reads what it wrote
+    void test_c_client_output()
+    {
+        const char *name = "sharedbox_test_c_client";
+        sharedbox_dict *dict = nullptr;
+        CHECK(sharedbox_open(name, 0, 0, 0, &dict) == SHAREDBOX_OK);
+        if (dict == nullptr)
+            return;
+
+        char *greeting = nullptr;
+        size_t greeting_len = 0;
+        CHECK(sharedbox_get_str(dict, "greeting", 8, &greeting, &greeting_len, SHAREDBOX_WAIT_FOREVER) ==
+              SHAREDBOX_OK);
+        CHECK(greeting != nullptr && std::string(greeting, greeting_len) == "hello from C");
+        sharedbox_free(greeting);
+
+        int64_t answer = 0;
+        CHECK(sharedbox_get_int64(dict, "answer", 6, &answer, SHAREDBOX_WAIT_FOREVER) == SHAREDBOX_OK);
+        CHECK(answer == 42);
+        double ratio = 0;
+        CHECK(sharedbox_get_double(dict, "ratio", 5, &ratio, SHAREDBOX_WAIT_FOREVER) == SHAREDBOX_OK);
+        CHECK(ratio == 0.25);
+
+        void *payload = nullptr;
+        size_t payload_len = 0;
+        CHECK(sharedbox_get_bytes(dict, "payload", 7, &payload, &payload_len, SHAREDBOX_WAIT_FOREVER) ==
+              SHAREDBOX_OK);
+        const unsigned char expected[] = {0, 1, 2, 3};
+        CHECK(payload_len == sizeof(expected) && std::memcmp(payload, expected, sizeof(expected)) == 0);
+        sharedbox_free(payload);
+
+        CHECK(sharedbox_size(dict) == 4);
+
+        sharedbox_close(dict);
+        CHECK(sharedbox_unlink(name) == SHAREDBOX_OK);
+    }
+
+} // namespace
+
+int main()
+{
+    return sharedbox_test::run_tests({
+        {"get_str", test_get_str},
+        {"indexed_segment", test_indexed_segment},
+        {"c_client_output", test_c_client_output},
+    });
+}
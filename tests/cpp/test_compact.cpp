@@ -0,0 +1,184 @@
+// Tests of SharedMemoryDict::compact()
+
+#include "check.hpp"
+#include "sharedmemory.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace shared_memory;
+
+namespace
+{
+
+    std::string fresh_name(const char *name)
+    {
+        bipc::shared_memory_object::remove(name);
+        return name;
+    }
+
+    std::string value_of(int key, int round, std::size_t size)
+    {
+        std::string value = std::to_string(key) + ":" + std::to_string(round) + ":";
+        value.resize(size, static_cast<char>('a' + key % 26));
+        return value;
+    }
+
+    // Values larger than a copy chunk, and stripes spanning several chunks
+    void test_keeps_contents()
+    {
+        SharedMemoryDict dict(fresh_name("sharedbox_test_compact_contents"), 64 << 20, true, 4, 10000);
+        std::map<std::string, std::string> expected;
+        for (int i = 0; i < 4000; ++i)
+        {
+            const std::size_t size = i % 500 == 0 ? 300 * 1024 : 1 + i % 3000;
+            expected[std::to_string(i)] = value_of(i, 0, size);
+            dict.set(std::to_string(i), expected[std::to_string(i)]);
+        }
+        for (int i = 0; i < 4000; i += 3)
+        {
+            dict.erase(std::to_string(i));
+            expected.erase(std::to_string(i));
+        }
+
+        CHECK(dict.compact() == expected.size());
+        CHECK(dict.size() == expected.size());
+        for (const auto &kv : expected)
+        {
+            std::string value;
+            CHECK(dict.get(kv.first, value) && value == kv.second);
+        }
+        std::string value;
+        CHECK(!dict.get("0", value) && !dict.get("3", value));
+
+        dict.close();
+        dict.unlink();
+    }
+
+    // The recency order of cache mode survives the copy, including reads
+    // made after the entries were copied
+    void test_keeps_recency()
+    {
+        SharedMemoryDict dict(fresh_name("sharedbox_test_compact_recency"), 16 << 20, true, 1, 0,
+                              {100, EvictionPolicy::lru});
+        for (int i = 0; i < 100; ++i)
+            dict.set(std::to_string(i), std::string(1000, 'r'));
+        std::string value;
+        CHECK(dict.get("0", value));
+
+        CHECK(dict.compact() == 100);
+        dict.set("new", "v");
+        CHECK(dict.contains("0") && !dict.contains("1") && dict.contains("2"));
+
+        dict.close();
+        dict.unlink();
+    }
+
+    // Writers keep changing every stripe while two threads compact: copies
+    // interrupted by a write start over, and no write is lost
+    void test_concurrent_writes()
+    {
+        SharedMemoryDict dict(fresh_name("sharedbox_test_compact_writers"), 128 << 20, true, 4);
+        constexpr int WRITERS = 2, KEYS = 1000, ROUNDS = 20;
+        std::vector<std::map<std::string, std::string>> expected(WRITERS);
+        std::atomic<int> running{WRITERS};
+
+        std::vector<std::thread> threads;
+        for (int w = 0; w < WRITERS; ++w)
+        {
+            threads.emplace_back([&, w]
+                                 {
+                                     for (int round = 0; round < ROUNDS; ++round)
+                                     {
+                                         for (int k = w; k < KEYS; k += WRITERS)
+                                         {
+                                             const std::string key = std::to_string(k);
+                                             if ((k + round) % 7 == 0)
+                                             {
+                                                 dict.erase(key);
+                                                 expected[w].erase(key);
+                                             }
+                                             else
+                                             {
+                                                 expected[w][key] = value_of(k, round, 2000 + k % 1000);
+                                                 dict.set(key, expected[w][key]);
+                                             }
+                                         }
+                                     }
+                                     --running; });
+        }
+        std::atomic<std::size_t> compactions{0};
+        for (int c = 0; c < 2; ++c)
+        {
+            threads.emplace_back([&]
+                                 {
+                                     while (running.load() > 0)
+                                     {
+                                         dict.compact();
+                                         ++compactions;
+                                     } });
+        }
+        for (auto &thread : threads)
+            thread.join();
+
+        CHECK(compactions.load() > 0);
+        std::size_t total = 0;
+        for (const auto &writer : expected)
+        {
+            total += writer.size();
+            for (const auto &kv : writer)
+            {
+                std::string value;
+                CHECK(dict.get(kv.first, value) && value == kv.second);
+            }
+        }
+        CHECK(dict.size() == total);
+        CHECK(dict.compact() == total);
+
+        dict.close();
+        dict.unlink();
+    }
+
+    // A write that changed the map and then failed to allocate its index
+    // postings must still bump the version, or a chunked compact() copy
+    // taken before it would be swapped in without the key
+    void test_failed_write_bumps_version()
+    {
+        SharedMemoryDict dict(fresh_name("sharedbox_test_compact_failed_write"), 4 << 20, true, 1, 0, {}, 0.0,
+                              {"f"});
+        const std::string filler(16 * 1024, 'f');
+        try
+        {
+            for (int i = 0;; ++i)
+                dict.set(std::to_string(i), filler);
+        }
+        catch (const bipc::bad_alloc &)
+        {
+        }
+
+        std::string terms;
+        append_index_term(terms, 0, std::string(64 * 1024, 't'));
+        const std::uint64_t before = dict.stripe_version("k");
+        CHECK_THROWS(dict.set_parts("k", {"v"}, LockWait::forever(), terms), bipc::bad_alloc);
+        CHECK(dict.contains("k"));
+        CHECK(dict.stripe_version("k") != before);
+
+        dict.close();
+        dict.unlink();
+    }
+
+} // namespace
+
+int main()
+{
+    return sharedbox_test::run_tests({
+        {"keeps_contents", test_keeps_contents},
+        {"keeps_recency", test_keeps_recency},
+        {"concurrent_writes", test_concurrent_writes},
+        {"failed_write_bumps_version", test_failed_write_bumps_version},
+    });
+}
@@ -0,0 +1,182 @@
+// Tests of SharedMemoryDict heap statistics and the soft memory limit
+
+#include "check.hpp"
+#include "sharedmemory.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+using namespace shared_memory;
+
+namespace
+{
+
+    std::string fresh_name(const char *name)
+    {
+        bipc::shared_memory_object::remove(name);
+        return name;
+    }
+
+    void test_free_bytes()
+    {
+        SharedMemoryDict dict(fresh_name("sharedbox_test_usage_blocks"), 4 << 20, true, 4);
+        MemoryUsage usage = dict.memory_usage();
+        CHECK(usage.free_bytes > 0 && usage.free_bytes < usage.total_bytes);
+
+        // Fill the heap, then free every other value: plenty of free bytes,
+        // none of them in one large block
+        const std::string value(1000, 'x');
+        int count = 0;
+        try
+        {
+            for (;; ++count)
+                dict.set(std::to_string(count), value);
+        }
+        catch (const bipc::bad_alloc &)
+        {
+        }
+        for (int i = 0; i < count; i += 2)
+            dict.erase(std::to_string(i));
+
+        usage = dict.memory_usage();
+        CHECK(usage.free_bytes > 1000 * static_cast<std::size_t>(count / 2));
+        CHECK_THROWS(dict.set("big", std::string(usage.free_bytes / 2, 'y')), bipc::bad_alloc);
+        CHECK(dict.memory_usage().free_bytes == usage.free_bytes);
+
+        dict.close();
+        dict.unlink();
+    }
+
+    // memory_usage() must not allocate: writers checking the soft limit while
+    // it runs would see the heap almost full and fail for no reason
+    void test_stats_do_not_affect_writers()
+    {
+        SharedMemoryDict dict(fresh_name("sharedbox_test_usage_writers"), 16 << 20, true, 16, 0, {}, 0.9);
+        std::atomic<bool> done{false};
+        std::thread reader([&]
+                           {
+                               while (!done.load())
+                                   dict.memory_usage(); });
+
+        int rejected = 0;
+        const std::string value(64, 'v');
+        for (int i = 0; i < 200000; ++i)
+        {
+            try
+            {
+                dict.set(std::to_string(i % 1000), value);
+            }
+            catch (const MemoryPressure &)
+            {
+                ++rejected;
+            }
+        }
+        done = true;
+        reader.join();
+
+        CHECK(rejected == 0);
+        CHECK(dict.memory_usage().soft_limit_rejections == 0);
+        dict.close();
+        dict.unlink();
+    }
+
+    // In cache mode the soft limit evicts instead of refusing: stats must not
+    // cost entries either
+    void test_stats_do_not_evict()
+    {
+        CacheOptions cache;
+        cache.max_entries = 100000;
+        SharedMemoryDict dict(fresh_name("sharedbox_test_usage_evict"), 16 << 20, true, 16, 0, cache, 0.9);
+        std::atomic<bool> done{false};
+        std::thread reader([&]
+                           {
+                               while (!done.load())
+                                   dict.memory_usage(); });
+
+        const std::string value(64, 'v');
+        for (int i = 0; i < 200000; ++i)
+            dict.set(std::to_string(i % 1000), value);
+        done = true;
+        reader.join();
+
+        CHECK(dict.size() == 1000);
+        CHECK(dict.memory_usage().soft_limit_evictions == 0);
+        dict.close();
+        dict.unlink();
+    }
+
+    // Values streamed through ValueWriter meet the soft limit like set():
+    // at the size hint and whenever the buffer grows, never as bad_alloc
+    void test_value_writer_limit()
+    {
+        SharedMemoryDict dict(fresh_name("sharedbox_test_usage_writer"), 4 << 20, true, 4, 0, {}, 0.5);
+        CHECK_THROWS(ValueWriter(dict, "hinted", 3 << 20), MemoryPressure);
+
+        const std::string chunk(64 * 1024, 'w');
+        std::size_t written = 0;
+        CHECK_THROWS(
+            {
+                ValueWriter writer(dict, "grown", 0);
+                for (; written < (3u << 20); written += chunk.size())
+                    writer.write(chunk.data(), chunk.size());
+            },
+            MemoryPressure);
+        CHECK(written >= (512u << 10) && written < (2u << 20));
+        CHECK(dict.memory_usage().soft_limit_rejections == 2);
+
+        // Doubling stops short of the limit rather than refusing a value that
+        // fits; growing briefly needs the old buffer and the new one
+        dict.set("filler", std::string(700u << 10, 'f'));
+        ValueWriter fits(dict, "fits", 0);
+        for (written = 0; written < (640u << 10); written += chunk.size())
+            fits.write(chunk.data(), chunk.size());
+        fits.commit();
+        CHECK(dict.contains("fits"));
+        dict.close();
+        dict.unlink();
+
+        CacheOptions cache;
+        cache.max_entries = 1000;
+        SharedMemoryDict cached(fresh_name("sharedbox_test_usage_writer_cache"), 4 << 20, true, 1, 0, cache, 0.5);
+        for (int i = 0; i < 10; ++i)
+            cached.set(std::to_string(i), std::string(100 * 1024, 'c'));
+        ValueWriter writer(cached, "big", 0);
+        for (written = 0; written < (1u << 20); written += chunk.size())
+            writer.write(chunk.data(), chunk.size());
+        writer.commit();
+        CHECK(cached.contains("big") && !cached.contains("0"));
+        CHECK(cached.memory_usage().soft_limit_evictions > 0);
+        cached.close();
+        cached.unlink();
+    }
+
+    // commit() returns the unused part of an oversized hint to the heap
+    void test_value_writer_slack()
+    {
+        SharedMemoryDict dict(fresh_name("sharedbox_test_usage_slack"), 4 << 20, true, 4);
+        const std::size_t before = dict.memory_usage().free_bytes;
+        ValueWriter writer(dict, "small", 2 << 20);
+        writer.write("value", 5);
+        CHECK(dict.memory_usage().free_bytes < before - (1u << 20));
+        writer.commit();
+        CHECK(dict.memory_usage().free_bytes > before - 4096);
+
+        std::string value;
+        CHECK(dict.get("small", value) && value == "value");
+        dict.close();
+        dict.unlink();
+    }
+
+} // namespace
+
+int main()
+{
+    return sharedbox_test::run_tests({
+        {"free_bytes", test_free_bytes},
+        {"stats_do_not_affect_writers", test_stats_do_not_affect_writers},
+        {"stats_do_not_evict", test_stats_do_not_evict},
+        {"value_writer_limit", test_value_writer_limit},
+        {"value_writer_slack", test_value_writer_slack},
+    });
+}
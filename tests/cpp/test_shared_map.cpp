@@ -0,0 +1,299 @@
+// Tests of the header-only SharedMap
+
+#include "check.hpp"
+#include "shared_map.hpp"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace shared_memory;
+
+namespace
+{
+
+    // A segment left over from an earlier, crashed run would be attached instead of created
+    std::string fresh_name(const char *name)
+    {
+        bipc::shared_memory_object::remove(name);
+        return name;
+    }
+
+    void test_set_get_erase()
+    {
+        SharedMap<std::uint64_t, double> map(fresh_name("sharedbox_test_map_basic"), 8 << 20, true, 8);
+        for (std::uint64_t k = 0; k < 10000; ++k)
+            map.set(k, k * 0.5);
+        CHECK(map.size() == 10000);
+
+        double v = 0;
+        CHECK(map.get(1234, v) && v == 617.0);
+        CHECK(!map.get(10000, v));
+        map.set(1234, -1.0);
+        CHECK(map.get(1234, v) && v == -1.0);
+        CHECK(map.size() == 10000);
+
+        for (std::uint64_t k = 0; k < 10000; k += 2)
+            CHECK(map.erase(k));
+        CHECK(!map.erase(0));
+        CHECK(map.size() == 5000);
+        CHECK(!map.contains(2) && map.contains(3));
+
+        std::size_t visited = 0;
+        map.for_each([&](std::uint64_t k, double) { visited += k % 2; });
+        CHECK(visited == 5000);
+
+        map.close();
+        CHECK_THROWS(map.get(1, v), std::runtime_error);
+        map.unlink();
+    }
+
+    // Random inserts and erases against std::map. Few live keys and many
+    // erases fill small tables with tombstones, which rehashing must drop:
+    // otherwise the tables keep growing until the 1 MB segment runs out
+    void test_rehash_over_tombstones()
+    {
+        SharedMap<std::uint32_t, std::uint32_t> map(fresh_name("sharedbox_test_map_churn"), 1 << 20, true, 2);
+        std::map<std::uint32_t, std::uint32_t> expected;
+        std::mt19937 rng(7);
+        for (std::uint32_t i = 0; i < 200000; ++i)
+        {
+            const std::uint32_t key = rng() % 64 + (i / 1000) * 64;
+            if (rng() % 2 == 0)
+            {
+                map.set(key, i);
+                expected[key] = i;
+            }
+            else
+            {
+                CHECK(map.erase(key) == (expected.erase(key) == 1));
+            }
+        }
+        CHECK(map.size() == expected.size());
+        for (const auto &kv : expected)
+        {
+            std::uint32_t v = 0;
+            CHECK(map.get(kv.first, v) && v == kv.second);
+        }
+        map.close();
+        map.unlink();
+    }
+
+    void test_reattach()
+    {
+        const std::string name = fresh_name("sharedbox_test_map_reattach");
+        SharedMap<std::uint64_t, std::uint64_t> map(name, 4 << 20, true, 4);
+        map.set(1, 100);
+
+        // Same process: reuses the mapping
+        SharedMap<std::uint64_t, std::uint64_t> reopened(name, map.generation());
+        std::uint64_t v = 0;
+        CHECK(reopened.get(1, v) && v == 100);
+        reopened.set(2, 200);
+        CHECK(map.get(2, v) && v == 200);
+        CHECK(reopened.stripe_count() == 4);
+
+        // Attaching by name adopts the creator's stripe count
+        SharedMap<std::uint64_t, std::uint64_t> attached(name, 0, false, 64);
+        CHECK(attached.stripe_count() == 4);
+        CHECK(attached.get(2, v) && v == 200);
+
+        CHECK_THROWS((SharedMap<std::uint64_t, std::uint64_t>(name, map.generation() + 1)), std::runtime_error);
+
+        reopened.close();
+        attached.close();
+        map.close();
+        map.unlink();
+    }
+
+    void test_rejects_other_containers()
+    {
+        const std::string name = fresh_name("sharedbox_test_map_kind");
+        SharedMap<std::uint64_t, std::uint64_t> map(name, 4 << 20, true, 4);
+
+        CHECK_THROWS((SharedMap<std::uint64_t, std::uint32_t>(name, 0, false)), std::runtime_error);
+        CHECK_THROWS((SharedMap<std::uint32_t, std::uint64_t>(name, 0, false)), std::runtime_error);
+        CHECK_THROWS((SharedMap<std::uint32_t, std::uint64_t>(name, map.generation())), std::runtime_error);
+        CHECK_THROWS(SharedMemoryDict(name, 0, false), std::runtime_error);
+        map.close();
+        map.unlink();
+
+        const std::string dict_name = fresh_name("sharedbox_test_map_dict");
+        SharedMemoryDict dict(dict_name, 4 << 20, true, 4);
+        CHECK_THROWS((SharedMap<std::uint64_t, std::uint64_t>(dict_name, 0, false)), std::runtime_error);
+        CHECK_THROWS((SharedMap<std::uint64_t, std::uint64_t>(dict_name, dict.generation())), std::runtime_error);
+        dict.close();
+        dict.unlink();
+    }
+
+    // Every key gets fingerprint 0x2A and home group 0, so they all share one
+    // probe sequence and only the key comparison tells them apart
+    struct SameGroupHash
+    {
+        std::uint64_t operator()(std::uint64_t) const noexcept { return 0x2A; }
+    };
+
+    // Fingerprint key % 128 and home group 0: a group holds neighbouring
+    // fingerprints, which the SWAR match may flag falsely, and keys 128 apart
+    // collide completely
+    struct LowBitsHash
+    {
+        std::uint64_t operator()(std::uint64_t key) const noexcept { return key & 0x7F; }
+    };
+
+    template <class Hash>
+    void check_against_map(const char *name, std::uint64_t key_count)
+    {
+        SharedMap<std::uint64_t, std::uint64_t, Hash> map(fresh_name(name), 4 << 20, true, 1);
+        std::map<std::uint64_t, std::uint64_t> expected;
+        std::mt19937 rng(11);
+        for (int i = 0; i < 20000; ++i)
+        {
+            const std::uint64_t key = rng() % key_count;
+            if (rng() % 3 != 0)
+            {
+                map.set(key, i);
+                expected[key] = i;
+            }
+            else
+            {
+                CHECK(map.erase(key) == (expected.erase(key) == 1));
+            }
+        }
+        CHECK(map.size() == expected.size());
+        for (std::uint64_t key = 0; key < key_count + 256; ++key)
+        {
+            std::uint64_t v = 0;
+            const auto it = expected.find(key);
+            CHECK(map.get(key, v) == (it != expected.end()));
+            if (it != expected.end())
+                CHECK(v == it->second);
+        }
+        map.close();
+        map.unlink();
+    }
+
+    void test_shared_fingerprint_and_group()
+    {
+        check_against_map<SameGroupHash>("sharedbox_test_map_same_group", 300);
+        check_against_map<LowBitsHash>("sharedbox_test_map_low_bits", 1000);
+    }
+
+    // With one stripe and every key in home group 0, keys 1..8 fill the first
+    // group of a new 16-slot table and key 9 overflows into the second one
+    void test_erase_in_full_group()
+    {
+        SharedMap<std::uint64_t, std::uint64_t, SameGroupHash> map(fresh_name("sharedbox_test_map_full_group"),
+                                                                   1 << 20, true, 1);
+        for (std::uint64_t k = 1; k <= 9; ++k)
+            map.set(k, k);
+
+        // Key 9's probe passed through the full group: its slot must become a
+        // tombstone, or the lookup of 9 would stop there
+        std::uint64_t v = 0;
+        CHECK(map.erase(4));
+        CHECK(map.get(9, v) && v == 9);
+        CHECK(!map.get(4, v));
+
+        map.set(4, 40); // reuses the tombstone
+        map.set(10, 10);
+        for (std::uint64_t k = 1; k <= 10; ++k)
+            CHECK(map.get(k, v) && v == (k == 4 ? 40 : k));
+
+        CHECK(map.erase(9) && map.erase(2));
+        CHECK(map.get(10, v) && v == 10);
+        CHECK(!map.get(9, v) && !map.get(2, v));
+        CHECK(map.size() == 8);
+        map.close();
+        map.unlink();
+    }
+
+    void test_erase_in_group_with_room()
+    {
+        SharedMap<std::uint64_t, std::uint64_t, SameGroupHash> map(fresh_name("sharedbox_test_map_open_group"),
+                                                                   1 << 20, true, 1);
+        for (std::uint64_t k = 1; k <= 3; ++k)
+            map.set(k, k);
+
+        // No probe has passed through a group with an empty slot, so erased
+        // slots there are emptied; later inserts still fill the group first
+        std::uint64_t v = 0;
+        CHECK(map.erase(2));
+        CHECK(!map.get(2, v));
+        map.set(2, 20);
+        for (std::uint64_t k = 4; k <= 12; ++k)
+            map.set(k, k);
+        for (std::uint64_t k = 1; k <= 12; ++k)
+            CHECK(map.get(k, v) && v == (k == 2 ? 20 : k));
+
+        for (std::uint64_t k = 1; k <= 12; ++k)
+            CHECK(map.erase(k));
+        CHECK(map.size() == 0);
+        for (std::uint64_t k = 1; k <= 12; ++k)
+            CHECK(!map.contains(k));
+        map.close();
+        map.unlink();
+    }
+
+    // get_many() must agree with get() whatever the batch size: batches are
+    // grouped by stripe and probed PREFETCH_BATCH (16) keys at a time
+    template <class Hash>
+    void check_get_many(const char *name, std::size_t stripe_count)
+    {
+        SharedMap<std::uint64_t, std::uint64_t, Hash> map(fresh_name(name), 8 << 20, true, stripe_count);
+        for (std::uint64_t k = 0; k < 5000; k += 3)
+            map.set(k, k * 7);
+
+        std::mt19937 rng(5);
+        for (std::size_t count : {0, 1, 15, 16, 17, 31, 33, 1000, 4099})
+        {
+            std::vector<std::uint64_t> keys(count);
+            for (auto &key : keys)
+                key = rng() % 6000; // about a third present, with repeats
+            std::vector<std::uint64_t> values(count, 0);
+            std::unique_ptr<bool[]> found(new bool[count + 1]);
+
+            const std::size_t hits = map.get_many(keys.data(), count, values.data(), found.get());
+            std::size_t expected_hits = 0;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                std::uint64_t v = 0;
+                const bool present = map.get(keys[i], v);
+                expected_hits += present;
+                CHECK(found[i] == present);
+                if (present)
+                    CHECK(values[i] == v);
+            }
+            CHECK(hits == expected_hits);
+        }
+        map.close();
+        map.unlink();
+    }
+
+    void test_get_many_matches_get()
+    {
+        check_get_many<SharedMapHash<std::uint64_t>>("sharedbox_test_map_many_1", 1);
+        check_get_many<SharedMapHash<std::uint64_t>>("sharedbox_test_map_many_7", 7);
+        check_get_many<SharedMapHash<std::uint64_t>>("sharedbox_test_map_many_128", 128);
+        check_get_many<LowBitsHash>("sharedbox_test_map_many_low_bits", 3);
+    }
+
+} // namespace
+
+int main()
+{
+    return sharedbox_test::run_tests({
+        {"set_get_erase", test_set_get_erase},
+        {"rehash_over_tombstones", test_rehash_over_tombstones},
+        {"reattach", test_reattach},
+        {"rejects_other_containers", test_rejects_other_containers},
+        {"shared_fingerprint_and_group", test_shared_fingerprint_and_group},
+        {"erase_in_full_group", test_erase_in_full_group},
+        {"erase_in_group_with_room", test_erase_in_group_with_room},
+        {"get_many_matches_get", test_get_many_matches_get},
+    });
+}
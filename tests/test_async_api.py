@@ -0,0 +1,134 @@
+"""
+Test get_many() and the asyncio variants aget(), aset() and aget_many()
+"""
+
+import asyncio
+import threading
+
+import numpy as np
+
+from sharedbox import SharedDict
+
+
+def test_get_many() -> None:
+    """Batch lookups return values in key order with defaults for misses"""
+    d = SharedDict("async_get_many", size=10 * 1024 * 1024, create=True)
+    d["a"] = 1
+    d["b"] = {"nested": [1, 2]}
+
+    assert d.get_many(["a", "missing", "b"]) == [1, None, {"nested": [1, 2]}]
+    assert d.get_many(["missing"], default=0) == [0]
+    assert d.get_many([]) == []
+
+    d.close()
+    d.unlink()
+
+
+def test_aget_and_aset() -> None:
+    """Awaitable reads and writes round-trip values"""
+    d = SharedDict("async_get_set", size=10 * 1024 * 1024, create=True)
+
+    async def main() -> None:
+        await d.aset("x", "hello")
+        await d.aset("arr", np.arange(10))
+        assert await d.aget("x") == "hello"
+        np.testing.assert_array_equal(await d.aget("arr"), np.arange(10))
+        assert await d.aget("missing") is None
+        assert await d.aget("missing", default=-1) == -1
+        assert await d.aget_many(["x", "missing"], default=0) == ["hello", 0]
+
+    asyncio.run(main())
+    assert d["x"] == "hello"
+
+    d.close()
+    d.unlink()
+
+
+def test_async_requires_running_loop() -> None:
+    """The async variants must be called from inside an event loop"""
+    d = SharedDict("async_no_loop", size=10 * 1024 * 1024, create=True)
+
+    try:
+        d.aget("x")
+    except RuntimeError:
+        pass
+    else:
+        raise AssertionError("aget() outside a running loop should fail")
+
+    d.close()
+    d.unlink()
+
+
+def test_async_with_concurrent_writers() -> None:
+    """The loop keeps serving awaits while other threads hammer the same keys"""
+    d = SharedDict("async_concurrent", size=10 * 1024 * 1024, create=True, max_keys=4)
+    stop = threading.Event()
+
+    def writer(worker_id: int) -> None:
+        i = 0
+        while not stop.is_set():
+            d[f"key_{i % 8}"] = worker_id
+            i += 1
+
+    threads = [threading.Thread(target=writer, args=(i,)) for i in range(4)]
+    for t in threads:
+        t.start()
+
+    async def main() -> None:
+        for i in range(500):
+            await d.aset(f"key_{i % 8}", -1)
+            values = await d.aget_many([f"key_{k}" for k in range(8)])
+            assert all(v is None or v in (-1, 0, 1, 2, 3) for v in values)
+
+    try:
+        asyncio.run(main())
+    finally:
+        stop.set()
+        for t in threads:
+            t.join()
+
+    d.close()
+    d.unlink()
+
+
+class CountsPickling:
+    """Counts how often instances are pickled"""
+
+    calls = 0
+
+    def __reduce__(self) -> tuple:
+        CountsPickling.calls += 1
+        return (CountsPickling, ())
+
+
+def test_aset_serializes_once_under_contention() -> None:
+    """Writes deferred to the executor by a busy stripe are not pickled again"""
+    d = SharedDict("async_serialize_once", size=64 * 1024 * 1024, create=True, max_keys=1)
+    stop = threading.Event()
+    payload = np.zeros(1024 * 1024, dtype=np.uint8)
+
+    def writer() -> None:
+        while not stop.is_set():
+            d["big"] = payload
+
+    thread = threading.Thread(target=writer)
+    thread.start()
+    CountsPickling.calls = 0
+
+    async def main() -> None:
+        for i in range(200):
+            await d.aset("plain", [i, CountsPickling()])
+            await d.aset("oob", {"arr": np.full(1000, i), "marker": CountsPickling()})
+            assert d["plain"][0] == i
+            np.testing.assert_array_equal(d["oob"]["arr"], np.full(1000, i))
+
+    try:
+        asyncio.run(main())
+    finally:
+        stop.set()
+        thread.join()
+
+    assert CountsPickling.calls == 400
+
+    d.close()
+    d.unlink()
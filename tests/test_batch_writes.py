@@ -0,0 +1,208 @@
+"""
+Test write-combining batches (SharedDict.batch)
+"""
+
+import gc
+import sys
+import threading
+import time
+
+import numpy as np
+import pytest
+
+from sharedbox import MemoryPressure, SharedDict
+
+
+def test_batch_applies_on_exit() -> None:
+    """Updates stay buffered until the block exits, then all become visible"""
+    d = SharedDict("batch_exit", size=10 * 1024 * 1024, create=True)
+    d["old"] = 1
+
+    with d.batch() as b:
+        for i in range(500):
+            b[i] = {"value": i}
+        del b["old"]
+        assert len(b) == 501
+        assert 0 not in d
+        assert d["old"] == 1
+
+    assert len(b) == 0
+    assert len(d) == 500
+    assert d[499] == {"value": 499}
+    assert "old" not in d
+
+    d.close()
+    d.unlink()
+
+
+def test_last_update_of_a_key_wins() -> None:
+    """Repeated updates of one key are combined and applied in order"""
+    d = SharedDict("batch_order", size=10 * 1024 * 1024, create=True)
+    d["gone"] = "x"
+
+    with d.batch() as b:
+        b["a"] = 1
+        b["a"] = 2
+        del b["a"]
+        b["a"] = 3
+        b["gone"] = "y"
+        del b["gone"]
+        del b["never"]  # missing keys are ignored
+        assert len(b) == 3
+
+    assert d["a"] == 3
+    assert "gone" not in d
+    assert "never" not in d
+
+    d.close()
+    d.unlink()
+
+
+def test_values_are_captured_when_assigned() -> None:
+    """Mutating an object after assigning it does not change the buffered value"""
+    d = SharedDict("batch_capture", size=10 * 1024 * 1024, create=True)
+    items = [1, 2]
+    arr = np.arange(4)
+
+    with d.batch() as b:
+        b["list"] = items
+        b["array"] = arr
+        items.append(3)
+        arr[0] = 100
+
+    assert d["list"] == [1, 2]
+    np.testing.assert_array_equal(d["array"], np.arange(4))
+
+    d.close()
+    d.unlink()
+
+
+def test_flush_bounds() -> None:
+    """flush_entries and flush_interval trigger flushes inside the block"""
+    d = SharedDict("batch_bounds", size=10 * 1024 * 1024, create=True)
+
+    with d.batch(flush_entries=10) as b:
+        for i in range(25):
+            b[i] = i
+        assert len(b) == 5
+        assert len(d) == 20
+
+    with d.batch(flush_interval=0.01) as b:
+        b["first"] = 1
+        time.sleep(0.05)
+        b["second"] = 2
+        assert len(b) == 0
+        assert d["first"] == 1
+
+    with pytest.raises(ValueError):
+        d.batch(flush_entries=0)
+    with pytest.raises(ValueError):
+        d.batch(flush_interval=-1.0)
+
+    d.close()
+    d.unlink()
+
+
+def test_exception_discards_pending() -> None:
+    """Pending updates are dropped when the block raises; flushed ones stay"""
+    d = SharedDict("batch_error", size=10 * 1024 * 1024, create=True)
+
+    with pytest.raises(RuntimeError):
+        with d.batch() as b:
+            b["flushed"] = 1
+            assert b.flush() == 1
+            b["pending"] = 2
+            raise RuntimeError("boom")
+
+    assert d["flushed"] == 1
+    assert "pending" not in d
+
+    b = d.batch()
+    b["kept"] = 1
+    b.discard()
+    assert b.flush() == 0
+    assert "kept" not in d
+
+    d.close()
+    d.unlink()
+
+
+def test_batch_in_cache_mode() -> None:
+    """Batched inserts evict like individual ones and keep the cache bounded"""
+    d = SharedDict("batch_cache", size=10 * 1024 * 1024, create=True, max_keys=4, max_entries=100)
+
+    with d.batch(flush_entries=64) as b:
+        for i in range(1000):
+            b[i] = i
+
+    assert len(d) <= 100
+    assert d[999] == 999
+    assert d.get_stats()["evictions"] == 1000 - len(d)
+
+    d.close()
+    d.unlink()
+
+
+def test_dropped_batch_reports_failed_flush(monkeypatch: pytest.MonkeyPatch) -> None:
+    """A batch dropped unflushed applies its updates, or reports why it could not"""
+    d = SharedDict("batch_dropped", size=4 * 1024 * 1024, create=True, high_water_mark=0.5)
+    unraisable = []
+    monkeypatch.setattr(sys, "unraisablehook", unraisable.append)
+
+    b = d.batch()
+    b["small"] = 1
+    del b
+    gc.collect()
+    assert d["small"] == 1
+    assert unraisable == []
+
+    b = d.batch()
+    b["big"] = b"x" * 3 * 1024 * 1024  # above the high-water mark once applied
+    del b
+    gc.collect()
+    assert "big" not in d
+    assert len(unraisable) == 1
+    assert isinstance(unraisable[0].exc_value, MemoryPressure)
+
+    d.close()
+    d.unlink()
+
+
+def test_concurrent_flushes_keep_key_order() -> None:
+    """Flushes from two threads apply in the order they took the updates"""
+    d = SharedDict("batch_threads", size=10 * 1024 * 1024, create=True)
+    d["counter"] = -1
+    b = d.batch(flush_entries=1000)
+    assign = threading.Lock()
+    next_value = [0]
+    seen: list[int] = []
+    stop = threading.Event()
+
+    def writer() -> None:
+        for _ in range(2000):
+            with assign:  # values are buffered in increasing order
+                b["counter"] = next_value[0]
+                b[f"filler_{next_value[0] % 64}"] = b"x" * 4096
+                next_value[0] += 1
+            b.flush()
+
+    def reader() -> None:
+        while not stop.is_set():
+            seen.append(d["counter"])
+
+    threads = [threading.Thread(target=writer) for _ in range(2)]
+    watcher = threading.Thread(target=reader)
+    watcher.start()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    b.flush()
+    stop.set()
+    watcher.join()
+
+    assert d["counter"] == next_value[0] - 1
+    assert seen == sorted(seen)
+
+    d.close()
+    d.unlink()
@@ -0,0 +1,81 @@
+"""
+Test the optional Bloom filter of SharedDict
+"""
+
+import multiprocessing as mp
+
+from sharedbox import SharedDict
+
+
+def test_filter_keeps_every_key() -> None:
+    """Keys present are always found; absent keys are reported missing"""
+    d = SharedDict("bloom_keys", size=32 * 1024 * 1024, create=True, bloom_capacity=10_000)
+
+    for i in range(10_000):
+        d[f"key_{i}"] = i
+    assert all(f"key_{i}" in d for i in range(10_000))
+    assert d.get_many(["key_1", "absent", 7]) == [1, None, None]
+    assert sum(f"absent_{i}" in d for i in range(10_000)) == 0
+
+    with d.writer("streamed") as w:
+        w.write(b"data")
+    assert d["streamed"] == b"data"
+
+    d.close()
+    d.unlink()
+
+
+def test_filter_stats_and_compact() -> None:
+    """get_stats() reports the filter; compact() clears bits of erased keys"""
+    d = SharedDict("bloom_stats", size=32 * 1024 * 1024, create=True, bloom_capacity=10_000)
+
+    stats = d.get_stats()
+    assert stats["bloom_filter_bits"] >= 10_000 * 10
+    assert stats["bloom_fill_ratio"] == 0.0
+
+    for i in range(10_000):
+        d[i] = i
+    full = d.get_stats()
+    assert 0.0 < full["bloom_false_positive_rate"] < 0.05
+
+    for i in range(0, 10_000, 2):
+        del d[i]
+    assert d.get_stats()["bloom_fill_ratio"] == full["bloom_fill_ratio"]
+    d.compact()
+    assert d.get_stats()["bloom_fill_ratio"] < full["bloom_fill_ratio"]
+    assert all(i in d for i in range(1, 10_000, 2))
+    assert not any(i in d for i in range(0, 10_000, 2))
+
+    d.close()
+    d.unlink()
+
+
+def test_without_filter() -> None:
+    """The filter is off by default"""
+    d = SharedDict("bloom_off", size=10 * 1024 * 1024, create=True)
+    d["a"] = 1
+    assert d.get_stats()["bloom_filter_bits"] == 0
+    assert d.get_stats()["bloom_false_positive_rate"] == 0.0
+    d.close()
+    d.unlink()
+
+
+def bloom_worker(dict_name: str, worker_id: int) -> bool:
+    """Write keys from a child process attached without bloom_capacity"""
+    d = SharedDict(dict_name, create=False)
+    for i in range(200):
+        d[f"w{worker_id}_{i}"] = i
+    d.close()
+    return True
+
+
+def test_filter_across_processes() -> None:
+    """Writers in other processes maintain the creator's filter"""
+    d = SharedDict("bloom_multiprocess", size=10 * 1024 * 1024, create=True, bloom_capacity=1000)
+
+    with mp.Pool(2) as pool:
+        assert all(pool.starmap(bloom_worker, [("bloom_multiprocess", i) for i in range(2)]))
+    assert all(f"w{w}_{i}" in d for w in range(2) for i in range(200))
+
+    d.close()
+    d.unlink()
@@ -0,0 +1,78 @@
+"""
+Test bytes-like keys in SharedDict
+"""
+
+import hashlib
+
+import pytest
+
+from sharedbox import SharedDict
+
+
+def test_bytes_key_roundtrip() -> None:
+    """Bytes keys work with every keyed operation"""
+    d = SharedDict("bytes_keys_roundtrip", size=10 * 1024 * 1024, create=True)
+
+    digests = [hashlib.sha256(str(i).encode()).digest() for i in range(500)]
+    for i, digest in enumerate(digests):
+        d[digest] = i
+    assert len(d) == 500
+    assert d[digests[0]] == 0
+    assert digests[499] in d
+    assert hashlib.sha256(b"missing").digest() not in d
+    assert d.get_many([digests[1], b"nope"]) == [1, None]
+
+    d[b""] = "empty"
+    assert d[b""] == "empty"
+    assert d.erase(b"")
+    del d[digests[0]]
+    assert digests[0] not in d
+
+    d.close()
+    d.unlink()
+
+
+def test_bytes_like_types_share_keys() -> None:
+    """bytes, bytearray and memoryview with equal contents are one key"""
+    d = SharedDict("bytes_keys_shared", size=10 * 1024 * 1024, create=True)
+
+    d[b"key"] = 1
+    assert d[bytearray(b"key")] == 1
+    assert d[memoryview(b"key")] == 1
+    d[memoryview(bytearray(b"key"))] = 2
+    assert d[b"key"] == 2
+    assert len(d) == 1
+
+    with pytest.raises(TypeError):
+        d[memoryview(b"abcdef")[::2]] = "strided"
+
+    d.close()
+    d.unlink()
+
+
+def test_bytes_keys_are_distinct_from_str_and_int() -> None:
+    """b"1", "1" and 1 are different keys, and keys() keeps their types"""
+    d = SharedDict("bytes_keys_distinct", size=10 * 1024 * 1024, create=True)
+
+    long_key = bytes(range(256)) * 4
+    d[b"1"] = "bytes"
+    d["1"] = "str"
+    d[1] = "int"
+    d[long_key] = "long"
+    assert (d[b"1"], d["1"], d[1], d[long_key]) == ("bytes", "str", "int", "long")
+
+    keys = d.keys()
+    assert sorted(k for k in keys if isinstance(k, bytes)) == [b"1", long_key]
+    assert {type(k) for k in keys} == {bytes, str, int}
+
+    d.close()
+    d.unlink()
+
+
+def test_bytes_keys_in_initial_data() -> None:
+    """Bytes keys are accepted by the data= argument"""
+    d = SharedDict("bytes_keys_init", size=10 * 1024 * 1024, create=True, data={b"\x00\xff": "binary"})
+    assert d[b"\x00\xff"] == "binary"
+    assert d.keys() == [b"\x00\xff"]
+    d.close()
+    d.unlink()
@@ -0,0 +1,157 @@
+"""
+Test the cache mode (max_entries / eviction_policy) of SharedDict
+"""
+
+import multiprocessing as mp
+import random
+
+import pytest
+
+from sharedbox import SharedDict
+
+
+def test_lru_evicts_least_recently_used() -> None:
+    """With one stripe, LRU evicts exactly the entry used longest ago"""
+    d = SharedDict("cache_lru", size=10 * 1024 * 1024, create=True, max_keys=1, max_entries=3)
+
+    d["a"] = 1
+    d["b"] = 2
+    d["c"] = 3
+    assert d["a"] == 1
+    d["d"] = 4
+    assert "b" not in d
+    assert sorted(d.keys()) == ["a", "c", "d"]
+
+    d["c"] = 30  # updates count as uses too
+    d["e"] = 5
+    assert "a" not in d
+    assert d["c"] == 30
+
+    stats = d.get_stats()
+    assert stats["eviction_policy"] == "lru"
+    assert stats["max_entries"] == 3
+    assert stats["evictions"] == 2
+    assert stats["hits"] == 2
+
+    d.close()
+    d.unlink()
+
+
+def test_size_stays_bounded() -> None:
+    """Neither policy lets the dictionary outgrow max_entries"""
+    for policy in ("lru", "tinylfu"):
+        d = SharedDict(f"cache_bound_{policy}", size=32 * 1024 * 1024, create=True,
+                       max_keys=8, max_entries=800, eviction_policy=policy)
+        for i in range(10_000):
+            d[i] = i
+        assert len(d) <= 800
+        assert len(d) == len(d.keys())
+        stats = d.get_stats()
+        assert stats["evictions"] == 10_000 - len(d)
+        d.compact()
+        assert all(d[k] == k for k in d.keys())
+        d.close()
+        d.unlink()
+
+
+def zipf_trace(length: int, keys: int, seed: int) -> list[int]:
+    """Skewed accesses interrupted by scans of keys seen only once"""
+    rng = random.Random(seed)
+    weights = [1.0 / (i + 1) for i in range(keys)]
+    trace = rng.choices(range(keys), weights=weights, k=length)
+    scan = keys
+    for start in range(0, length, length // 10):
+        trace[start:start] = range(scan, scan + 1000)
+        scan += 1000
+    return trace
+
+
+def hit_rate(policy: str, trace: list[int]) -> float:
+    d = SharedDict(f"cache_rate_{policy}", size=32 * 1024 * 1024, create=True,
+                   max_keys=4, max_entries=500, eviction_policy=policy)
+    for key in trace:
+        if d.get(key) is None:
+            d[key] = key
+    stats = d.get_stats()
+    assert stats["hits"] + stats["misses"] == len(trace)
+    d.close()
+    d.unlink()
+    return stats["hit_rate"]
+
+
+def test_tinylfu_resists_scans() -> None:
+    """W-TinyLFU keeps the popular keys through scans that flush LRU"""
+    trace = zipf_trace(50_000, 20_000, seed=7)
+    lru = hit_rate("lru", trace)
+    tinylfu = hit_rate("tinylfu", trace)
+    assert tinylfu > lru
+
+
+def test_tinylfu_rejects_one_off_keys() -> None:
+    """Once the cache is full of hot keys, a new key is turned away"""
+    d = SharedDict("cache_reject", size=10 * 1024 * 1024, create=True,
+                   max_keys=1, max_entries=100, eviction_policy="tinylfu")
+    for _ in range(5):
+        for i in range(100):
+            if d.get(i) is None:
+                d[i] = i
+    d["once"] = 1
+    d["twice"] = 2
+
+    stats = d.get_stats()
+    assert stats["admissions_rejected"] >= 1
+    assert len(d) == 100
+    assert sum(i in d for i in range(100)) >= 99
+
+    d.close()
+    d.unlink()
+
+
+def test_invalid_policy() -> None:
+    """Unknown policy names are rejected"""
+    with pytest.raises(ValueError):
+        SharedDict("cache_invalid", size=10 * 1024 * 1024, create=True, max_entries=10, eviction_policy="fifo")
+
+
+def test_not_a_cache_by_default() -> None:
+    """Without max_entries nothing is evicted and the counters stay at 0"""
+    d = SharedDict("cache_off", size=10 * 1024 * 1024, create=True, max_keys=1)
+    for i in range(1000):
+        d[i] = i
+    assert d.get(5000) is None
+    stats = d.get_stats()
+    assert len(d) == 1000
+    assert stats["eviction_policy"] == "none"
+    assert stats["misses"] == 0
+    assert stats["evictions"] == 0
+
+    d.close()
+    d.unlink()
+
+
+def cache_worker(dict_name: str, worker_id: int) -> int:
+    """Read through the cache from a child process"""
+    d = SharedDict(dict_name, create=False)
+    for i in range(200):
+        key = (worker_id * 37 + i) % 300
+        if d.get(key) is None:
+            d[key] = key
+    d.close()
+    return 200
+
+
+def test_stats_shared_across_processes() -> None:
+    """Counters and the sketch live in the segment, so every process adds to them"""
+    d = SharedDict("cache_multiprocess", size=32 * 1024 * 1024, create=True,
+                   max_entries=100, eviction_policy="tinylfu")
+
+    with mp.Pool(3) as pool:
+        lookups = sum(pool.starmap(cache_worker, [("cache_multiprocess", i) for i in range(3)]))
+
+    stats = d.get_stats()
+    assert stats["hits"] + stats["misses"] == lookups
+    assert stats["eviction_policy"] == "tinylfu"
+    assert len(d) <= stats["max_entries"]
+
+    d.close()
+    d.unlink()
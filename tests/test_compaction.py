@@ -0,0 +1,92 @@
+"""
+Test heap statistics and online compaction
+"""
+
+import random
+import threading
+
+from sharedbox import SharedDict
+
+
+def fragment(d: SharedDict, seed: int = 0) -> list[str]:
+    """Fill the dict with mixed-size values, then delete a random half"""
+    rng = random.Random(seed)
+    keys = [f"key_{i}" for i in range(2000)]
+    for key in keys:
+        d[key] = b"x" * rng.randint(500, 3500)
+    survivors = []
+    for key in keys:
+        if rng.random() < 0.5:
+            del d[key]
+        else:
+            survivors.append(key)
+    return survivors
+
+
+def test_memory_stats() -> None:
+    """Usage statistics are consistent on a fresh segment"""
+    d = SharedDict("compact_stats", size=10 * 1024 * 1024, create=True)
+    stats = d.get_stats()
+
+    assert 0 < stats["free_bytes"] <= stats["segment_bytes"]
+
+    d.close()
+    d.unlink()
+
+
+def test_compact_preserves_contents() -> None:
+    """Compaction relocates entries without changing them"""
+    d = SharedDict("compact_contents", size=16 * 1024 * 1024, create=True, max_keys=16)
+    survivors = fragment(d)
+    expected = {key: d[key] for key in survivors}
+
+    assert d.compact() == len(survivors)
+
+    assert len(d) == len(survivors)
+    assert {key: d[key] for key in survivors} == expected
+
+    d.close()
+    d.unlink()
+
+
+def test_compact_while_in_use() -> None:
+    """Readers and writers keep working while a compaction runs"""
+    d = SharedDict("compact_concurrent", size=32 * 1024 * 1024, create=True, max_keys=16)
+    survivors = fragment(d, seed=1)
+    stop = threading.Event()
+    errors: list[Exception] = []
+
+    def reader() -> None:
+        try:
+            while not stop.is_set():
+                for key in survivors[:50]:
+                    assert d[key].startswith(b"x")
+        except Exception as e:
+            errors.append(e)
+
+    def writer() -> None:
+        try:
+            i = 0
+            while not stop.is_set():
+                d[f"live_{i % 100}"] = i
+                i += 1
+        except Exception as e:
+            errors.append(e)
+
+    threads = [threading.Thread(target=reader), threading.Thread(target=writer)]
+    for t in threads:
+        t.start()
+    try:
+        for _ in range(3):
+            d.compact()
+    finally:
+        stop.set()
+        for t in threads:
+            t.join()
+
+    assert not errors
+    for key in survivors:
+        assert d[key].startswith(b"x")
+
+    d.close()
+    d.unlink()
@@ -0,0 +1,92 @@
+"""
+Test vectorized int key lookups into numpy arrays
+"""
+
+import numpy as np
+import pytest
+
+from sharedbox import SharedDict
+
+
+def test_float_values_and_mask() -> None:
+    """Found values land in the output array, missing ones stay 0"""
+    d = SharedDict("numpy_lookup_float", size=10 * 1024 * 1024, create=True)
+
+    for i in range(0, 1000, 2):
+        d[i] = i * 0.5
+    ids = np.arange(1000, dtype=np.int64)
+    values, found = d.get_many_numpy(ids)
+
+    assert values.dtype == np.float64 and found.dtype == np.bool_
+    assert found.tolist() == [i % 2 == 0 for i in range(1000)]
+    np.testing.assert_array_equal(values[found], ids[found] * 0.5)
+    assert not values[~found].any()
+
+    d.close()
+    d.unlink()
+
+
+def test_output_dtypes() -> None:
+    """bool, int and float values are cast to the requested dtype"""
+    d = SharedDict("numpy_lookup_dtypes", size=10 * 1024 * 1024, create=True)
+
+    d[1] = True
+    d[2] = -(2**62)
+    d[3] = 2.5
+    ids = np.array([1, 2, 3, 4], dtype=np.int64)
+
+    values, found = d.get_many_numpy(ids, dtype=np.float64)
+    assert values.tolist() == [1.0, float(-(2**62)), 2.5, 0.0]
+    assert found.tolist() == [True, True, True, False]
+
+    values, found = d.get_many_numpy(ids[:2], dtype="int64")
+    assert values.dtype == np.int64
+    assert values.tolist() == [1, -(2**62)]
+
+    values, found = d.get_many_numpy(ids[:1], dtype=bool)
+    assert values.tolist() == [True]
+
+    with pytest.raises(TypeError):
+        d.get_many_numpy(ids, dtype=np.int64)  # 2.5 does not fit
+    with pytest.raises(TypeError):
+        d.get_many_numpy(ids, dtype=np.float32)
+    with pytest.raises(TypeError):
+        d.get_many_numpy(ids, dtype=">f8" if np.little_endian else "<f8")
+    with pytest.raises(TypeError):
+        d.get_many_numpy(ids[:2], dtype=np.dtype(np.int64).newbyteorder())
+
+    d.close()
+    d.unlink()
+
+
+def test_non_numeric_values_and_other_keys() -> None:
+    """Non-numeric values raise; str keys are never matched by ids"""
+    d = SharedDict("numpy_lookup_mixed", size=10 * 1024 * 1024, create=True)
+
+    d["5"] = 5.0
+    values, found = d.get_many_numpy(np.array([5], dtype=np.int64))
+    assert not found[0]
+
+    d[5] = "five"
+    with pytest.raises(TypeError):
+        d.get_many_numpy(np.array([5], dtype=np.int64))
+
+    values, found = d.get_many_numpy(np.array([], dtype=np.int64))
+    assert values.shape == (0,) and found.shape == (0,)
+
+    d.close()
+    d.unlink()
+
+
+def test_nonblocking_batch() -> None:
+    """nonblocking and timeout follow get_many()"""
+    d = SharedDict("numpy_lookup_wait", size=10 * 1024 * 1024, create=True)
+    d[1] = 1.0
+
+    values, found = d.get_many_numpy(np.array([1], dtype=np.int64), nonblocking=True)
+    assert found[0] and values[0] == 1.0
+    with pytest.raises(ValueError):
+        d.get_many_numpy(np.array([1], dtype=np.int64), timeout=1.0, nonblocking=True)
+
+    d.close()
+    d.unlink()
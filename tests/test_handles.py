@@ -0,0 +1,115 @@
+"""
+Test passing SharedDict handles to other processes
+"""
+
+import multiprocessing as mp
+import pickle
+import sys
+from concurrent.futures import ProcessPoolExecutor
+
+import pytest
+
+from sharedbox import SharedDict
+
+
+def test_pickle_round_trip_in_process() -> None:
+    """Unpickling in the same process yields a working handle to the same segment"""
+    d = SharedDict("handle_roundtrip", size=10 * 1024 * 1024, create=True)
+    d["key"] = "value"
+
+    copy = pickle.loads(pickle.dumps(d))
+    assert copy["key"] == "value"
+    copy["other"] = 1
+    assert d["other"] == 1
+
+    # Closing one handle leaves the other usable
+    copy.close()
+    assert copy.is_closed()
+    assert d["key"] == "value"
+
+    d.close()
+    d.unlink()
+
+
+def test_closed_dict_cannot_be_pickled() -> None:
+    """A closed handle refuses to be pickled"""
+    d = SharedDict("handle_closed", size=10 * 1024 * 1024, create=True)
+    d.close()
+
+    with pytest.raises(RuntimeError):
+        pickle.dumps(d)
+
+    d.unlink()
+
+
+def test_recreated_segment_is_detected() -> None:
+    """A handle to an unlinked segment does not silently attach to its replacement"""
+    d = SharedDict("handle_recreated", size=10 * 1024 * 1024, create=True)
+    state = pickle.dumps(d)
+    d.close()
+    d.unlink()
+    del d
+
+    replacement = SharedDict("handle_recreated", size=10 * 1024 * 1024, create=True)
+    with pytest.raises(RuntimeError, match="recreated"):
+        pickle.loads(state)
+
+    replacement.close()
+    replacement.unlink()
+
+
+def square_into(d: SharedDict, i: int) -> int:
+    """Store a result through a handle received as an argument"""
+    d[f"result_{i}"] = i * i
+    return d[f"input_{i}"]
+
+
+@pytest.mark.parametrize(
+    "method",
+    [
+        pytest.param(
+            "fork",
+            marks=pytest.mark.skipif(sys.platform == "win32", reason="fork is not available"),
+        ),
+        "spawn",
+    ],
+)
+def test_handles_passed_to_pool(method: str) -> None:
+    """Workers receive the dict itself instead of reopening it by name"""
+    d = SharedDict(f"handle_pool_{method}", size=10 * 1024 * 1024, create=True)
+    for i in range(8):
+        d[f"input_{i}"] = i
+
+    ctx = mp.get_context(method)
+    with ProcessPoolExecutor(max_workers=2, mp_context=ctx) as pool:
+        assert list(pool.map(square_into, [d] * 8, range(8))) == list(range(8))
+
+    for i in range(8):
+        assert d[f"result_{i}"] == i * i
+
+    d.close()
+    d.unlink()
+
+
+def inherited_worker() -> None:
+    """Use the module-level dict inherited through fork()"""
+    INHERITED["child"] = "hello from child"
+
+
+INHERITED: SharedDict
+
+
+@pytest.mark.skipif(sys.platform == "win32", reason="fork is not available")
+def test_dict_inherited_through_fork() -> None:
+    """A dict created before fork() keeps working in the child"""
+    global INHERITED
+    INHERITED = SharedDict("handle_inherited", size=10 * 1024 * 1024, create=True)
+
+    proc = mp.get_context("fork").Process(target=inherited_worker)
+    proc.start()
+    proc.join()
+    assert proc.exitcode == 0
+    assert INHERITED["child"] == "hello from child"
+
+    INHERITED.close()
+    INHERITED.unlink()
@@ -106,12 +106,12 @@ class TestSharedDictInitialization:
         with pytest.raises(TypeError, match="Argument 'data' has incorrect type"):
             SharedDict(name, "not a dict", create=True)
 
-        # Test with non-string keys
-        with pytest.raises(TypeError, match="All keys must be strings"):
-            SharedDict(name, {123: "invalid key type"}, create=True)
+        # Test with unsupported key types
+        with pytest.raises(TypeError, match="All keys must be str, int"):
+            SharedDict(name, {1.5: "invalid key type"}, create=True)
 
-        with pytest.raises(TypeError, match="All keys must be strings"):
-            SharedDict(name, {"valid": "value", 456: "invalid"}, create=True)
+        with pytest.raises(TypeError, match="All keys must be str, int"):
+            SharedDict(name, {"valid": "value", (4, 5, 6): "invalid"}, create=True)
 
     def test_initialization_partial_failure(self, cleanup_names):
         """Test behavior when initialization fails partway through."""
@@ -180,6 +180,63 @@ class TestSharedDictInitialization:
         shared_dict.close()
         shared_dict.unlink()
 
+    def test_initialization_with_many_entries(self, cleanup_names):
+        """Bulk loading spans several batches and every value encoding"""
+        name = "test_bulk_init"
+        cleanup_names.append(name)
+
+        n = 200_000
+        data = {}
+        for i in range(n):
+            kind = i % 6
+            if kind == 0:
+                data[i] = i * 3
+            elif kind == 1:
+                data[f"key_{i}"] = f"value_{i}"
+            elif kind == 2:
+                data[str(i).encode()] = float(i)
+            elif kind == 3:
+                data[f"key_{i}"] = {"id": i}
+            elif kind == 4:
+                data[f"key_{i}"] = None
+            else:
+                data[f"key_{i}"] = b"x" * (i % 100)
+        data["array"] = np.arange(10)
+        data["nested"] = {"weights": np.ones(1000)}  # pickled with out-of-band buffers
+
+        shared_dict = SharedDict(name, data, create=True, size=256 * 1024 * 1024)
+
+        assert len(shared_dict) == len(data)
+        for key in list(data)[::997]:
+            assert shared_dict[key] == data[key]
+        assert np.array_equal(shared_dict["array"], np.arange(10))
+        assert np.array_equal(shared_dict["nested"]["weights"], np.ones(1000))
+
+        shared_dict.close()
+        shared_dict.unlink()
+
+    def test_initialization_failure_keeps_earlier_batches(self, cleanup_names):
+        """Entries before a failing value are stored, even across batches"""
+        name = "test_bulk_partial_init"
+        cleanup_names.append(name)
+
+        class UnserializableObject:
+            def __reduce__(self):
+                raise RuntimeError("Cannot serialize this object")
+
+        data = {f"key_{i}": i for i in range(100_000)}
+        data["bad_key"] = UnserializableObject()
+        data["after"] = 1
+
+        with pytest.raises(ValueError, match="after 100000 items"):
+            SharedDict(name, data, create=True, size=64 * 1024 * 1024)
+
+        shared_dict = SharedDict(name, create=False)
+        assert len(shared_dict) == 100_000
+        assert "after" not in shared_dict
+        shared_dict.close()
+        shared_dict.unlink()
+
     def test_initialization_mixed_with_existing_operations(self, cleanup_names):
         """Test that initialized SharedDict works normally with all operations."""
         name = "test_mixed_ops"
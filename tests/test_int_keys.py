@@ -0,0 +1,124 @@
+"""
+Test integer keys in SharedDict
+"""
+
+import multiprocessing as mp
+
+import pytest
+
+from sharedbox import SharedDict
+
+
+def test_int_key_roundtrip() -> None:
+    """Int keys work with every keyed operation"""
+    d = SharedDict("int_keys_roundtrip", size=10 * 1024 * 1024, create=True)
+
+    for i in range(1000):
+        d[i] = i * 2
+    assert len(d) == 1000
+    assert d[0] == 0
+    assert d[999] == 1998
+    assert 500 in d
+    assert 1000 not in d
+
+    d.set(-1, "negative")
+    assert d.get(-1) == "negative"
+    assert d.get(12345, "missing") == "missing"
+    assert d.get_many([1, 2, 5000]) == [2, 4, None]
+
+    del d[0]
+    assert 0 not in d
+    assert d.erase(1)
+    assert not d.erase(1)
+
+    d.close()
+    d.unlink()
+
+
+def test_int_and_str_keys_are_distinct() -> None:
+    """1 and "1" are different keys, like in a dict"""
+    d = SharedDict("int_keys_distinct", size=10 * 1024 * 1024, create=True)
+
+    d[1] = "int"
+    d["1"] = "str"
+    assert d[1] == "int"
+    assert d["1"] == "str"
+    assert len(d) == 2
+
+    d.close()
+    d.unlink()
+
+
+def test_keys_keep_their_type() -> None:
+    """keys() and items() return ints for int keys and strs for str keys"""
+    d = SharedDict("int_keys_types", size=10 * 1024 * 1024, create=True)
+
+    extremes = [-(2**63), -1, 0, 2**63 - 1]
+    for key in extremes:
+        d[key] = key
+    d["name"] = "value"
+
+    keys = d.keys()
+    assert sorted(k for k in keys if isinstance(k, int)) == extremes
+    assert [k for k in keys if isinstance(k, str)] == ["name"]
+    assert dict(d.items()) == {**{k: k for k in extremes}, "name": "value"}
+
+    d.close()
+    d.unlink()
+
+
+def test_unsupported_keys() -> None:
+    """Keys that are neither str nor int64 are rejected"""
+    d = SharedDict("int_keys_unsupported", size=10 * 1024 * 1024, create=True)
+
+    for key in (2**63, -(2**63) - 1, 1.5, (1, 2)):
+        with pytest.raises(TypeError):
+            d[key] = "value"
+    assert len(d) == 0
+
+    with pytest.raises(KeyError) as excinfo:
+        d[42]
+    assert excinfo.value.args == (42,)
+
+    d.close()
+    d.unlink()
+
+
+def test_int_keys_with_local_cache() -> None:
+    """Cached reads of int keys see writes through other handles"""
+    d = SharedDict("int_keys_cache", size=10 * 1024 * 1024, create=True, local_cache_size=16)
+    other = SharedDict("int_keys_cache", create=False)
+
+    d[7] = "old"
+    assert d[7] == "old"
+    other[7] = "new"
+    assert d[7] == "new"
+
+    other.close()
+    d.close()
+    d.unlink()
+
+
+def int_key_worker(dict_name: str, worker_id: int) -> bool:
+    """Write int keys from a child process"""
+    d = SharedDict(dict_name, create=False)
+    for i in range(100):
+        d[worker_id * 100 + i] = worker_id
+    d.close()
+    return True
+
+
+def test_int_keys_across_processes() -> None:
+    """Int keys written by children are found by the parent"""
+    d = SharedDict("int_keys_multiprocess", size=10 * 1024 * 1024, create=True)
+
+    with mp.Pool(3) as pool:
+        results = pool.starmap(int_key_worker, [("int_keys_multiprocess", i) for i in range(3)])
+    assert all(results)
+
+    assert len(d) == 300
+    for i in range(300):
+        assert d[i] == i // 100
+
+    d.close()
+    d.unlink()
@@ -0,0 +1,171 @@
+"""
+Test the process-local cache of decoded values
+"""
+
+import multiprocessing as mp
+
+import numpy as np
+import pytest
+
+from sharedbox import SharedDict
+
+
+def test_cache_hits_return_same_object() -> None:
+    """Repeated reads of an unchanged immutable value are served from the cache"""
+    d = SharedDict("cache_hits", size=10 * 1024 * 1024, create=True, local_cache_size=16)
+    d["config"] = "threshold=3"
+
+    first = d["config"]
+    second = d["config"]
+    assert first == "threshold=3"
+    assert second is first
+
+    stats = d.get_stats()
+    assert stats["local_cache_hits"] >= 1
+    assert stats["local_cache_entries"] >= 1
+
+    d.close()
+    d.unlink()
+
+
+def test_cached_values_are_not_shared_mutably() -> None:
+    """Changing a value read through the cache never changes later reads"""
+    d = SharedDict("cache_mutable", size=10 * 1024 * 1024, create=True, local_cache_size=16)
+    d["list"] = [1, 2]
+    d["nested"] = {"arr": np.arange(3)}  # pickled with an out-of-band buffer
+    d["arr"] = np.arange(4)
+
+    for _ in range(2):  # a miss, then a hit
+        d["list"].append(3)
+        d["nested"]["arr"][0] = 100
+    assert d["list"] == [1, 2]
+    np.testing.assert_array_equal(d["nested"]["arr"], np.arange(3))
+    assert d["list"] is not d["list"]
+
+    for _ in range(2):
+        arr = d["arr"]
+        arr[0] = 100
+    np.testing.assert_array_equal(d["arr"], np.arange(4))
+    assert d["arr"] is not d["arr"]
+    assert d.get_stats()["local_cache_hits"] >= 4
+
+    d.close()
+    d.unlink()
+
+
+@pytest.mark.parametrize("cache_size", [0, 16])
+def test_cache_keeps_writability(cache_size: int) -> None:
+    """Reads return writable, unshared arrays whether or not the cache is on"""
+    d = SharedDict(f"cache_writable_{cache_size}", size=10 * 1024 * 1024, create=True, local_cache_size=cache_size)
+    d["arr"] = np.arange(4)
+    d["nested"] = {"arr": np.arange(3)}
+
+    for _ in range(3):  # with the cache on, a miss and then hits
+        for arr in (d["arr"], d["nested"]["arr"], d.get_many(["arr"])[0]):
+            assert arr.flags.writeable
+            assert arr is not d["arr"]
+    if cache_size:
+        assert d.get_stats()["local_cache_hits"] >= 6
+
+    d.close()
+    d.unlink()
+
+
+def test_cache_invalidated_by_local_writes() -> None:
+    """Writes and deletes through the same handle are seen immediately"""
+    d = SharedDict("cache_local_writes", size=10 * 1024 * 1024, create=True, local_cache_size=16)
+    d["key"] = 1
+    assert d["key"] == 1
+
+    d["key"] = 2
+    assert d["key"] == 2
+    assert d.get_many(["key"]) == [2]
+
+    del d["key"]
+    assert d.get("key") is None
+    assert "key" not in d
+
+    d.close()
+    d.unlink()
+
+
+def test_cache_invalidated_by_other_handles() -> None:
+    """Writes through another attachment bump the shared stripe version"""
+    writer = SharedDict("cache_other_handle", size=10 * 1024 * 1024, create=True)
+    reader = SharedDict("cache_other_handle", create=False, local_cache_size=16)
+
+    writer["arr"] = np.arange(4)
+    np.testing.assert_array_equal(reader["arr"], np.arange(4))
+
+    writer["arr"] = np.arange(8)
+    np.testing.assert_array_equal(reader["arr"], np.arange(8))
+
+    reader.close()
+    writer.close()
+    writer.unlink()
+
+
+def test_get_many_uses_cache() -> None:
+    """get_many() serves hits from the cache, reads the rest in one batch and caches them"""
+    writer = SharedDict("cache_get_many", size=10 * 1024 * 1024, create=True, max_keys=8)
+    reader = SharedDict("cache_get_many", create=False, local_cache_size=64)
+    for i in range(40):
+        writer[i] = {"id": i} if i % 3 == 0 else i
+    keys = list(range(0, 50, 2)) + [3, 3]
+
+    def expected() -> list:
+        return [reader.get(k, "absent") for k in keys]
+
+    assert reader.get_many(keys, default="absent") == expected()
+    hits = reader.get_stats()["local_cache_hits"]
+    assert reader.get_many(keys[:10]) == [reader[k] for k in keys[:10]]
+    assert reader.get_stats()["local_cache_hits"] >= hits + 10
+
+    writer[4] = "changed"
+    del writer[6]
+    writer[48] = 48
+    result = reader.get_many(keys, default="absent")
+    assert result[2:5] == ["changed", "absent", 8]
+    assert result[24] == 48
+    assert result == expected()
+
+    reader.close()
+    writer.close()
+    writer.unlink()
+
+
+def test_cache_is_bounded() -> None:
+    """The cache never holds more entries than requested"""
+    d = SharedDict("cache_bounded", size=10 * 1024 * 1024, create=True, local_cache_size=4)
+    for i in range(20):
+        d[f"key_{i}"] = i
+    for i in range(20):
+        assert d[f"key_{i}"] == i
+
+    assert d.get_stats()["local_cache_entries"] <= 4
+
+    d.close()
+    d.unlink()
+
+
+def bump_worker(dict_name: str) -> bool:
+    """Overwrite a key from a child process"""
+    d = SharedDict(dict_name, create=False)
+    d["flag"] = "updated"
+    d.close()
+    return True
+
+
+def test_cache_invalidated_across_processes() -> None:
+    """Writes from another process invalidate the cached value"""
+    d = SharedDict("cache_multiprocess", size=10 * 1024 * 1024, create=True, local_cache_size=16)
+    d["flag"] = "initial"
+    assert d["flag"] == "initial"
+
+    with mp.Pool(1) as pool:
+        assert pool.apply(bump_worker, ("cache_multiprocess",))
+
+    assert d["flag"] == "updated"
+
+    d.close()
+    d.unlink()
@@ -0,0 +1,81 @@
+"""
+Test the timeout= and nonblocking= variants of SharedDict operations
+"""
+
+import threading
+
+import numpy as np
+import pytest
+
+from sharedbox import LockTimeout, SharedDict
+
+
+def test_bounded_operations_without_contention() -> None:
+    """Bounded operations behave like their blocking counterparts on free stripes"""
+    d = SharedDict("timeout_basic", size=10 * 1024 * 1024, create=True)
+
+    d.set("a", 1, timeout=0.1)
+    d.set("b", "two", nonblocking=True)
+    assert d.get("a", timeout=0.1) == 1
+    assert d.get("b", nonblocking=True) == "two"
+    assert d.get("missing", "default", timeout=0) == "default"
+    assert d.get_many(["a", "missing"], timeout=0.1) == [1, None]
+    assert sorted(d.keys(nonblocking=True)) == ["a", "b"]
+
+    assert d.erase("a", timeout=0.1) is True
+    assert d.erase("a", nonblocking=True) is False
+    assert "a" not in d
+
+    assert d.get_stats()["lock_timeouts"] == 0
+
+    d.close()
+    d.unlink()
+
+
+def test_invalid_wait_arguments() -> None:
+    """Arguments are validated like threading.Lock.acquire()"""
+    d = SharedDict("timeout_invalid", size=10 * 1024 * 1024, create=True)
+
+    with pytest.raises(ValueError):
+        d.get("a", timeout=1.0, nonblocking=True)
+    with pytest.raises(ValueError):
+        d.set("a", 1, timeout=-1.0)
+
+    d.close()
+    d.unlink()
+
+
+def test_lock_timeout_is_timeout_error() -> None:
+    """Callers can catch the built-in TimeoutError"""
+    assert issubclass(LockTimeout, TimeoutError)
+
+
+def test_timeouts_are_counted_under_contention() -> None:
+    """Every LockTimeout raised is reflected in get_stats()"""
+    d = SharedDict("timeout_contention", size=64 * 1024 * 1024, create=True, max_keys=1)
+    stop = threading.Event()
+    payload = np.zeros(1024 * 1024, dtype=np.uint8)
+
+    def writer() -> None:
+        while not stop.is_set():
+            d["big"] = payload
+
+    thread = threading.Thread(target=writer)
+    thread.start()
+
+    raised = 0
+    try:
+        for _ in range(2000):
+            try:
+                d.get("small", nonblocking=True)
+            except LockTimeout:
+                raised += 1
+    finally:
+        stop.set()
+        thread.join()
+
+    assert d.get_stats()["lock_timeouts"] == raised
+    assert d.get("big", timeout=1.0).nbytes == payload.nbytes
+
+    d.close()
+    d.unlink()
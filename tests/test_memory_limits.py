@@ -0,0 +1,161 @@
+"""
+Test the soft memory limit (high_water_mark) of SharedDict
+"""
+
+import multiprocessing as mp
+import threading
+
+import numpy as np
+import pytest
+
+from sharedbox import MemoryPressure, SharedDict
+
+
+def test_writes_past_the_mark_are_refused() -> None:
+    """Without cache mode, a write that would cross the mark raises MemoryPressure"""
+    d = SharedDict("limit_refuse", size=4 * 1024 * 1024, create=True, high_water_mark=0.5)
+
+    value = b"x" * 100_000
+    stored = 0
+    with pytest.raises(MemoryPressure):
+        for i in range(100):
+            d[i] = value
+            stored += 1
+    assert 0 < stored < 40
+    assert len(d) == stored
+
+    stats = d.get_stats()
+    assert stats["high_water_bytes"] == pytest.approx(stats["segment_bytes"] * 0.5, rel=0.01)
+    assert stats["segment_bytes"] - stats["free_bytes"] <= stats["high_water_bytes"]
+    assert stats["soft_limit_rejections"] == 1
+
+    # MemoryPressure is a MemoryError, and room frees up again after erasing
+    with pytest.raises(MemoryError):
+        d.set("more", value)
+    del d[0]
+    d["more"] = value
+    assert d["more"] == value
+
+    d.close()
+    d.unlink()
+
+
+def test_cache_mode_evicts_under_pressure() -> None:
+    """In cache mode the stripe's least recently used entries make room"""
+    d = SharedDict("limit_evict", size=4 * 1024 * 1024, create=True, max_keys=1,
+                   max_entries=1_000_000, high_water_mark=0.5)
+
+    value = b"x" * 100_000
+    for i in range(100):
+        d[i] = value
+    assert 99 in d
+    assert 0 not in d
+
+    stats = d.get_stats()
+    assert stats["soft_limit_evictions"] == 100 - len(d)
+    assert stats["soft_limit_rejections"] == 0
+
+    # Larger than the whole allowance: refused without evicting anything
+    with pytest.raises(MemoryPressure):
+        d["huge"] = b"y" * 3 * 1024 * 1024
+    assert len(d) == 100 - stats["soft_limit_evictions"]
+
+    d.close()
+    d.unlink()
+
+
+def test_callback() -> None:
+    """on_memory_pressure is called with the dictionary before the error is raised"""
+    calls = []
+    d = SharedDict("limit_callback", size=4 * 1024 * 1024, create=True, high_water_mark=0.5,
+                   on_memory_pressure=calls.append)
+
+    with pytest.raises(MemoryPressure):
+        d["big"] = b"x" * 3 * 1024 * 1024
+    assert calls == [d]
+
+    d["small"] = 1
+    assert calls == [d]
+
+    d.close()
+    d.unlink()
+
+
+def test_streamed_values_meet_the_limit() -> None:
+    """Out-of-band pickles and writer() values larger than the heap raise MemoryPressure, not MemoryError"""
+    calls = []
+    d = SharedDict("limit_streamed", size=4 * 1024 * 1024, create=True, high_water_mark=0.5,
+                   on_memory_pressure=calls.append)
+
+    with pytest.raises(MemoryPressure):
+        d["nested"] = {"arr": np.zeros(5 * 1024 * 1024, dtype=np.uint8)}  # pickled out of band
+    assert calls == [d]
+
+    with pytest.raises(MemoryPressure):
+        with d.writer("streamed") as w:
+            for _ in range(80):
+                w.write(b"x" * 64 * 1024)
+    assert calls == [d, d]
+
+    with pytest.raises(MemoryPressure):
+        d.writer("hinted", size_hint=5 * 1024 * 1024)
+    assert calls == [d, d, d]
+
+    assert "nested" not in d and "streamed" not in d
+    d["small"] = {"arr": np.arange(10)}
+    assert d.get_stats()["soft_limit_rejections"] == 3
+
+    d.close()
+    d.unlink()
+
+
+def test_no_limit_by_default() -> None:
+    """Without a mark the soft limit is off"""
+    d = SharedDict("limit_off", size=10 * 1024 * 1024, create=True)
+    d["a"] = 1
+    stats = d.get_stats()
+    assert stats["high_water_bytes"] == 0
+    assert stats["soft_limit_rejections"] == 0
+
+    with pytest.raises(ValueError):
+        SharedDict("limit_invalid", size=10 * 1024 * 1024, create=True, high_water_mark=1.5)
+
+    d.close()
+    d.unlink()
+
+
+def stats_loop(dict_name: str, stop) -> None:
+    """Read statistics until stop is set, from a thread or a child process"""
+    d = SharedDict(dict_name, create=False)
+    while not stop.is_set():
+        d.get_stats()
+    d.close()
+
+
+@pytest.mark.parametrize("reader", ["thread", "process"])
+def test_stats_do_not_cause_pressure(reader: str) -> None:
+    """get_stats() running alongside writes never makes them cross the mark"""
+    name = f"limit_stats_{reader}"
+    d = SharedDict(name, size=16 * 1024 * 1024, create=True, high_water_mark=0.9)
+    d["warm"] = 0
+
+    if reader == "thread":
+        stop = threading.Event()
+        worker = threading.Thread(target=stats_loop, args=(name, stop))
+    else:
+        stop = mp.Event()
+        worker = mp.Process(target=stats_loop, args=(name, stop))
+    worker.start()
+    try:
+        for i in range(50_000):
+            d[i % 1000] = b"v" * 64
+    finally:
+        stop.set()
+        worker.join()
+
+    stats = d.get_stats()
+    assert stats["segment_bytes"] - stats["free_bytes"] < stats["high_water_bytes"] / 10
+    assert stats["soft_limit_rejections"] == 0
+
+    d.close()
+    d.unlink()
@@ -0,0 +1,116 @@
+"""
+Test native (pickle-free) encodings and direct decoding in SharedDict
+"""
+
+from enum import IntEnum
+
+import numpy as np
+
+from sharedbox import SharedDict
+
+
+class Level(IntEnum):
+    """IntEnum must keep its type, so it goes through pickle."""
+
+    LOW = 1
+    HIGH = 2
+
+
+class Tag(str):
+    """str subclass must keep its type, so it goes through pickle."""
+
+
+def test_scalar_roundtrip() -> None:
+    """Built-in scalars round trip with their exact type and value"""
+    d = SharedDict("native_scalars", size=10 * 1024 * 1024, create=True)
+
+    values = {
+        "none": None,
+        "true": True,
+        "false": False,
+        "zero": 0,
+        "negative": -(2**63),
+        "positive": 2**63 - 1,
+        "float": 3.141592653589793,
+        "nan_free_inf": float("inf"),
+        "negative_zero": -0.0,
+        "empty_str": "",
+        "unicode": "héllo wörld ✓ 漢字",
+        "empty_bytes": b"",
+        "bytes": bytes(range(256)),
+    }
+    for key, value in values.items():
+        d[key] = value
+
+    for key, value in values.items():
+        restored = d[key]
+        assert type(restored) is type(value), key
+        assert restored == value, key
+
+    assert str(d["negative_zero"]) == "-0.0"
+
+    d.close()
+    d.unlink()
+
+
+def test_values_outside_native_range_use_pickle() -> None:
+    """Big ints, subclasses and unencodable strings still round trip"""
+    d = SharedDict("native_fallbacks", size=10 * 1024 * 1024, create=True)
+
+    d["big"] = 2**100
+    d["level"] = Level.HIGH
+    d["tag"] = Tag("label")
+    d["surrogate"] = "bad \udcff surrogate"
+    d["nan"] = float("nan")
+
+    assert d["big"] == 2**100
+    assert d["level"] is Level.HIGH
+    assert type(d["tag"]) is Tag and d["tag"] == "label"
+    assert d["surrogate"] == "bad \udcff surrogate"
+    assert d["nan"] != d["nan"]
+
+    d.close()
+    d.unlink()
+
+
+def test_numpy_arrays_are_writable_copies() -> None:
+    """Arrays are decoded with a single copy and do not alias the segment"""
+    d = SharedDict("native_numpy", size=10 * 1024 * 1024, create=True)
+
+    d["matrix"] = np.arange(12, dtype=np.int64).reshape(3, 4)
+    d["scalar"] = np.array(5.0)
+
+    first = d["matrix"]
+    assert first.shape == (3, 4)
+    assert first.flags.writeable
+    first[0, 0] = 100
+
+    second = d["matrix"]
+    assert second[0, 0] == 0
+
+    scalar = d["scalar"]
+    assert scalar.shape == ()
+    assert scalar == 5.0
+
+    d.close()
+    d.unlink()
+
+
+def test_overwrite_changes_encoding() -> None:
+    """A key can switch between native, numpy and pickle encodings"""
+    d = SharedDict("native_overwrite", size=10 * 1024 * 1024, create=True)
+
+    d["key"] = 1
+    assert d["key"] == 1
+    d["key"] = "one"
+    assert d["key"] == "one"
+    d["key"] = np.ones(3)
+    np.testing.assert_array_equal(d["key"], np.ones(3))
+    d["key"] = [1, "one"]
+    assert d["key"] == [1, "one"]
+    d["key"] = None
+    assert d["key"] is None
+    assert d.get("key", "default") is None
+
+    d.close()
+    d.unlink()
@@ -0,0 +1,139 @@
+"""
+Test pickle protocol 5 out-of-band buffer support in SharedDict
+"""
+
+import multiprocessing as mp
+import pickle
+
+import numpy as np
+
+from sharedbox import SharedDict
+
+
+def test_dict_of_arrays_roundtrip() -> None:
+    """Arrays nested in containers survive the out-of-band path"""
+    d = SharedDict("oob_dict_of_arrays", size=50 * 1024 * 1024, create=True)
+
+    value = {
+        "weights": np.random.rand(256, 64),
+        "bias": np.arange(64, dtype=np.int32),
+        "mask": np.array([True, False, True]),
+        "meta": {"epoch": 3, "name": "layer_0"},
+    }
+    d["model"] = value
+    restored = d["model"]
+
+    assert restored.keys() == value.keys()
+    np.testing.assert_array_equal(restored["weights"], value["weights"])
+    np.testing.assert_array_equal(restored["bias"], value["bias"])
+    np.testing.assert_array_equal(restored["mask"], value["mask"])
+    assert restored["bias"].dtype == np.int32
+    assert restored["meta"] == value["meta"]
+
+    d.close()
+    d.unlink()
+
+
+def test_out_of_band_arrays_are_writable() -> None:
+    """Restored arrays own writable memory independent of the segment"""
+    d = SharedDict("oob_writable", size=10 * 1024 * 1024, create=True)
+
+    d["pair"] = (np.zeros(100), np.ones((10, 10), order="F"))
+    first, second = d["pair"]
+    first[0] = 42.0
+    second[0, 0] = 7.0
+
+    again_first, again_second = d["pair"]
+    assert again_first[0] == 0.0
+    assert again_second[0, 0] == 1.0
+    assert second.flags.f_contiguous
+
+    d.close()
+    d.unlink()
+
+
+def test_many_small_buffers_are_aligned() -> None:
+    """Buffers of odd sizes are each placed on an aligned boundary"""
+    d = SharedDict("oob_alignment", size=10 * 1024 * 1024, create=True)
+
+    arrays = [np.arange(n, dtype=np.float64) for n in (1, 3, 7, 13, 101)]
+    d["arrays"] = arrays
+
+    for original, restored in zip(arrays, d["arrays"]):
+        np.testing.assert_array_equal(original, restored)
+        assert restored.ctypes.data % 8 == 0
+
+    d.close()
+    d.unlink()
+
+
+def test_plain_objects_stay_in_band() -> None:
+    """Objects without out-of-band buffers keep the regular pickle path"""
+    d = SharedDict("oob_in_band", size=10 * 1024 * 1024, create=True)
+
+    d["plain"] = {"a": [1, 2, 3], "b": "text"}
+    assert d["plain"] == {"a": [1, 2, 3], "b": "text"}
+
+    buffers = []
+    pickle.dumps(d["plain"], protocol=5, buffer_callback=buffers.append)
+    assert buffers == []
+
+    d.close()
+    d.unlink()
+
+
+def out_of_band_worker(dict_name: str) -> bool:
+    """Read arrays written by the parent and publish a derived result"""
+    d = SharedDict(dict_name, create=False)
+    batch = d["batch"]
+    d["result"] = {"sum": batch["x"] + batch["y"]}
+    d.close()
+    return True
+
+
+def test_out_of_band_across_processes() -> None:
+    """Out-of-band values are readable from another process"""
+    d = SharedDict("oob_multiprocess", size=20 * 1024 * 1024, create=True)
+    x = np.random.rand(1000)
+    y = np.random.rand(1000)
+    d["batch"] = {"x": x, "y": y}
+
+    p = mp.Process(target=out_of_band_worker, args=("oob_multiprocess",))
+    p.start()
+    p.join(timeout=30)
+    assert p.exitcode == 0
+
+    np.testing.assert_allclose(d["result"]["sum"], x + y)
+
+    d.close()
+    d.unlink()
+
+
+class WritesWhilePickled:
+    """Writes to a dictionary from __reduce__, while the outer value is being pickled"""
+
+    def __init__(self, d: SharedDict) -> None:
+        self.d = d
+
+    def __reduce__(self) -> tuple:
+        self.d["inner_array"] = np.arange(5)
+        self.d["inner_nested"] = {"arr": np.arange(7)}
+        return (int, (7,))
+
+
+def test_writes_nested_in_pickling() -> None:
+    """A write made while pickling another value on the same thread leaves both intact"""
+    d = SharedDict("oob_nested_writes", size=10 * 1024 * 1024, create=True)
+
+    d["outer"] = {"arr": np.arange(1000), "hook": WritesWhilePickled(d)}
+    with d.batch() as batch:
+        batch["batched"] = {"arr": np.arange(1000), "hook": WritesWhilePickled(d)}
+
+    for key in ("outer", "batched"):
+        assert d[key]["hook"] == 7
+        np.testing.assert_array_equal(d[key]["arr"], np.arange(1000))
+    np.testing.assert_array_equal(d["inner_array"], np.arange(5))
+    np.testing.assert_array_equal(d["inner_nested"]["arr"], np.arange(7))
+
+    d.close()
+    d.unlink()
@@ -0,0 +1,167 @@
+"""
+Test native reductions over all entries (SharedDict.scan_reduce)
+"""
+
+import threading
+
+import numpy as np
+import pytest
+
+from sharedbox import LockTimeout, SharedDict
+
+
+def test_reduce_scalars() -> None:
+    """count, sum, min, max and mean cover bool, int and float values"""
+    d = SharedDict("scan_scalars", size=10 * 1024 * 1024, create=True, max_keys=16)
+    for i in range(1000):
+        d[i] = i if i % 2 == 0 else float(i)
+    d["flag"] = True
+    d["name"] = "not a number"
+    d["nested"] = {"value": 5}  # pickled values are skipped
+
+    assert d.scan_reduce("count") == 1001
+    assert d.scan_reduce("sum") == sum(range(1000)) + 1
+    assert d.scan_reduce("min") == 0.0
+    assert d.scan_reduce("max") == 999.0
+    assert d.scan_reduce("mean") == pytest.approx((sum(range(1000)) + 1) / 1001)
+
+    d.close()
+    d.unlink()
+
+
+def test_reduce_numpy_arrays() -> None:
+    """Every element of numeric arrays is reduced, whatever their shape and dtype"""
+    d = SharedDict("scan_numpy", size=10 * 1024 * 1024, create=True)
+    d["f8"] = np.arange(10, dtype=np.float64).reshape(2, 5)
+    d["i2"] = np.array([-3, 4], dtype=np.int16)
+    d["u1"] = np.array([200], dtype=np.uint8)
+    d["f4"] = np.array([0.5], dtype=np.float32)
+    d["b1"] = np.array([True, False, True])
+    d["c16"] = np.array([1 + 2j])  # complex arrays are skipped
+    d["scalar"] = 7
+
+    assert d.scan_reduce("count") == 10 + 2 + 1 + 1 + 3 + 1
+    assert d.scan_reduce("sum") == 45 + 1 + 200 + 0.5 + 2 + 7
+    assert d.scan_reduce("min") == -3.0
+    assert d.scan_reduce("max") == 200.0
+
+    d.close()
+    d.unlink()
+
+
+def test_where_and_keys() -> None:
+    """where= filters the numbers reduced; keys lists values with a match"""
+    d = SharedDict("scan_where", size=10 * 1024 * 1024, create=True)
+    for i in range(100):
+        d[f"k{i}"] = i
+    d["array"] = np.array([1, 150, 2])
+
+    assert d.scan_reduce("count", where=(">=", 90)) == 11
+    assert d.scan_reduce("sum", where=("<", 3)) == 0 + 1 + 2 + 1 + 2
+    assert d.scan_reduce("mean", where=("==", 50)) == 50.0
+    assert d.scan_reduce("count", where=("!=", 0)) == 99 + 3
+
+    assert sorted(d.scan_reduce("keys", where=(">", 97))) == ["array", "k98", "k99"]
+    assert d.scan_reduce("keys", where=(">", 1000)) == []
+    assert d.scan_reduce("max", where=(">", 1000)) is None
+    assert len(d.scan_reduce("keys")) == 101
+
+    d.close()
+    d.unlink()
+
+
+def test_thread_counts_agree() -> None:
+    """The result does not depend on how many threads scan the stripes"""
+    d = SharedDict("scan_threads", {i: i * 0.25 for i in range(20_000)}, size=32 * 1024 * 1024,
+                   create=True, max_keys=64)
+
+    expected = sum(i * 0.25 for i in range(20_000))
+    for threads in (0, 1, 3, 8, 64, 1000):
+        assert d.scan_reduce("sum", threads=threads) == pytest.approx(expected)
+        assert d.scan_reduce("count", where=("<", 10), threads=threads) == 40
+
+    d.close()
+    d.unlink()
+
+
+def test_integers_stay_exact() -> None:
+    """Integers beyond 2**53 are summed exactly and reduce to ints"""
+    d = SharedDict("scan_exact", size=10 * 1024 * 1024, create=True, max_keys=4)
+    big = 2**62 + 1
+    for i in range(8):
+        d[i] = big
+    d["neg"] = -3
+    d["flag"] = True
+    d["array"] = np.array([2**64 - 1, 1], dtype=np.uint64)
+
+    expected = 8 * big - 3 + 1 + 2**64
+    for threads in (1, 4):
+        total = d.scan_reduce("sum", threads=threads)
+        assert type(total) is int
+        assert total == expected
+    assert d.scan_reduce("min") == -3 and type(d.scan_reduce("min")) is int
+    assert d.scan_reduce("max") == 2**64 - 1
+    assert d.scan_reduce("sum", where=("<", 0)) == -3
+
+    d["ratio"] = 0.5
+    assert type(d.scan_reduce("sum")) is float
+    assert d.scan_reduce("sum") == pytest.approx(expected + 0.5)
+    assert d.scan_reduce("min") == -3.0
+
+    d.close()
+    d.unlink()
+
+
+def test_bounded_scans() -> None:
+    """timeout= bounds the whole scan and nonblocking= never waits for a stripe"""
+    d = SharedDict("scan_bounded", size=64 * 1024 * 1024, create=True, max_keys=1)
+    d["n"] = 7
+    assert d.scan_reduce("sum", nonblocking=True) == 7
+    assert d.scan_reduce("sum", timeout=1.0) == 7
+
+    stop = threading.Event()
+    payload = np.zeros(1024 * 1024, dtype=np.uint8)
+
+    def writer() -> None:
+        while not stop.is_set():
+            d["big"] = payload
+
+    thread = threading.Thread(target=writer)
+    thread.start()
+    raised = 0
+    try:
+        for _ in range(500):
+            try:
+                d.scan_reduce("count", nonblocking=True)
+            except LockTimeout:
+                raised += 1
+    finally:
+        stop.set()
+        thread.join()
+
+    assert d.get_stats()["lock_timeouts"] == raised
+
+    d.close()
+    d.unlink()
+
+
+def test_empty_and_invalid() -> None:
+    """An empty dict reduces to zero or None; bad arguments raise ValueError"""
+    d = SharedDict("scan_invalid", size=10 * 1024 * 1024, create=True)
+
+    assert d.scan_reduce("count") == 0
+    assert d.scan_reduce("sum") == 0.0
+    assert d.scan_reduce("mean") is None
+    assert d.scan_reduce("keys") == []
+
+    with pytest.raises(ValueError):
+        d.scan_reduce("median")
+    with pytest.raises(ValueError):
+        d.scan_reduce("sum", where=("=<", 1))
+    with pytest.raises(ValueError):
+        d.scan_reduce("sum", timeout=1.0, nonblocking=True)
+
+    d.close()
+    with pytest.raises(RuntimeError):
+        d.scan_reduce("sum")
+    d.unlink()
@@ -0,0 +1,126 @@
+"""
+Test secondary indexes on fields of dict values (indexes= / find_by)
+"""
+
+import multiprocessing as mp
+
+import pytest
+
+from sharedbox import SharedDict
+
+
+def test_find_by_field() -> None:
+    """find_by returns exactly the keys whose indexed field has the value"""
+    d = SharedDict("index_basic", size=10 * 1024 * 1024, create=True, indexes=("status", "owner"))
+    for i in range(300):
+        d[f"job{i}"] = {"status": "ready" if i % 3 == 0 else "waiting", "owner": i % 7, "payload": [i]}
+
+    ready = d.find_by("status", "ready")
+    assert sorted(ready) == sorted(f"job{i}" for i in range(0, 300, 3))
+    assert len(d.find_by("owner", 0)) == len(range(0, 300, 7))
+    assert d.find_by("status", "done") == []
+    assert d.find_by("status", "read") == []  # terms match whole values only
+
+    with pytest.raises(ValueError):
+        d.find_by("payload", "x")
+    assert d.get_stats()["indexes"] == ["status", "owner"]
+
+    d.close()
+    d.unlink()
+
+
+def test_writes_keep_indexes_exact() -> None:
+    """Overwrites, deletes and non-dict values update the index"""
+    d = SharedDict("index_updates", size=10 * 1024 * 1024, create=True, indexes=("status",))
+    d["a"] = {"status": "ready"}
+    d["b"] = {"status": "ready"}
+    d["c"] = {"status": b"ready"}  # bytes terms differ from str terms
+    d["d"] = {"status": 1}
+
+    d["a"] = {"status": "done"}
+    del d["b"]
+    d.set("d", "not a dict")
+    assert d.find_by("status", "ready") == []
+    assert d.find_by("status", "done") == ["a"]
+    assert d.find_by("status", b"ready") == ["c"]
+    assert d.find_by("status", 1) == []
+
+    d["e"] = {"other": "ready"}
+    d["f"] = {"status": 1.5}  # floats are not indexed
+    assert d.find_by("status", "ready") == []
+
+    with d.batch() as b:
+        b["g"] = {"status": "ready"}
+        b["a"] = {"status": "ready"}
+        del b["c"]
+    assert sorted(d.find_by("status", "ready")) == ["a", "g"]
+    assert d.find_by("status", b"ready") == []
+
+    d.close()
+    d.unlink()
+
+
+def test_initial_data_and_int_keys() -> None:
+    """Initial data is indexed and keys come back in their Python type"""
+    data = {i: {"kind": "even" if i % 2 == 0 else "odd"} for i in range(1000)}
+    d = SharedDict("index_initial", data, size=10 * 1024 * 1024, create=True, indexes=["kind"])
+
+    assert sorted(d.find_by("kind", "odd")) == list(range(1, 1000, 2))
+
+    d.close()
+    d.unlink()
+
+
+def test_evicted_keys_leave_the_index() -> None:
+    """In cache mode an evicted key is no longer found"""
+    d = SharedDict("index_cache", size=10 * 1024 * 1024, create=True, max_keys=4,
+                   max_entries=100, indexes=("tag",))
+    for i in range(1000):
+        d[i] = {"tag": "t"}
+
+    found = d.find_by("tag", "t")
+    assert sorted(found) == sorted(d.keys())
+    assert len(found) <= 100
+
+    d.close()
+    d.unlink()
+
+
+def test_indexes_fixed_by_creator() -> None:
+    """Attaching handles adopt the creator's indexes"""
+    d = SharedDict("index_attach", size=10 * 1024 * 1024, create=True, indexes=("status",))
+    other = SharedDict("index_attach", create=False, indexes=("owner",))
+    other["x"] = {"status": "ready", "owner": "ann"}
+
+    assert d.find_by("status", "ready") == ["x"]
+    with pytest.raises(ValueError):
+        d.find_by("owner", "ann")
+
+    with pytest.raises(ValueError):
+        SharedDict("index_twice", size=10 * 1024 * 1024, create=True, indexes=("a", "a"))
+
+    other.close()
+    d.close()
+    d.unlink()
+
+
+def index_worker(dict_name: str, worker_id: int) -> None:
+    """Write indexed values from a child process"""
+    d = SharedDict(dict_name, create=False)
+    for i in range(100):
+        d[f"{worker_id}-{i}"] = {"worker": worker_id}
+    d.close()
+
+
+def test_indexes_shared_across_processes() -> None:
+    """Writes from other processes are indexed in the shared segment"""
+    d = SharedDict("index_multiprocess", size=10 * 1024 * 1024, create=True, indexes=("worker",))
+
+    with mp.Pool(3) as pool:
+        pool.starmap(index_worker, [("index_multiprocess", i) for i in range(3)])
+
+    for worker_id in range(3):
+        assert len(d.find_by("worker", worker_id)) == 100
+
+    d.close()
+    d.unlink()
@@ -0,0 +1,86 @@
+"""
+Test attaching to segments through the fixed segment header
+"""
+
+import multiprocessing as mp
+import sys
+from multiprocessing import shared_memory
+
+import pytest
+
+from sharedbox import SharedDict
+
+
+def test_attach_adopts_creator_stripe_count() -> None:
+    """Attaching with a different max_keys still hashes keys like the creator"""
+    d = SharedDict("header_stripes", size=10 * 1024 * 1024, create=True, max_keys=8)
+    for i in range(100):
+        d[f"key_{i}"] = i
+
+    other = SharedDict("header_stripes", create=False, max_keys=512)
+    for i in range(100):
+        assert other[f"key_{i}"] == i
+    other["from_other"] = True
+    assert d["from_other"] is True
+    assert len(other) == len(d) == 101
+
+    other.close()
+    d.close()
+    d.unlink()
+
+
+def test_create_attaches_to_existing_segment() -> None:
+    """create=True on an existing name attaches instead of recreating"""
+    d = SharedDict("header_reopen", size=10 * 1024 * 1024, create=True)
+    d["key"] = "value"
+
+    again = SharedDict("header_reopen", size=1024 * 1024, create=True)
+    assert again["key"] == "value"
+
+    again.close()
+    d.close()
+    d.unlink()
+
+
+def test_attach_missing_segment_fails() -> None:
+    """create=False requires an existing segment"""
+    with pytest.raises(Exception):
+        SharedDict("header_missing_segment", create=False)
+
+
+@pytest.mark.skipif(sys.platform != "linux", reason="POSIX shared memory names are shared only on Linux")
+def test_attach_foreign_segment_fails() -> None:
+    """A segment without the sharedbox header is rejected"""
+    foreign = shared_memory.SharedMemory(name="header_foreign", create=True, size=4096)
+    try:
+        foreign.buf[:8] = b"notours!"
+        with pytest.raises(RuntimeError, match="not a sharedbox segment"):
+            SharedDict("header_foreign", create=False)
+    finally:
+        foreign.close()
+        foreign.unlink()
+
+
+def concurrent_writer(dict_name: str, worker_id: int) -> bool:
+    """Write many distinct keys, spread across all stripes"""
+    d = SharedDict(dict_name, create=False)
+    for i in range(500):
+        d[f"worker_{worker_id}_{i}"] = i
+    d.close()
+    return True
+
+
+def test_concurrent_writers_on_different_stripes() -> None:
+    """Writers holding different stripes never corrupt each other's entries"""
+    d = SharedDict("header_concurrent", size=64 * 1024 * 1024, create=True, max_keys=16)
+
+    with mp.Pool(4) as pool:
+        assert all(pool.starmap(concurrent_writer, [("header_concurrent", i) for i in range(4)]))
+
+    assert len(d) == 4 * 500
+    assert len(d.keys()) == 4 * 500
+    for worker_id in range(4):
+        assert d[f"worker_{worker_id}_499"] == 499
+
+    d.close()
+    d.unlink()
@@ -0,0 +1,127 @@
+"""
+Test streaming writes through SharedDict.writer()
+"""
+
+import multiprocessing as mp
+
+import numpy as np
+import pytest
+
+from sharedbox import SharedDict
+
+
+def test_writer_publishes_on_exit() -> None:
+    """Chunks written inside the context are visible only after it exits"""
+    d = SharedDict("writer_publish", size=10 * 1024 * 1024, create=True)
+
+    with d.writer("blob", size_hint=16) as w:
+        w.write(b"hello ")
+        w.write(bytearray(b"shared "))
+        w.write(memoryview(b"world"))
+        assert "blob" not in d
+        assert w.bytes_written == 18
+
+    assert w.closed
+    assert d["blob"] == b"hello shared world"
+
+    d.close()
+    d.unlink()
+
+
+def test_writer_grows_past_size_hint() -> None:
+    """Writing more than the hint grows the reserved buffer"""
+    d = SharedDict("writer_grow", size=10 * 1024 * 1024, create=True)
+
+    chunk = bytes(range(256))
+    with d.writer("blob") as w:
+        for _ in range(1000):
+            w.write(chunk)
+
+    assert d["blob"] == chunk * 1000
+
+    d.close()
+    d.unlink()
+
+
+def test_writer_replaces_existing_value() -> None:
+    """Closing a writer atomically replaces an existing value"""
+    d = SharedDict("writer_replace", size=10 * 1024 * 1024, create=True)
+    d["blob"] = {"old": True}
+
+    w = d.writer("blob", size_hint=4)
+    w.write(b"new!")
+    assert d["blob"] == {"old": True}
+    w.close()
+
+    assert d["blob"] == b"new!"
+    assert len(d) == 1
+
+    d.close()
+    d.unlink()
+
+
+def test_writer_discards_on_exception() -> None:
+    """An exception inside the context leaves the key untouched"""
+    d = SharedDict("writer_discard", size=10 * 1024 * 1024, create=True)
+    d["blob"] = "original"
+
+    with pytest.raises(RuntimeError, match="producer failed"):
+        with d.writer("blob") as w:
+            w.write(b"partial")
+            raise RuntimeError("producer failed")
+
+    assert w.closed
+    assert d["blob"] == "original"
+
+    with pytest.raises(RuntimeError):
+        w.write(b"more")
+
+    d.close()
+    d.unlink()
+
+
+def test_writer_accepts_numpy_buffers() -> None:
+    """Contiguous numpy arrays are copied straight from their buffer"""
+    d = SharedDict("writer_numpy", size=10 * 1024 * 1024, create=True)
+
+    arr = np.arange(1024, dtype=np.float64)
+    with d.writer("raw", size_hint=arr.nbytes) as w:
+        w.write(arr)
+
+    restored = np.frombuffer(d["raw"], dtype=np.float64)
+    np.testing.assert_array_equal(restored, arr)
+
+    with pytest.raises(TypeError):
+        with d.writer("bad") as w:
+            w.write("not bytes")
+    assert "bad" not in d
+
+    d.close()
+    d.unlink()
+
+
+def streaming_worker(dict_name: str, worker_id: int) -> bool:
+    """Stream a value from a child process"""
+    d = SharedDict(dict_name, create=False)
+    with d.writer(f"worker_{worker_id}") as w:
+        for i in range(10):
+            w.write(bytes([worker_id]) * 1024)
+    d.close()
+    return True
+
+
+def test_writer_across_processes() -> None:
+    """Values streamed by children are readable by the parent"""
+    d = SharedDict("writer_multiprocess", size=10 * 1024 * 1024, create=True)
+
+    with mp.Pool(3) as pool:
+        results = pool.starmap(
+            streaming_worker, [("writer_multiprocess", i) for i in range(3)]
+        )
+    assert all(results)
+
+    for i in range(3):
+        assert d[f"worker_{i}"] == bytes([i]) * 10 * 1024
+
+    d.close()
+    d.unlink()
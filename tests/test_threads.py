@@ -0,0 +1,104 @@
+"""
+Test SharedDict handles shared between threads of one process, which run in
+parallel on free-threaded Python
+"""
+
+import threading
+
+import pytest
+
+from sharedbox import SharedDict
+
+
+def run_threads(target, count: int) -> None:
+    """Start count threads on target(thread_id) together and join them"""
+    barrier = threading.Barrier(count)
+    errors = []
+
+    def wrapped(thread_id: int) -> None:
+        barrier.wait()
+        try:
+            target(thread_id)
+        except BaseException as e:  # reported by the main thread
+            errors.append(e)
+
+    threads = [threading.Thread(target=wrapped, args=(i,)) for i in range(count)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    if errors:
+        raise errors[0]
+
+
+def test_concurrent_writers_and_readers() -> None:
+    """Threads writing disjoint keys and reading each other's never lose an entry"""
+    d = SharedDict("threads_rw", size=32 * 1024 * 1024, create=True, max_keys=16)
+
+    def work(thread_id: int) -> None:
+        for i in range(2000):
+            d[thread_id * 100_000 + i] = i
+            d[f"{thread_id}:{i}"] = [thread_id, i]
+            d.get(f"{(thread_id + 1) % 8}:{i}")
+
+    run_threads(work, 8)
+    assert len(d) == 8 * 2000 * 2
+    assert all(d[f"{t}:1999"] == [t, 1999] for t in range(8))
+
+    d.close()
+    d.unlink()
+
+
+def test_local_cache_under_threads() -> None:
+    """The local cache stays coherent when many threads read and write through it"""
+    d = SharedDict("threads_cache", size=32 * 1024 * 1024, create=True, local_cache_size=64)
+    for i in range(256):
+        d[i] = 0
+
+    def work(thread_id: int) -> None:
+        for round_ in range(200):
+            key = (thread_id * 31 + round_) % 256
+            d[key] = round_
+            assert isinstance(d[key], int)
+
+    run_threads(work, 8)
+    stats = d.get_stats()
+    assert stats["local_cache_entries"] <= 64
+    assert stats["local_cache_hits"] + stats["local_cache_misses"] == 8 * 200
+
+    # Fresh reads see the last write of every key
+    other = SharedDict("threads_cache", create=False)
+    assert all(d[i] == other[i] for i in range(256))
+
+    other.close()
+    d.close()
+    d.unlink()
+
+
+def test_close_while_in_use() -> None:
+    """Closing a handle other threads are using makes their next call raise"""
+    d = SharedDict("threads_close", size=10 * 1024 * 1024, create=True, local_cache_size=16)
+    d["key"] = "value"
+    started = threading.Event()
+    outcome = []
+
+    def reader() -> None:
+        started.set()
+        try:
+            while True:
+                d.get("key")
+                d["key"] = "value"
+        except RuntimeError:
+            outcome.append("closed")
+
+    t = threading.Thread(target=reader)
+    t.start()
+    started.wait()
+    d.close()
+    t.join(timeout=10)
+    assert outcome == ["closed"]
+    assert d.is_closed()
+
+    with pytest.raises(RuntimeError):
+        d["key"] = "again"
+    d.unlink()